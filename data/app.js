@@ -8,6 +8,9 @@ let ws;
 let chart;
 let histTimer;
 
+/* Stand des Diagramms: letzte bekannte Bucket-Seq je Boot */
+let histState = { series: "", boot: 0, seq: 0, cap: 0 };
+
 let lastMdnsName = "";
 let lastState    = "";
 
@@ -160,6 +163,12 @@ function connectWS()
       if(el) el.innerText = d.status;
     }
 
+    if(d.hist !== undefined && historyVisible())
+      onHistBucket(d.hist);
+
+    if(d.histUpdate !== undefined && historyVisible())
+      loadHistoryTable();
+
   };
 }
 
@@ -328,6 +337,16 @@ function initHistory()
           pointRadius: 0,
           tension: 0.25
         },
+        {
+          label: "TDS max (ppm)",
+          data: [],
+          yAxisID: "yTds",
+          borderColor: "#ef5350",
+          borderWidth: 1,
+          borderDash: [4, 3],
+          pointRadius: 0,
+          tension: 0.25
+        },
         {
           label: "Liter (L)",
           data: [],
@@ -355,7 +374,8 @@ function initHistory()
     }
   });
 
-  histTimer = setInterval(loadHistory, 4000);
+  /* neue Buckets kommen per WS; Poll nur als Sicherheitsnetz */
+  histTimer = setInterval(loadHistory, 60000);
 
   document.getElementById("rangeSel").onchange = () => loadHistory(true);
 }
@@ -364,44 +384,160 @@ function initHistory()
 
 /* ================== SERIES ================== */
 
+/* Kanalreihenfolge wie HIST_CHANNELS in history.cpp */
+const HIST_CHANNEL_NAMES = ["tds", "flow", "flowIn", "prod"];
+const HIST_STAT_SUFFIX   = ["", "Min", "Max", "Last"];
+
+/* Binärframe von /api/history/series.bin dekodieren (siehe history.cpp) */
+function decodeSeriesBin(buf)
+{
+  const dv = new DataView(buf);
+
+  const enc       = dv.getUint8(2);
+  const columns   = dv.getUint8(3);
+  const bucketSec = dv.getUint32(4, true);
+  const count     = dv.getUint16(10, true);
+  const seq       = dv.getUint32(12, true);
+  const boot      = dv.getUint32(16, true);
+
+  const d = { bucketSec, seq, boot };
+  let off = 20 + ((columns + 3) & ~3);
+
+  d.t = new Uint32Array(buf.slice(off, off + count * 4));
+  off += count * 4;
+
+  for(let c=0; c<columns; c++)
+  {
+    const id  = dv.getUint8(20 + c);
+    const key = (HIST_CHANNEL_NAMES[id >> 2] || ("ch" + (id >> 2)))
+              + HIST_STAT_SUFFIX[id & 3];
+
+    if(enc === 1) {
+      const scale = dv.getFloat32(off, true);
+      const delta = new Int16Array(buf, off + 4, count);
+      const col = new Float32Array(count);
+      let acc = 0;
+      for(let i=0;i<count;i++) {
+        acc += delta[i];
+        col[i] = acc * scale;
+      }
+      d[key] = col;
+      off += 4 + ((count + 1) & ~1) * 2;
+    } else {
+      d[key] = new Float32Array(buf, off, count);
+      off += count * 4;
+    }
+  }
+
+  return d;
+}
+
+/* t = 0 -> Uhr war beim Abschluss noch nicht gestellt, Zeit schätzen */
+function histLabel(t, ageBuckets, step)
+{
+  if(t > 1e9) return new Date(t * 1000);
+  return new Date(Date.now() - ageBuckets * step * 1000);
+}
+
+/* Punkte hinten anhängen, vorne auf Ringlänge kürzen */
+function appendHistory(d, step, skip=0)
+{
+  const ds  = chart.data.datasets;
+  const len = d.tds.length;
+
+  for(let i=skip;i<len;i++) {
+    chart.data.labels.push(histLabel(d.t[i], len-i-1, step));
+    ds[0].data.push(d.tds[i]);
+    ds[1].data.push(d.flow[i]);
+    ds[2].data.push(d.tdsMax ? d.tdsMax[i] : null);
+    ds[3].data.push(d.prod[i]);
+  }
+
+  const drop = chart.data.labels.length - histState.cap;
+  if(drop > 0) {
+    chart.data.labels.splice(0, drop);
+    ds.forEach(x => x.data.splice(0, drop));
+  }
+}
+
 function loadHistory(force=false)
 {
   if(!chart) return;
   const series = document.getElementById("rangeSel").value;
 
-  fetch("/api/history/series?series=" + series)
+  /* gleicher Boot + gleiche Stufe -> nur neue Buckets holen */
+  const incremental = !force && histState.series === series && histState.seq > 0;
+
+  let url = "/api/history/series.bin?stats=1&series=" + series;
+  if(incremental)
+    url += "&since=" + histState.seq + "&boot=" + histState.boot;
+
+  fetch(url)
     .then(r => {
       if(!r.ok) throw new Error("HTTP " + r.status);
-      return r.json();
+      return r.arrayBuffer();
     })
-    .then(d =>
+    .then(buf =>
     {
-      const len = d.tds.length;
-
-      const step = RANGE_SECONDS[series] || 2;
-      const now = Date.now();
-      const labels = [];
-      for(let i=0;i<len;i++)
-        labels.push(new Date(now - (len-i-1)*step*1000));
-      chart.data.labels = labels;
-
-      chart.data.datasets[0].data = d.tds;
-      chart.data.datasets[1].data = d.flow;
-      chart.data.datasets[2].data = d.prod;
+      const d = decodeSeriesBin(buf);
+      const step = d.bucketSec || RANGE_SECONDS[series] || 2;
+
+      /* anderer Boot -> Server hat since ignoriert und alles geschickt */
+      let skip = 0;
+      if(!incremental || d.boot !== histState.boot) {
+        histState = { series, boot: d.boot, seq: 0, cap: d.tds.length };
+        chart.data.labels = [];
+        chart.data.datasets.forEach(x => x.data = []);
+      } else {
+        /* per WS schon angehängte Buckets überspringen */
+        skip = Math.max(0, histState.seq - (d.seq - d.tds.length));
+      }
+      if(d.seq < histState.seq) return;
+      histState.seq = d.seq;
 
+      appendHistory(d, step, skip);
       chart.update();
 
-      loadHistoryTable();
+      if(!incremental) loadHistoryTable();
     })
     .catch(e => console.error("history fetch failed", e));
 }
 
+/* per WS gemeldeter Bucket {series, boot, seq, t, tds, ...} */
+function onHistBucket(h)
+{
+  if(!chart || h.series !== histState.series) return;
+
+  if(h.boot !== histState.boot) {
+    loadHistory(true);
+    return;
+  }
+  if(h.seq <= histState.seq) return;
+
+  /* Lücke (z.B. WS kurz weg) -> fehlende Buckets nachladen */
+  if(h.seq !== histState.seq + 1) {
+    loadHistory();
+    return;
+  }
+
+  histState.seq = h.seq;
+  appendHistory({
+    t: [h.t], tds: [h.tds], flow: [h.flow],
+    tdsMax: h.tdsMax !== undefined ? [h.tdsMax] : null,
+    prod: [h.prod]
+  }, RANGE_SECONDS[h.series] || 2);
+  chart.update();
+}
+
 
 /* ================== TABLE ================== */
 
+/* nur erste Seite; vollständige Liste über table.csv */
+const HIST_TABLE_PAGE = 25;
+
 function loadHistoryTable()
 {
-  fetch("/api/history/table")
+  fetch("/api/history/table?limit=" + HIST_TABLE_PAGE)
     .then(r => r.json())
     .then(rows =>
     {
@@ -426,6 +562,7 @@ function loadHistoryTable()
            <td>${fmt(r.end)}</td>
            <td>${durFmt(r.duration||0)}</td>
            <td>${Number(r.liters).toFixed(2)}</td>
+           <td>${r.ratio != null ? (r.ratio*100).toFixed(0) + " %" : ""}</td>
            <td>${r.reason||""}</td>`;
       
         body.appendChild(tr);
@@ -0,0 +1,431 @@
+/*********************************************************************
+  OSMOSE BENCH (Linux)
+
+  Mikrobenchmarks der heißen Pfade aus src/ über das POSIX-Backend
+  der HAL, mit festem Datensatz (7 Tage 2-s-Samples, 6 Läufe je
+  Tag, virtuelle Uhr ab SIM_EPOCH0):
+
+    hist.add2s            historyAddSample2s (inkl. Stufen + Logs)
+    hist.series.*         historySelect* + historySeriesJsonNext
+    hist.table            historyTableJsonNext, alle Zeilen
+    tds.lookup            tdsLookup über alle ADC-Codes
+    ws.status             wsStatusJson (WebSocket-Broadcast)
+    settings.json         settingsJsonNext (GET /api/settings)
+    settings.save / load  settingsSave / configLoad+settingsLoad
+
+  ArduinoJson in der Version aus platformio.ini (Makefile holt sie
+  bei Bedarf über "pio pkg install -e native").
+
+  Je Benchmark: ns/op (bestes von BENCH_ROUNDS Runden), Heap-Bytes
+  und Allokationen je Aufruf (malloc/calloc/realloc, glibc) und
+  Ausgabegröße in Bytes. Mit --baseline wird gegen eine frühere
+  Messung verglichen: ns/op mit BENCH_NS_TOL Toleranz, Heap und
+  Ausgabe exakt (Datensatz ist fest) -> "!" = Verschlechterung.
+
+  Aufruf:  ./osmose_bench [--baseline FILE] [--write FILE] [--check]
+                          [--filter TEXT] [--fs DIR]
+  --check: Exit-Code 1 bei einer Verschlechterung
+*********************************************************************/
+
+#include <Arduino.h>
+#include <chrono>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "host.h"
+
+#include "config_settings.h"
+#include "hal.h"
+#include "history.h"
+#include "settings.h"
+#include "tds_cal.h"
+#include "totals.h"
+#include "ws_status.h"
+
+#define SIM_EPOCH0      1735689600UL   // 2025-01-01 00:00:00 UTC (= sim.cpp)
+#define BENCH_DAYS      7
+#define BENCH_SAMPLES   (BENCH_DAYS * 43200UL)
+#define BENCH_CYCLE     7200           // Samples je Zyklus (4 h)
+#define BENCH_RUN       900            // davon Produktion (30 min)
+#define BENCH_ROUNDS    5
+#define BENCH_NS_TOL    0.25           // +25 % ns/op gilt als Verschlechterung
+
+
+/* ============================================================
+   HEAP-ZÄHLER
+   Ersetzt malloc & Co. (glibc: __libc_*); operator new läuft in
+   libstdc++ über malloc und wird mitgezählt.
+   ============================================================ */
+
+extern "C" {
+void* __libc_malloc(size_t n);
+void* __libc_calloc(size_t n, size_t k);
+void* __libc_realloc(void* p, size_t n);
+}
+
+static bool     heapOn    = false;
+static uint64_t heapBytes = 0;
+static uint64_t heapCalls = 0;
+
+static inline void heapCount(size_t n)
+{
+  if(!heapOn) return;
+  heapBytes += n;
+  heapCalls++;
+}
+
+extern "C" void* malloc(size_t n)            { heapCount(n); return __libc_malloc(n); }
+extern "C" void* calloc(size_t n, size_t k)  { heapCount(n * k); return __libc_calloc(n, k); }
+extern "C" void* realloc(void* p, size_t n)  { heapCount(n); return __libc_realloc(p, n); }
+
+
+/* ============================================================
+   HILFEN
+   ============================================================ */
+
+/* zählt nur, entspricht dem Chunk-Puffer der Web-Antwort */
+class CountPrint : public Print{
+public:
+  size_t write(uint8_t) override                  { n++; return 1; }
+  size_t write(const uint8_t*, size_t k) override { n += k; return k; }
+  using Print::write;
+
+  uint32_t n = 0;
+};
+
+template<class F>
+static uint32_t drain(F next)
+{
+  CountPrint out;
+  while(next(out)) {}
+  return out.n;
+}
+
+static volatile float sink;
+
+static void wipeDir(const char* dir)
+{
+  if(DIR* d = opendir(dir)) {
+    while(struct dirent* e = readdir(d))
+      if(e->d_name[0] != '.') unlink((std::string(dir) + "/" + e->d_name).c_str());
+    closedir(d);
+  }
+}
+
+
+/* ============================================================
+   DATENSATZ
+   Sample i liegt bei SIM_EPOCH0 + 2 s x (i + 1). Je Zyklus ein
+   Lauf: PREPARE, AUTOFLUSH, PRODUCTION, POSTFLUSH, dann IDLE.
+   ============================================================ */
+
+static uint32_t sampleIdx = 0;
+
+static uint8_t stateAt(uint32_t k)
+{
+  if(k < 15)           return HST_PREPARE;
+  if(k < 60)           return HST_AUTOFLUSH;
+  if(k < BENCH_RUN)    return HST_PRODUCTION;
+  if(k < BENCH_RUN+30) return HST_POSTFLUSH;
+  return HST_IDLE;
+}
+
+static void feed()
+{
+  uint32_t i = sampleIdx++;
+  uint32_t k = i % BENCH_CYCLE;
+  uint8_t  st = stateAt(k);
+
+  hostSetUs((uint64_t)(i + 1) * 2000000ULL);
+
+  if(k == 0) historyStartProduction((i / BENCH_CYCLE) & 1 ? "MANUAL" : "AUTO");
+
+  bool  prod = st == HST_PRODUCTION;
+  float tds  = 12.0f + 8.0f * sinf(i * 0.001f) + (prod ? 0.0f : 20.0f) + (i % 7) * 0.1f;
+  float out  = prod ? 0.48f + (i % 13) * 0.002f : 0.0f;
+  float in   = st != HST_IDLE ? 1.15f + (i % 11) * 0.003f : 0.0f;
+  float liters = prod ? (k - 60) * out / 30.0f : 0.0f;
+
+  historyAddSample2s(tds, liters, out, in, st);
+
+  if(k == BENCH_RUN + 29) historyEndProduction((i / BENCH_CYCLE) % 3 ? "Tank full" : "Max liters", liters);
+  historyLoop();
+}
+
+
+/* ============================================================
+   MESSUNG
+   ============================================================ */
+
+struct BenchResult{
+  std::string name;
+  double      nsOp;
+  double      bytesOp;
+  double      allocsOp;
+  uint32_t    outBytes;
+};
+
+static std::vector<BenchResult> results;
+static const char* filter = nullptr;
+
+/* fn() = ein Aufruf, Rückgabe Ausgabegröße; ops Aufrufe je Runde.
+   Erste Runde zum Aufwärmen, Heap-Zähler in der zweiten */
+template<class F>
+static void bench(const char* name, uint32_t ops, F fn)
+{
+  if(filter && !strstr(name, filter)) return;
+
+  BenchResult r = { name, 1e30, 0, 0, 0 };
+  for(uint8_t round = 0; round <= BENCH_ROUNDS; round++) {
+    heapBytes = heapCalls = 0;
+    heapOn = round == 1;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(uint32_t n = 0; n < ops; n++) r.outBytes = fn();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    heapOn = false;
+    if(round == 1) {
+      r.bytesOp  = (double)heapBytes / ops;
+      r.allocsOp = (double)heapCalls / ops;
+    }
+    if(round > 0) r.nsOp = min(r.nsOp, ns / ops);
+  }
+  results.push_back(r);
+}
+
+static void runBenches()
+{
+  /* ---- History-Ausgabe auf dem festen Datensatz ---- */
+  bench("hist.series.2s", 200, [] {
+    HistorySelection sel;
+    historySelect(HIST_2S, false, HIST_MAX_POINTS, 0, sel);
+    HistoryJsonCursor c;
+    return drain([&](Print& out) { return historySeriesJsonNext(sel, c, out); });
+  });
+
+  bench("hist.series.600s.stats", 50, [] {
+    HistorySelection sel;
+    historySelect(HIST_600S, true, HIST_MAX_POINTS, 0, sel);
+    HistoryJsonCursor c;
+    return drain([&](Print& out) { return historySeriesJsonNext(sel, c, out); });
+  });
+
+  bench("hist.series.range24h", 50, [] {
+    uint32_t to = halEpoch();
+    HistorySelection sel;
+    historySelectRange(to - 86400, to, true, HIST_MAX_POINTS, sel);
+    HistoryJsonCursor c;
+    return drain([&](Print& out) { return historySeriesJsonNext(sel, c, out); });
+  });
+
+  bench("hist.table", 200, [] {
+    HistoryTableQuery q;
+    HistoryTableCursor c;
+    return drain([&](Print& out) { return historyTableJsonNext(q, c, out); });
+  });
+
+  /* ---- TDS ---- */
+  static float raws[TDS_LUT_SIZE];
+  for(uint16_t i = 0; i < TDS_LUT_SIZE; i++)
+    raws[i] = (i * 2654435761u % TDS_LUT_SIZE) + (i % 10) * 0.1f;   // ungeordnet
+  static uint16_t rawPos = 0;
+
+  bench("tds.lookup", 1u << 20, [] {
+    sink = tdsLookup(raws[rawPos++ & (TDS_LUT_SIZE - 1)]);
+    return (uint32_t)0;
+  });
+
+  /* ---- WebSocket-Status ---- */
+  bench("ws.status", 20000, [] {
+    static const WsStatus st = {
+      "PRODUCTION", "AUTO", "", 14.2f, 3.71f, 0.49f, 6.29f, 1432.0f,
+      "ESP v3.9.2", 1.16f, "Produktion 3.7 L / 10.0 L"
+    };
+    String s;
+    wsStatusJson(st, s);
+    return (uint32_t)s.length();
+  });
+
+  /* ---- Settings ---- */
+  bench("settings.json", 20000, [] {
+    uint16_t pos = 0, sub = 0;
+    return drain([&](Print& out) { return settingsJsonNext(pos, sub, out); });
+  });
+
+  bench("settings.save", 500, [] {
+    settingsSave();
+    File f = halFs().open("/config.json", "r");
+    return (uint32_t)f.size();
+  });
+
+  bench("settings.load", 500, [] {
+    configLoad();
+    settingsLoad();
+    return (uint32_t)0;
+  });
+
+  /* ---- zuletzt: schreibt weiter in den Datensatz ---- */
+  bench("hist.add2s", 43200, [] {
+    feed();
+    return (uint32_t)0;
+  });
+}
+
+
+/* ============================================================
+   BASELINE
+   Zeile: name ns/op B/op allocs/op out
+   ============================================================ */
+
+static bool loadBaseline(const char* path, std::vector<BenchResult>& base)
+{
+  FILE* f = fopen(path, "r");
+  if(!f) return false;
+
+  char line[256];
+  while(fgets(line, sizeof(line), f)) {
+    char name[64];
+    BenchResult r;
+    unsigned out;
+    if(line[0] == '#') continue;
+    if(sscanf(line, "%63s %lf %lf %lf %u", name, &r.nsOp, &r.bytesOp, &r.allocsOp, &out) != 5) continue;
+    r.name = name;
+    r.outBytes = out;
+    base.push_back(r);
+  }
+  fclose(f);
+  return true;
+}
+
+static bool writeBaseline(const char* path)
+{
+  FILE* f = fopen(path, "w");
+  if(!f) return false;
+
+  fprintf(f, "# osmose_bench: name ns/op B/op allocs/op out\n");
+  for(const BenchResult& r : results)
+    fprintf(f, "%-24s %10.1f %10.1f %8.2f %8u\n", r.name.c_str(), r.nsOp, r.bytesOp, r.allocsOp,
+            (unsigned)r.outBytes);
+  fclose(f);
+  return true;
+}
+
+static const BenchResult* findBase(const std::vector<BenchResult>& base, const std::string& name)
+{
+  for(const BenchResult& b : base)
+    if(b.name == name) return &b;
+  return nullptr;
+}
+
+/* Tabelle; Rückgabe Anzahl Verschlechterungen */
+static uint32_t report(const std::vector<BenchResult>& base)
+{
+  uint32_t worse = 0;
+
+  printf("%-24s %10s %10s %9s %8s", "benchmark", "ns/op", "B/op", "allocs/op", "out B");
+  if(!base.empty()) printf("  %8s %9s %8s", "d ns", "d B/op", "d out");
+  printf("\n");
+
+  for(const BenchResult& r : results) {
+    printf("%-24s %10.1f %10.1f %9.2f %8u", r.name.c_str(), r.nsOp, r.bytesOp, r.allocsOp,
+           (unsigned)r.outBytes);
+
+    const BenchResult* b = findBase(base, r.name);
+    if(!base.empty() && !b) printf("  (neu)");
+    if(b) {
+      double dNs = b->nsOp > 0 ? (r.nsOp / b->nsOp - 1.0) * 100.0 : 0.0;
+      bool bad = dNs > BENCH_NS_TOL * 100.0 ||
+                 r.bytesOp > b->bytesOp + 0.05 || r.allocsOp > b->allocsOp + 0.005 ||
+                 r.outBytes > b->outBytes;
+      printf("  %+7.1f%% %+9.1f %+8d%s", dNs, r.bytesOp - b->bytesOp,
+             (int)r.outBytes - (int)b->outBytes, bad ? "  !" : "");
+      if(bad) worse++;
+    }
+    printf("\n");
+  }
+
+  /* Zeilen der Baseline, die nicht gelaufen sind (ohne --filter) */
+  for(const BenchResult& b : base) {
+    if(filter) break;
+    bool ran = false;
+    for(const BenchResult& r : results) ran |= r.name == b.name;
+    if(ran) continue;
+    printf("%-24s %10s  (fehlt)  !\n", b.name.c_str(), "-");
+    worse++;
+  }
+  return worse;
+}
+
+
+/* ============================================================
+   MAIN
+   ============================================================ */
+
+int main(int argc, char** argv)
+{
+  const char* basePath  = nullptr;
+  const char* writePath = nullptr;
+  const char* fsDir     = "bench_fs";
+  bool        check     = false;
+
+  for(int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if(!strcmp(a, "--check")) { check = true; continue; }
+    if(!v) a = "";
+    else i++;
+
+    if     (!strcmp(a, "--baseline")) basePath  = v;
+    else if(!strcmp(a, "--write"))    writePath = v;
+    else if(!strcmp(a, "--filter"))   filter    = v;
+    else if(!strcmp(a, "--fs"))       fsDir     = v;
+    else {
+      fprintf(stderr, "usage: %s [--baseline FILE] [--write FILE] [--check] [--filter TEXT] [--fs DIR]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  std::vector<BenchResult> base;
+  if(basePath && !loadBaseline(basePath, base))
+    fprintf(stderr, "no baseline %s\n", basePath);
+
+  /* ---- Datensatz aufbauen (wie setup() in main.cpp) ---- */
+  setenv("TZ", "UTC", 1);
+  tzset();
+  hostSetEpoch(SIM_EPOCH0);
+  hostSeed(1);
+  hostSetQuiet(true);
+  hostFsRoot(fsDir);
+  wipeDir(fsDir);
+
+  halFsBegin();
+  configLoad();
+  settingsLoad();
+  settings.tdsCal = "300:40, 1200:180, 2600:620";
+  settingsSave();
+  tdsCalApply(settings.tdsCal.c_str());
+  totalsInit();
+  historyInit();
+
+  auto t0 = std::chrono::steady_clock::now();
+  while(sampleIdx < BENCH_SAMPLES) feed();
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  fprintf(stderr, "dataset: %u samples, %u runs in %.2f s\n",
+          (unsigned)BENCH_SAMPLES, (unsigned)historyGetRowCount(), wall);
+
+  runBenches();
+
+  uint32_t worse = report(base);
+  if(writePath && !writeBaseline(writePath)) {
+    fprintf(stderr, "cannot write %s\n", writePath);
+    return 2;
+  }
+  if(!base.empty())
+    printf("%u regression(s) against %s\n", (unsigned)worse, basePath);
+
+  return check && worse ? 1 : 0;
+}
@@ -0,0 +1,338 @@
+#include "plant.h"
+#include "host.h"
+#include "controller.h"
+#include "flow_meter.h"
+
+/* ============================================================
+   STATE
+   ============================================================ */
+
+#define US_PER_S  1000000.0
+#define US_PER_H  3600000000.0
+#define US_PER_DAY 86400000000ULL
+#define NEVER     UINT64_MAX
+#define MAX_EDGES 16
+
+static PlantConfig cfg;
+static PlantPins   pins;
+static PlantStats  st;
+
+static uint64_t now    = 0;
+static uint8_t  valves = 0;
+static double   level  = 0;           // Liter
+static double   creep  = 0;           // ppm über Grundwert
+static bool     swimLow = false, swimHigh = false, atMax = false;
+
+/* Flowmeter: Phase 0..1 der laufenden Periode, Periode gestreut */
+struct Meter{
+  uint8_t  pin;
+  double   hz;
+  double   phase;
+  double   mul;
+  uint32_t* count;
+};
+static Meter meters[2];
+
+/* anstehende Pinflanken (Prellen), nach Zeit sortiert */
+struct Edge{
+  uint64_t us;
+  uint8_t  pin;
+  uint8_t  level;
+};
+static Edge    edges[MAX_EDGES];
+static uint8_t edgeN = 0;
+
+/* Zapfungen */
+static uint32_t drawDay = 0;
+static uint8_t  drawIdx = 0;
+static uint64_t drawStart = NEVER, drawEnd = NEVER;
+static bool     drawing = false;
+
+/* Raten (Liter/s) bis zum nächsten Ereignis */
+static double feedLps, permLps, tankInLps, drawLps;
+
+/* eigene Zufallsfolge, unabhängig von halRandom() der Firmware */
+static uint32_t rnd = 1;
+
+static double u01()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 17;
+  rnd ^= rnd << 5;
+  return (rnd >> 8) * (1.0 / 16777216.0);
+}
+
+/* ============================================================
+   HELPERS
+   ============================================================ */
+
+static bool valve(uint8_t a) { return valves & ACT(a); }
+
+static bool leaking()
+{
+  return cfg.leakForSec &&
+         now >= cfg.leakAtSec * (uint64_t)US_PER_S &&
+         now <  (cfg.leakAtSec + cfg.leakForSec) * (uint64_t)US_PER_S;
+}
+
+static double days()
+{
+  return now / (double)US_PER_DAY;
+}
+
+static void pushEdge(uint64_t us, uint8_t pin, uint8_t lv)
+{
+  if(edgeN >= MAX_EDGES) return;
+  uint8_t i = edgeN++;
+  while(i > 0 && edges[i - 1].us > us) { edges[i] = edges[i - 1]; i--; }
+  edges[i] = { us, pin, lv };
+}
+
+static void dropEdges(uint8_t pin)
+{
+  uint8_t n = 0;
+  for(uint8_t i = 0; i < edgeN; i++)
+    if(edges[i].pin != pin) edges[n++] = edges[i];
+  edgeN = n;
+}
+
+/* Schwimmer: schwimmt = LOW (aktiv), danach prellen */
+static void setFloat(uint8_t pin, bool swim)
+{
+  static const uint16_t bounceMs[] = { 2, 5, 9, 14, 20, 27, 35, 44 };
+
+  dropEdges(pin);
+  uint8_t lv = swim ? LOW : HIGH;
+  hostPinWrite(pin, lv);
+  st.floatEdges++;
+
+  for(uint8_t k = 0; k < cfg.bounceEdges && k < 8; k++)
+    pushEdge(now + bounceMs[k] * 1000ULL, pin, (k & 1) ? lv : !lv);
+}
+
+static void nextDraw()
+{
+  if(!cfg.drawsPerDay || cfg.drawLitersDay <= 0) { drawStart = NEVER; return; }
+
+  /* über den Tag (6..22 Uhr) verteilt, Zeit und Menge gestreut */
+  double slotH  = 16.0 / cfg.drawsPerDay;
+  double hour   = 6.0 + (drawIdx + 0.5) * slotH + (u01() - 0.5) * slotH * 0.5;
+  double liters = cfg.drawLitersDay / cfg.drawsPerDay * (0.6 + 0.8 * u01());
+
+  drawStart = drawDay * US_PER_DAY + (uint64_t)(hour * US_PER_H);
+  drawEnd   = drawStart + (uint64_t)(liters / cfg.drawLpm * 60.0 * US_PER_S);
+
+  if(++drawIdx >= cfg.drawsPerDay) { drawIdx = 0; drawDay++; }
+}
+
+static void updateRates()
+{
+  bool pump = valve(ACT_RELAY);
+
+  feedLps = 0;
+  if(valve(ACT_WIN)) feedLps = (pump ? cfg.feedLpm : cfg.feedNoPumpLpm) / 60.0;
+  else if(leaking()) feedLps = cfg.leakLpm / 60.0;
+
+  /* Permeat nur mit Pumpe und offenem Abgang (Tank oder Spülweg) */
+  permLps = 0;
+  if(valve(ACT_WIN) && pump && (valve(ACT_OOUT) || valve(ACT_OTOS)))
+    permLps = max(0.1, 1.0 - cfg.foulPerDay * days()) * cfg.permLpm / 60.0;
+
+  tankInLps = valve(ACT_OOUT) ? permLps : 0;
+  drawLps   = drawing ? cfg.drawLpm / 60.0 : 0;
+
+  meters[FLOW_IN].hz  = feedLps   * cfg.pulsesPerLiterIn;
+  meters[FLOW_OUT].hz = tankInLps * cfg.pulsesPerLiterOut;
+}
+
+/* Füllstandsänderung (leerer Tank liefert nur, was zuläuft) */
+static double levelRate()
+{
+  double r = tankInLps - drawLps;
+  if(level <= 0 && r < 0) return 0;
+  if(atMax && r > 0) return 0;
+  return r;
+}
+
+/* ============================================================
+   INTEGRATION
+   ============================================================ */
+
+static void integrate(uint64_t to)
+{
+  if(to <= now) return;
+  double dt = (to - now) / US_PER_S;
+
+  double r     = levelRate();
+  double drawn = drawLps * dt;
+  if(level <= 0 && tankInLps < drawLps) {
+    st.shortL += (drawLps - tankInLps) * dt;
+    drawn = tankInLps * dt;
+  }
+
+  level = constrain(level + r * dt, 0.0, (double)cfg.tankMaxL);
+
+  st.fedL    += feedLps * dt;
+  st.tankInL += tankInLps * dt;
+  st.drainL  += (feedLps - tankInLps) * dt;
+  st.drawnL  += drawn;
+
+  if(permLps > 0) creep *= exp(-dt / cfg.flushTauS);
+  else            creep += (cfg.creepPpm - creep) * (1.0 - exp(-dt * US_PER_S / (cfg.creepTauH * US_PER_H)));
+
+  for(Meter& m : meters)
+    if(m.hz > 0) m.phase += dt * m.hz / m.mul;
+
+  now = to;
+}
+
+/* Zeit bis der Füllstand thr erreicht (Richtung über rate) */
+static uint64_t crossing(double thr, bool above)
+{
+  double r = levelRate();
+  if(above  && (r <= 0 || level >= thr)) return NEVER;
+  if(!above && (r >= 0 || level <  thr)) return NEVER;
+
+  double s = (thr - level) / r;
+  return now + (uint64_t)ceil(s * US_PER_S) + 1;
+}
+
+static uint64_t nextEvent()
+{
+  uint64_t t = NEVER;
+
+  for(const Meter& m : meters)
+    if(m.hz > 0)
+      t = min(t, now + (uint64_t)ceil((1.0 - m.phase) * m.mul / m.hz * US_PER_S));
+
+  if(edgeN) t = min(t, edges[0].us);
+
+  t = min(t, crossing(cfg.tankLowL,  !swimLow));
+  t = min(t, crossing(cfg.tankHighL, !swimHigh));
+  if(level > 0)  t = min(t, crossing(0, false));
+  if(!atMax)     t = min(t, crossing(cfg.tankMaxL, true));
+
+  t = min(t, drawing ? drawEnd : drawStart);
+
+  if(cfg.leakForSec) {
+    uint64_t a = cfg.leakAtSec * (uint64_t)US_PER_S;
+    uint64_t b = a + cfg.leakForSec * (uint64_t)US_PER_S;
+    if(now < a)      t = min(t, a);
+    else if(now < b) t = min(t, b);
+  }
+  return t;
+}
+
+/* Ereignisse zum aktuellen Zeitpunkt; true = Eingang der Firmware geändert */
+static bool handleEvents()
+{
+  bool input = false;
+
+  for(Meter& m : meters) {
+    if(m.hz <= 0 || m.phase < 1.0 - 1e-9) continue;
+    m.phase = max(0.0, m.phase - 1.0);
+    m.mul   = 1.0 + cfg.pulseJitter * (2.0 * u01() - 1.0);
+    (*m.count)++;
+    hostPinWrite(m.pin, HIGH);       // ISR auf RISING
+    hostPinWrite(m.pin, LOW);
+    input = true;
+  }
+
+  while(edgeN && edges[0].us <= now) {
+    hostPinWrite(edges[0].pin, edges[0].level);
+    memmove(edges, edges + 1, --edgeN * sizeof(Edge));
+    input = true;
+  }
+
+  bool low  = level >= cfg.tankLowL;
+  bool high = level >= cfg.tankHighL;
+  if(low  != swimLow)  { swimLow  = low;  setFloat(pins.floatLow,  low);  input = true; }
+  if(high != swimHigh) { swimHigh = high; setFloat(pins.floatHigh, high); input = true; }
+
+  if(level >= cfg.tankMaxL && !atMax) { atMax = true; st.overflows++; }
+  else if(level < cfg.tankMaxL)         atMax = false;
+
+  if(drawing && now >= drawEnd) { drawing = false; nextDraw(); }
+  if(!drawing && now >= drawStart) drawing = true;
+
+  st.levelMinL = min(st.levelMinL, (float)level);
+  st.levelMaxL = max(st.levelMaxL, (float)level);
+
+  updateRates();
+  return input;
+}
+
+/* ============================================================
+   API
+   ============================================================ */
+
+void plantInit(const PlantConfig& c, const PlantPins& p, uint32_t seed)
+{
+  cfg  = c;
+  pins = p;
+  cfg.bounceEdges &= ~1;             // gerade -> Endpegel stimmt
+  rnd  = seed ? seed : 1;
+  st   = {};
+
+  now    = hostNowUs();
+  valves = 0;
+  level  = cfg.tankStartL;
+  creep  = cfg.creepPpm;             // erster Start nach langem Stillstand
+  edgeN  = 0;
+
+  meters[FLOW_IN]  = { pins.flowIn,  0, 0, 1, &st.pulsesIn  };
+  meters[FLOW_OUT] = { pins.flowOut, 0, 0, 1, &st.pulsesOut };
+  hostPinWrite(pins.flowIn,  LOW);
+  hostPinWrite(pins.flowOut, LOW);
+
+  /* Startpegel ohne Prellen (vor inputsInit) */
+  swimLow  = level >= cfg.tankLowL;
+  swimHigh = level >= cfg.tankHighL;
+  hostPinWrite(pins.floatLow,  swimLow  ? LOW : HIGH);
+  hostPinWrite(pins.floatHigh, swimHigh ? LOW : HIGH);
+
+  st.levelMinL = st.levelMaxL = level;
+
+  drawDay = 0;
+  drawIdx = 0;
+  drawing = false;
+  nextDraw();
+  updateRates();
+}
+
+void plantSetValves(uint8_t act)
+{
+  if(act == valves) return;
+  integrate(hostNowUs());
+  valves = act;
+  updateRates();
+}
+
+bool plantAdvance(uint64_t toUs, bool stopOnInput)
+{
+  integrate(hostNowUs());            // Firmware-Zeit kann vorgelaufen sein
+
+  for(;;) {
+    uint64_t t = nextEvent();
+    if(t > toUs) break;
+
+    integrate(t);
+    hostSetUs(now);
+    if(handleEvents() && stopOnInput) return true;
+  }
+
+  integrate(toUs);
+  hostSetUs(now);
+  return false;
+}
+
+float plantTdsPpm()
+{
+  return cfg.feedTds * (1.0f - cfg.rejection) + (float)creep;
+}
+
+void plantGetStats(PlantStats& out)
+{
+  out = st;
+  out.levelL = (float)level;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   PLANT
+   Modell der Anlage hinter der Platine, ereignisgenau in µs:
+
+     Ventile (Aktor-Maske) -> Zulauf / Permeat / Spülweg
+     Zulauf  -> Flowmeter IN  (Pulse an PIN_WCOUNT_IN)
+     Permeat -> Flowmeter OUT (Pulse an PIN_WCOUNT_OUT) -> Tank
+     Tank    -> Schwimmer unten/oben (aktiv LOW, mit Prellen)
+     Entnahme: feste Zapfungen je Tag (deterministisch aus seed)
+     Membran: Permeat-TDS = Zulauf x (1 - Rückhalt) + Stillstands-
+              anstieg, der mit Durchfluss wieder ausgespült wird
+
+   Zwischen zwei Ereignissen sind alle Raten konstant, Füllstand
+   und TDS werden exakt fortgeschrieben.
+   ============================================================ */
+
+struct PlantPins{
+  uint8_t flowIn, flowOut;
+  uint8_t floatLow, floatHigh;
+};
+
+struct PlantConfig{
+  /* Tank (Liter) */
+  float tankStartL    = 20.0f;
+  float tankLowL      = 8.0f;        // Schwimmer unten schwimmt ab hier
+  float tankHighL     = 24.0f;       // Schwimmer oben
+  float tankMaxL      = 30.0f;
+
+  /* Hydraulik */
+  float feedLpm       = 1.20f;       // Zulauf mit Pumpe (Ausbeute ~40 %)
+  float feedNoPumpLpm = 0.60f;       // Zulauf nur Leitungsdruck
+  float permLpm       = 0.50f;       // Permeat, neue Membran
+  float foulPerDay    = 0.002f;      // Permeat-Verlust je Tag (Anteil)
+  float pulsesPerLiterIn  = 1075.0f; // echte Geber (können von settings abweichen)
+  float pulsesPerLiterOut = 880.0f;
+  float pulseJitter   = 0.03f;       // Periodenstreuung (relativ)
+
+  /* Membran / TDS */
+  float feedTds       = 350.0f;
+  float rejection     = 0.97f;
+  float creepPpm      = 60.0f;       // Anstieg nach langem Stillstand
+  float creepTauH     = 4.0f;        // Aufbau im Stillstand
+  float flushTauS     = 12.0f;       // Abbau bei Durchfluss
+
+  /* Verbrauch */
+  float   drawLitersDay = 14.0f;
+  uint8_t drawsPerDay   = 4;
+  float   drawLpm       = 2.0f;
+
+  /* Schwimmer */
+  uint8_t bounceEdges   = 4;         // Prellflanken je Schaltpunkt (gerade)
+
+  /* Störung: Einlassventil undicht (0 = aus) */
+  uint32_t leakAtSec    = 0;
+  uint32_t leakForSec   = 0;
+  float    leakLpm      = 0.5f;
+};
+
+struct PlantStats{
+  double   fedL, tankInL, drawnL, drainL, shortL;   // shortL = nicht lieferbar (Tank leer)
+  uint32_t pulsesIn, pulsesOut;
+  uint32_t floatEdges;
+  float    levelL, levelMinL, levelMaxL;
+  uint32_t overflows;                               // Tank über tankMaxL
+};
+
+void plantInit(const PlantConfig& cfg, const PlantPins& pins, uint32_t seed);
+
+/* Aktor-Maske (ACT_* aus controller.h), wie sie an den Ventilen anliegt */
+void plantSetValves(uint8_t act);
+
+/* bis toUs laufen; Pulse/Schwimmer gehen als Pinflanken an die
+   Firmware. stopOnInput: beim ersten Eingangs-Ereignis anhalten
+   (Aufrufer verfeinert dann den Takt). true = angehalten, die Uhr
+   steht auf dem Ereignis; sonst auf toUs */
+bool plantAdvance(uint64_t toUs, bool stopOnInput);
+
+float plantTdsPpm();
+void  plantGetStats(PlantStats& out);
@@ -0,0 +1,377 @@
+/*********************************************************************
+  OSMOSE REPLAY (Linux)
+
+  Spielt eine Aufzeichnung der Roh-Eingänge (recorder.h, vom Gerät
+  über GET /api/rec oder aus ./osmose_sim --record) durch dieselben
+  Firmware-Module wie main.cpp: inputs (Entprellung), flow_meter,
+  tdsLookup und ctlStep. Jedes Ereignis läuft mit der virtuellen
+  Uhr auf seinem Zeitstempel, in der aufgezeichneten Reihenfolge.
+
+  Prüfung: nach jedem Statewechsel hat die Firmware State und
+  Aktoren mitgeschrieben (REC_MARK_STATE); weicht die Wiedergabe
+  davon ab, ist sie nicht bitgleich -> Exit-Code 1.
+
+  Aufruf:  ./osmose_replay rec.bin [--trace] [--verbose]
+*********************************************************************/
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+
+#include "host.h"
+
+#include "controller.h"
+#include "flow_meter.h"
+#include "inputs.h"
+#include "recorder.h"
+#include "settings.h"
+#include "tds_cal.h"
+
+// ---- Eingangs-IDs (= main.cpp, Reihenfolge der Aufzeichnung) ----
+enum InputId : uint8_t { IN_SAUTO, IN_SMANU, IN_WLOW, IN_WHIGH, IN_WERROR };
+
+Settings settings;
+
+static bool trace = false;
+
+
+/* ============================================================
+   FIRMWARE (Verdrahtung wie main.cpp)
+   ============================================================ */
+
+static Controller ctl;
+static InputDef   inDefs[INPUTS_MAX];
+static uint8_t    inCount = 0;
+
+static uint32_t cntIn = 0, cntOut = 0;
+static float    tdsNow = 0.0f;
+static uint16_t adcCode = 0;
+static bool     webStart = false, webStop = false;
+
+static const char* currentModeStr()
+{
+  if(inputActive(IN_SMANU)) return "MANUAL";
+  if(inputActive(IN_SAUTO)) return "AUTO";
+  return "OFF";
+}
+
+/* ============================================================
+   PRÜFUNG / STATISTIK
+   ============================================================ */
+
+static uint64_t startMs = 0;
+static bool     expectMark = false;
+static uint32_t transitions = 0, verified = 0, mismatches = 0, lostEvents = 0;
+static uint32_t ticks = 0, counts[8] = {};
+
+static void printStamp(uint64_t ms)
+{
+  ms -= startMs;
+  uint32_t s = ms / 1000;
+  printf("%3u:%02u:%02u.%03u", (unsigned)(s / 3600), (unsigned)(s / 60 % 60),
+         (unsigned)(s % 60), (unsigned)(ms % 1000));
+}
+
+static void mismatch(const char* what)
+{
+  if(!mismatches) {
+    printStamp(hostNowUs() / 1000);
+    printf("  MISMATCH: %s (state %s, act 0x%02X)\n", what, ctlStateName(ctl.state), ctl.act);
+  }
+  mismatches++;
+}
+
+/* ============================================================
+   EREIGNISSE
+   ============================================================ */
+
+static void controlTick(uint64_t ms)
+{
+  if(expectMark) mismatch("replayed transition not in recording");
+  expectMark = false;
+
+  CtlInputs in;
+  in.now      = (uint32_t)ms;
+  in.webStart = webStart;  webStart = false;
+  in.webStop  = webStop;   webStop  = false;
+  inputsPoll(in.now);
+  in.cntIn    = cntIn;
+  in.cntOut   = cntOut;
+
+  in.autoMode   = inputActive(IN_SAUTO);
+  in.manualMode = inputActive(IN_SMANU);
+  in.autoRose   = inputRose(IN_SAUTO);
+  in.manualRose = inputRose(IN_SMANU);
+  in.lowSwim    = inputActive(IN_WLOW);
+  in.highSwim   = inputActive(IN_WHIGH);
+  in.werror     = inputActive(IN_WERROR);
+  in.tds        = tdsNow;
+  in.hzIn       = flowHz(FLOW_IN);
+  in.hzOut      = flowHz(FLOW_OUT);
+
+  CtlOutputs o = ctlStep(ctl, in);
+  ticks++;
+
+  if(ctl.state == o.from) return;
+  transitions++;
+  expectMark = true;
+
+  if(!trace) return;
+  printStamp(ms);
+  printf("  %-6s  %-12s -> %-12s tds %6.1f  in %6u  out %6u  %s\n", currentModeStr(),
+         ctlStateName(o.from), ctlStateName(ctl.state), tdsNow, (unsigned)cntIn, (unsigned)cntOut,
+         (ctl.state == ERROR || ctl.state == INFO) ? ctl.msg : "");
+}
+
+static void stateMark(uint8_t state, uint8_t act)
+{
+  if(!expectMark) {
+    mismatch("recorded transition not replayed");
+    return;
+  }
+  expectMark = false;
+
+  if(state == ctl.state && act == ctl.act) verified++;
+  else mismatch("state/actuators differ from recording");
+}
+
+/* ============================================================
+   DEKODER
+   ============================================================ */
+
+struct Reader{
+  const uint8_t* p;
+  const uint8_t* end;
+  bool           bad = false;
+
+  uint8_t u8()
+  {
+    if(p >= end) { bad = true; return 0; }
+    return *p++;
+  }
+
+  uint32_t varint()
+  {
+    uint32_t v = 0;
+    for(uint8_t shift = 0; shift < 35; shift += 7) {
+      uint8_t b = u8();
+      v |= (uint32_t)(b & 0x7F) << shift;
+      if(!(b & 0x80)) return v;
+    }
+    bad = true;
+    return v;
+  }
+};
+
+static int32_t unzigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/* Bezugszeit wie recorder.cpp, aber 64 Bit */
+static uint64_t refMs = 0, refUs = 0;
+
+static void setRefMs(uint64_t ms)
+{
+  refMs = ms;
+  refUs = ms * 1000;
+  hostSetUs(refUs);
+}
+
+/* false = Ende der Aufzeichnung */
+static bool replayMark(Reader& r, uint8_t mark)
+{
+  switch(mark) {
+    case REC_MARK_INPUTS: {
+      uint32_t us = r.varint();
+      inCount = min(r.u8(), (uint8_t)INPUTS_MAX);
+      for(uint8_t i = 0; i < inCount; i++) {
+        inDefs[i].pin        = r.u8();
+        inDefs[i].debounceMs = r.u8();
+        inDefs[i].debounceMs |= r.u8() << 8;
+      }
+      uint8_t mask = r.u8();
+
+      refUs = us;
+      refMs = us / 1000;
+      hostSetUs(refUs);
+      startMs = refMs;
+      for(uint8_t i = 0; i < inCount; i++)
+        hostPinWrite(inDefs[i].pin, (mask & (1 << i)) ? LOW : HIGH);
+      inputsInit(inDefs, inCount);
+      return true;
+    }
+
+    case REC_MARK_CTL:
+      setRefMs(refMs + r.varint());
+      ctlInit(ctl, &settings, (uint32_t)refMs);
+      return true;
+
+    case REC_MARK_SETTINGS: {
+      uint8_t n = r.u8();
+      if(r.end - r.p < n) { r.bad = true; return false; }
+      if(!recUnpackSettings(r.p, n, settings)) r.bad = true;
+      r.p += n;
+      tdsCalApply(settings.tdsCal.c_str());
+      return true;
+    }
+
+    case REC_MARK_STATE: {
+      uint8_t state = r.u8();
+      uint8_t act   = r.u8();
+      stateMark(state, act);
+      return true;
+    }
+
+    case REC_MARK_LOST: {
+      uint32_t n = r.varint();
+      if(!lostEvents) {
+        printStamp(hostNowUs() / 1000);
+        printf("  LOST %u events (recorder ring full) - not bit-exact from here\n", (unsigned)n);
+      }
+      lostEvents += n;
+      return true;
+    }
+
+    case REC_MARK_END:
+      return false;
+  }
+
+  r.bad = true;
+  return false;
+}
+
+static bool replay(const std::vector<uint8_t>& data)
+{
+  if(data.size() < sizeof(RecHeader)) return false;
+
+  RecHeader h;
+  memcpy(&h, data.data(), sizeof(h));
+  if(h.magic != REC_MAGIC || h.version != REC_VERSION) {
+    fprintf(stderr, "not a recording (magic 0x%08X, version %u)\n", (unsigned)h.magic, h.version);
+    return false;
+  }
+
+  Reader r = { data.data() + sizeof(h), data.data() + data.size() };
+
+  while(r.p < r.end && !r.bad) {
+    uint8_t tag = r.u8();
+    uint8_t arg = tag >> 3;
+    counts[tag & 7]++;
+
+    switch((RecType)(tag & 7)) {
+      case REC_TICK: {
+        uint32_t n = arg < 31 ? arg + 1 : r.varint();
+        for(uint32_t i = 0; i < n; i++) {
+          setRefMs(refMs + h.tickMs);
+          controlTick(refMs);
+        }
+        break;
+      }
+
+      case REC_TICKAT:
+        setRefMs(refMs + r.varint());
+        controlTick(refMs);
+        break;
+
+      case REC_PULSE: {
+        uint64_t us = refUs + r.varint();
+        hostSetUs(us);
+        if(arg == FLOW_IN  && flowPulse(FLOW_IN,  (uint32_t)us)) cntIn++;
+        if(arg == FLOW_OUT && flowPulse(FLOW_OUT, (uint32_t)us)) cntOut++;
+        break;
+      }
+
+      case REC_EDGE: {
+        uint8_t  id = arg & 7;
+        uint64_t ms = refMs + r.varint();
+        hostSetUs(ms * 1000);
+        if(id < inCount) hostPinIrq(inDefs[id].pin, (arg & 8) ? LOW : HIGH);
+        break;
+      }
+
+      case REC_ADC:
+        adcCode += unzigzag(r.varint());
+        tdsNow = tdsLookup(adcCode);
+        break;
+
+      case REC_FLOW: {
+        uint64_t us = refUs + r.varint();
+        hostSetUs(us);
+        flowUpdate((uint32_t)us);
+        break;
+      }
+
+      case REC_CMD:
+        if(arg == REC_CMD_START) webStart = true;
+        if(arg == REC_CMD_STOP)  webStop  = true;
+        break;
+
+      case REC_MARK:
+        if(!replayMark(r, arg)) {
+          if(r.bad) break;
+          r.p = r.end;
+        }
+        break;
+    }
+  }
+
+  if(r.bad) fprintf(stderr, "recording truncated or corrupt at byte %ld\n",
+                    (long)(r.p - data.data()));
+  return true;
+}
+
+/* ============================================================
+   MAIN
+   ============================================================ */
+
+int main(int argc, char** argv)
+{
+  const char* path = nullptr;
+  bool verbose = false;
+
+  bool ok = true;
+  for(int i = 1; i < argc; i++) {
+    if     (!strcmp(argv[i], "--trace"))   trace   = true;
+    else if(!strcmp(argv[i], "--verbose")) verbose = true;
+    else if(argv[i][0] != '-' && !path)    path    = argv[i];
+    else ok = false;
+  }
+  if(!ok || !path) {
+    fprintf(stderr, "usage: %s rec.bin [--trace] [--verbose]\n", argv[0]);
+    return 2;
+  }
+
+  FILE* f = fopen(path, "rb");
+  if(!f) { perror(path); return 2; }
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+
+  hostSetQuiet(!verbose);
+
+  auto t0 = std::chrono::steady_clock::now();
+  if(!replay(data)) return 2;
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  if(expectMark) mismatch("replayed transition not in recording");
+
+  double spanS = (refMs - startMs) / 1000.0;
+  printf("\n== replay\n");
+  printf("%lu bytes, %.1f h recorded, %u control ticks, final state %s\n",
+         (unsigned long)data.size(), spanS / 3600.0, (unsigned)ticks, ctlStateName(ctl.state));
+  printf("events: tick %u+%u  pulse %u  edge %u  adc %u  flow %u  cmd %u  mark %u\n",
+         (unsigned)counts[REC_TICK], (unsigned)counts[REC_TICKAT], (unsigned)counts[REC_PULSE],
+         (unsigned)counts[REC_EDGE], (unsigned)counts[REC_ADC], (unsigned)counts[REC_FLOW],
+         (unsigned)counts[REC_CMD], (unsigned)counts[REC_MARK]);
+  printf("pulses counted in %u  out %u\n", (unsigned)cntIn, (unsigned)cntOut);
+  printf("transitions %u  verified %u  mismatches %u  lost events %u\n",
+         (unsigned)transitions, (unsigned)verified, (unsigned)mismatches, (unsigned)lostEvents);
+  printf("%s\n", mismatches ? "NOT bit-exact" : lostEvents ? "bit-exact up to lost events" : "bit-exact");
+
+  fprintf(stderr, "replayed %.1f h in %.2f s (%.0fx real time)\n",
+          spanS / 3600.0, wall, spanS / max(wall, 1e-6));
+  return mismatches ? 1 : 0;
+}
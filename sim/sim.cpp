@@ -0,0 +1,664 @@
+/*********************************************************************
+  OSMOSE SIMULATOR (Linux)
+
+  Firmware-Logik gegen ein Anlagenmodell (plant.cpp) unter einer
+  virtuellen Uhr: Controller, Eingänge, Flowmeter, TDS-Tabelle,
+  Ausgänge, History und Totals laufen unverändert aus src/, nur
+  WiFi/Web fehlen; die Hardware kommt aus dem POSIX-Backend der
+  HAL (src/posix/).
+
+  Die Task-Verdrahtung entspricht main.cpp (gleiche Raten, gleiche
+  Reihenfolge). In ruhigen Phasen (IDLE/INFO/ERROR, alle Ventile
+  zu, kein Eingangsereignis) laufen die Control-Tasks im
+  --idle-ms-Raster; jede Flanke schaltet sofort zurück auf 10 ms.
+  --idle-ms 10 = durchgehend exakter Takt.
+
+  Aufruf:  ./osmose_sim [--days 30] [--seed 1] [--mode auto|manual]
+                        [--draw 14] [--idle-ms 1000] [--leak-day D]
+                        [--reset-min 60] [--fs DIR] [--out DIR]
+                        [--record] [--trace] [--verbose]
+
+  --record schreibt wie settings.recordInputs die Roh-Eingänge
+  nach DIR/rec.bin (ohne Größengrenze) -> ./osmose_replay
+
+  stdout ist bei gleichen Parametern bitgleich; Laufzeit und
+  Geschwindigkeit gehen nach stderr.
+*********************************************************************/
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <chrono>
+#include <dirent.h>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "plant.h"
+
+#include "controller.h"
+#include "flow_meter.h"
+#include "hal.h"
+#include "history.h"
+#include "inputs.h"
+#include "outputs.h"
+#include "recorder.h"
+#include "settings.h"
+#include "tds_cal.h"
+#include "totals.h"
+
+
+// ================= PINMAP (= main.cpp) =================
+#define PIN_WCOUNT_IN   3
+#define PIN_WCOUNT_OUT  4
+#define PIN_WHIGH       5
+#define PIN_WLOW        21
+#define PIN_WERROR      20
+#define PIN_SAUTO       10
+#define PIN_SMANU       8
+
+// ---- Task-Raten (= main.cpp) ----
+#define TASK_CONTROL_MS     10
+#define TASK_SENSE_MS       20     // TDS_ADC_POLL_MS
+#define TASK_FLOW_MS       250
+#define TASK_HISTORY_MS   2000
+
+// ---- Eingänge (= main.cpp) ----
+enum InputId : uint8_t { IN_SAUTO, IN_SMANU, IN_WLOW, IN_WHIGH, IN_WERROR, IN_COUNT };
+
+#define SWITCH_DEBOUNCE_MS  30
+#define FLOAT_DEBOUNCE_MS   50
+#define WERROR_DEBOUNCE_MS 100
+
+static const InputDef inputDefs[IN_COUNT] = {
+  { PIN_SAUTO,  SWITCH_DEBOUNCE_MS },
+  { PIN_SMANU,  SWITCH_DEBOUNCE_MS },
+  { PIN_WLOW,   FLOAT_DEBOUNCE_MS  },
+  { PIN_WHIGH,  FLOAT_DEBOUNCE_MS  },
+  { PIN_WERROR, WERROR_DEBOUNCE_MS },
+};
+
+// ---- Simulator ----
+#define SIM_EPOCH0        1735689600UL   // 2025-01-01 00:00:00 UTC
+#define SIM_FINE_HOLD_MS  1000           // nach Eingangsflanke fein (> Entprellung)
+#define SIM_SWITCH_MS     5000           // Bediener: Schalter so lange auf AUS
+#define SIM_OPERATOR_MS  60000           // danach erst wieder eingreifen
+#define US_PER_MS         1000ULL
+#define US_PER_DAY        86400000000ULL
+#define NEVER             UINT64_MAX
+
+#if SIM_JSON_SETTINGS
+#include "config_settings.h"               // settings + config.json aus src/ (env:native)
+#else
+Settings settings;                         // Standardwerte, ohne ArduinoJson (Makefile)
+#endif
+
+
+/* ============================================================
+   OPTIONEN
+   ============================================================ */
+
+enum SwitchPos : uint8_t { SW_OFF, SW_AUTO, SW_MANUAL };
+
+struct SimOptions{
+  uint32_t    days     = 30;
+  uint32_t    seed     = 1;
+  SwitchPos   mode     = SW_AUTO;
+  float       drawL    = 14.0f;
+  uint32_t    idleMs   = 1000;
+  int32_t     leakDay  = -1;
+  uint32_t    resetMin = 60;           // Bediener quittiert ERROR (0 = nie)
+  const char* fsDir    = "sim_fs";
+  const char* outDir   = nullptr;
+  bool        record   = false;
+  bool        trace    = false;
+  bool        verbose  = false;
+};
+
+static SimOptions opt;
+
+static bool parseArgs(int argc, char** argv)
+{
+  for(int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if(!strcmp(a, "--trace"))   { opt.trace = true;   continue; }
+    if(!strcmp(a, "--verbose")) { opt.verbose = true; continue; }
+    if(!strcmp(a, "--record"))  { opt.record = true;  continue; }
+    if(!v) return false;
+    i++;
+
+    if     (!strcmp(a, "--days"))      opt.days     = strtoul(v, nullptr, 10);
+    else if(!strcmp(a, "--seed"))      opt.seed     = strtoul(v, nullptr, 10);
+    else if(!strcmp(a, "--draw"))      opt.drawL    = atof(v);
+    else if(!strcmp(a, "--idle-ms"))   opt.idleMs   = strtoul(v, nullptr, 10);
+    else if(!strcmp(a, "--leak-day"))  opt.leakDay  = atoi(v);
+    else if(!strcmp(a, "--reset-min")) opt.resetMin = strtoul(v, nullptr, 10);
+    else if(!strcmp(a, "--fs"))        opt.fsDir    = v;
+    else if(!strcmp(a, "--out"))       opt.outDir   = v;
+    else if(!strcmp(a, "--mode")) {
+      if     (!strcmp(v, "auto"))   opt.mode = SW_AUTO;
+      else if(!strcmp(v, "manual")) opt.mode = SW_MANUAL;
+      else return false;
+    }
+    else return false;
+  }
+
+  /* Raster der Ruhephase: Vielfaches des Control-Takts */
+  opt.idleMs = max<uint32_t>(TASK_CONTROL_MS, opt.idleMs / TASK_CONTROL_MS * TASK_CONTROL_MS);
+  return opt.days > 0;
+}
+
+
+/* ============================================================
+   FIRMWARE (Verdrahtung wie main.cpp)
+   ============================================================ */
+
+static Controller ctl;
+
+volatile uint32_t cntIn = 0, cntOut = 0;
+static void isrIn()
+{
+  uint32_t t = micros();
+  if(flowPulse(FLOW_IN, t)) cntIn++;
+  recPulse(FLOW_IN, t);
+}
+
+static void isrOut()
+{
+  uint32_t t = micros();
+  if(flowPulse(FLOW_OUT, t)) cntOut++;
+  recPulse(FLOW_OUT, t);
+}
+
+static float tdsNow = 0.0f;
+static float currentFlowLpm = 0.0f, currentFlowInLpm = 0.0f;
+
+static const char* currentModeStr()
+{
+  if(inputActive(IN_SMANU)) return "MANUAL";
+  if(inputActive(IN_SAUTO)) return "AUTO";
+  return "OFF";
+}
+
+static float litersNow()
+{
+  return (ctl.state == PRODUCTION) ? ctlProducedLiters(ctl, cntOut) : ctl.lastProducedLiters;
+}
+
+/* ============================================================
+   STATISTIK
+   ============================================================ */
+
+struct DayStats{
+  uint32_t runs, errors, autoflush, service;
+  float    liters;
+  float    levelMin, levelMax;
+  double   tdsSum;
+  uint32_t tdsN;
+};
+
+static DayStats day;
+static uint32_t dayIndex = 0;
+
+static uint32_t stateEntries[STATE_COUNT];
+static uint64_t stateMs[STATE_COUNT];
+static uint32_t trans[STATE_COUNT][STATE_COUNT];
+static uint64_t stateSinceMs = 0;
+
+static std::map<std::string, uint32_t> messages, stopReasons;
+static uint32_t pushes = 0, runs = 0, resets = 0, controlTicks = 0;
+static float    litersTotal = 0;
+
+static void printStamp(FILE* f)
+{
+  uint64_t ms = hostNowUs() / US_PER_MS;
+  uint32_t s  = ms / 1000;
+  fprintf(f, "d%02u %02u:%02u:%02u.%03u",
+          (unsigned)(s / 86400), (unsigned)(s / 3600 % 24), (unsigned)(s / 60 % 60),
+          (unsigned)(s % 60), (unsigned)(ms % 1000));
+}
+
+static void dayReset()
+{
+  PlantStats p;
+  plantGetStats(p);
+  day = {};
+  day.levelMin = day.levelMax = p.levelL;
+}
+
+static void dayPrint()
+{
+  time_t t = SIM_EPOCH0 + (time_t)dayIndex * 86400;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char date[16];
+  strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+
+  printf("day %3u  %s  runs %2u  %6.2f L  flush %2u  service %u  errors %u  level %5.1f..%5.1f L  tds %5.1f\n",
+         (unsigned)dayIndex, date, (unsigned)day.runs, day.liters, (unsigned)day.autoflush,
+         (unsigned)day.service, (unsigned)day.errors, day.levelMin, day.levelMax,
+         day.tdsN ? day.tdsSum / day.tdsN : 0.0);
+}
+
+/* ============================================================
+   AUSGÄNGE / EFFEKTE (wie applyControl in main.cpp)
+   ============================================================ */
+
+static void setActuators(uint8_t act)
+{
+  outSetMask(ACT(ACT_WIN) | ACT(ACT_OOUT) | ACT(ACT_OTOS) | ACT(ACT_RELAY), act);
+}
+
+static void onTransition(State from, State to)
+{
+  uint64_t nowMs = hostNowUs() / US_PER_MS;
+  stateMs[from] += nowMs - stateSinceMs;
+  stateSinceMs = nowMs;
+
+  stateEntries[to]++;
+  trans[from][to]++;
+
+  if(to == ERROR) day.errors++;
+  if(to == AUTOFLUSH) day.autoflush++;
+  if(to == SERVICEFLUSH) day.service++;
+  if((to == ERROR || to == INFO) && ctl.msg[0]) messages[ctl.msg]++;
+
+  if(!opt.trace) return;
+  printStamp(stdout);
+  printf("  %-6s  %-12s -> %-12s %s\n", currentModeStr(), ctlStateName(from), ctlStateName(to),
+         (to == ERROR || to == INFO) ? ctl.msg : "");
+}
+
+static void applyControl(const CtlOutputs& o)
+{
+  if(o.actChanged)
+    setActuators(o.act);
+
+  if(ctl.state != o.from) {
+    onTransition(o.from, ctl.state);
+    currentFlowLpm = 0.0f;
+    recState(ctl.state, o.act);
+  }
+
+  if(o.fx & CTL_FX_HISTORY_START)
+    historyStartProduction(currentModeStr());
+
+  if(o.fx & CTL_FX_HISTORY_END) {
+    historyEndProduction(ctl.lastStopReason, ctl.lastProducedLiters);
+    stopReasons[ctl.lastStopReason]++;
+    day.runs++;
+    day.liters  += ctl.lastProducedLiters;
+    litersTotal += ctl.lastProducedLiters;
+    runs++;
+  }
+
+  if(o.fx & CTL_FX_PUSH)
+    pushes++;
+}
+
+/* ============================================================
+   TASKS (= main.cpp)
+   ============================================================ */
+
+/* ppm -> ADC-Rohwert über die Firmware-Tabelle (monoton) */
+static float tdsRawFor(float ppm)
+{
+  float lo = 0, hi = TDS_LUT_SIZE - 1;
+  for(uint8_t i = 0; i < 16; i++) {
+    float mid = (lo + hi) * 0.5f;
+    if(tdsLookup(mid) < ppm) lo = mid;
+    else                     hi = mid;
+  }
+  return (lo + hi) * 0.5f;
+}
+
+static void taskSense()
+{
+  float raw = tdsRawFor(plantTdsPpm());
+  recAdc(tdsCode(raw));
+  tdsNow = tdsLookup(raw);
+}
+
+static void taskControl()
+{
+  CtlInputs in;
+
+  recLock();
+  in.now        = millis();
+  in.webStart   = false;
+  in.webStop    = false;
+  recTick(in.now);
+  inputsPoll(in.now);
+  in.cntIn      = cntIn;
+  in.cntOut     = cntOut;
+  recUnlock();
+
+  in.autoMode   = inputActive(IN_SAUTO);
+  in.manualMode = inputActive(IN_SMANU);
+  in.autoRose   = inputRose(IN_SAUTO);
+  in.manualRose = inputRose(IN_SMANU);
+  in.lowSwim    = inputActive(IN_WLOW);
+  in.highSwim   = inputActive(IN_WHIGH);
+  in.werror     = inputActive(IN_WERROR);
+  in.tds        = tdsNow;
+  in.hzIn       = flowHz(FLOW_IN);
+  in.hzOut      = flowHz(FLOW_OUT);
+
+  applyControl(ctlStep(ctl, in));
+  controlTicks++;
+}
+
+static void taskFlow()
+{
+  uint32_t us = micros();
+  flowUpdate(us);
+  recFlow(us);
+  currentFlowLpm   = ctlFlowOutLpm(ctl, flowHz(FLOW_OUT));
+  currentFlowInLpm = ctlFlowInLpm(ctl, flowHz(FLOW_IN));
+}
+
+static void taskHistory()
+{
+  historyAddSample2s(tdsNow, litersNow(), currentFlowLpm, currentFlowInLpm, (uint8_t)ctl.state);
+  historyLoop();
+  totalsUpdatePulses(cntOut, cntIn);
+
+  PlantStats p;
+  plantGetStats(p);
+  day.levelMin = min(day.levelMin, p.levelL);
+  day.levelMax = max(day.levelMax, p.levelL);
+  if(ctl.state == PRODUCTION) { day.tdsSum += tdsNow; day.tdsN++; }
+}
+
+struct SimTask{
+  const char* name;
+  uint32_t    periodMs;
+  bool        stretch;                 // in Ruhe im --idle-ms-Raster
+  void      (*fn)();
+  uint64_t    due;
+};
+
+/* Reihenfolge = schedulerInit() in main.cpp */
+static SimTask tasks[] = {
+  { "control", TASK_CONTROL_MS, true,  taskControl, 0 },
+  { "sense",   TASK_SENSE_MS,   true,  taskSense,   0 },
+  { "flow",    TASK_FLOW_MS,    true,  taskFlow,    0 },
+  { "history", TASK_HISTORY_MS, false, taskHistory, 0 },
+  { "rec",     REC_FLUSH_MS,    false, recFlush,    NEVER },   // nur mit --record
+};
+
+/* ============================================================
+   BEDIENER
+   Schalter steht auf --mode. ERROR wird nach --reset-min per
+   AUS/EIN quittiert; im Handbetrieb wird bei leerem Tank
+   (unterer Schwimmer trocken) per AUS/HAND neu gestartet.
+   ============================================================ */
+
+static uint64_t fineUntilUs = 0;
+static uint64_t opDueUs = NEVER;      // Schalter zurück auf --mode
+static uint64_t opHoldUs = 0;         // bis dahin nicht erneut schalten
+
+static void setSwitch(SwitchPos p)
+{
+  hostPinWrite(PIN_SAUTO, p == SW_AUTO   ? LOW : HIGH);
+  hostPinWrite(PIN_SMANU, p == SW_MANUAL ? LOW : HIGH);
+  fineUntilUs = hostNowUs() + SIM_FINE_HOLD_MS * US_PER_MS;
+}
+
+static void operatorStep()
+{
+  uint64_t now = hostNowUs();
+
+  if(opDueUs != NEVER) {
+    if(now < opDueUs) return;
+    setSwitch(opt.mode);
+    opDueUs  = NEVER;
+    opHoldUs = now + SIM_OPERATOR_MS * US_PER_MS;
+    return;
+  }
+  if(now < opHoldUs) return;
+
+  bool toggle = false;
+  if(ctl.state == ERROR && opt.resetMin &&
+     millis() - ctl.stateStart >= opt.resetMin * 60000UL) {
+    toggle = true;
+    resets++;
+  }
+  if(opt.mode == SW_MANUAL && (ctl.state == IDLE || ctl.state == INFO) && !inputActive(IN_WLOW))
+    toggle = true;
+
+  if(!toggle) return;
+  setSwitch(SW_OFF);
+  opDueUs = now + SIM_SWITCH_MS * US_PER_MS;
+}
+
+/* ============================================================
+   LOOP
+   ============================================================ */
+
+static bool quiet()
+{
+  return (ctl.state == IDLE || ctl.state == INFO || ctl.state == ERROR) &&
+         ctl.act == 0 && hostNowUs() >= fineUntilUs;
+}
+
+static uint64_t periodUs(const SimTask& t, bool coarse)
+{
+  uint32_t ms = (t.stretch && coarse) ? max(t.periodMs, opt.idleMs) : t.periodMs;
+  return ms * US_PER_MS;
+}
+
+static uint64_t alignUp(uint64_t us, uint64_t step)
+{
+  return (us + step - 1) / step * step;
+}
+
+static void runUntil(uint64_t endUs)
+{
+  while(hostNowUs() < endUs) {
+    bool coarse = quiet();
+
+    uint64_t due = min(endUs, opDueUs);
+    for(const SimTask& t : tasks) due = min(due, t.due);
+
+    /* Eingangsflanke in der Ruhephase -> ab hier wieder fein */
+    if(plantAdvance(due, coarse)) {
+      uint64_t now = hostNowUs();
+      fineUntilUs = now + SIM_FINE_HOLD_MS * US_PER_MS;
+      for(SimTask& t : tasks)
+        if(t.stretch) t.due = min(t.due, alignUp(now, t.periodMs * US_PER_MS));
+      continue;
+    }
+
+    uint64_t now = hostNowUs();
+    for(SimTask& t : tasks) {
+      if(t.due > now) continue;
+      t.fn();
+      t.due = max(t.due + periodUs(t, coarse), alignUp(now + 1, t.periodMs * US_PER_MS));
+    }
+
+    outFlush();
+    plantSetValves(~hostExpPins() & 0x0F);   // Kanäle 0..3, invertiert
+    operatorStep();
+
+    if(now / US_PER_DAY != dayIndex) {
+      dayPrint();
+      dayIndex = now / US_PER_DAY;
+      dayReset();
+    }
+  }
+}
+
+/* ============================================================
+   AUSGABE
+   ============================================================ */
+
+class FilePrint : public Print{
+public:
+  explicit FilePrint(FILE* f) : f(f) {}
+  size_t write(uint8_t c) override                  { return fputc(c, f) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* b, size_t n) override { return fwrite(b, 1, n, f); }
+  using Print::write;
+private:
+  FILE* f;
+};
+
+template<class Next>
+static void writeJson(const char* name, Next next)
+{
+  std::string path = std::string(opt.outDir) + "/" + name;
+  FILE* f = fopen(path.c_str(), "wb");
+  if(!f) { fprintf(stderr, "cannot write %s\n", path.c_str()); return; }
+  FilePrint out(f);
+  while(next(out)) {}
+  fclose(f);
+}
+
+static void writeOutputs()
+{
+  mkdir(opt.outDir, 0755);
+
+  HistoryTableQuery q;
+  HistoryTableCursor c;
+  writeJson("table.json", [&](Print& out){ return historyTableJsonNext(q, c, out); });
+
+  for(uint8_t s = 0; s < HIST_SERIES_COUNT; s++) {
+    HistorySelection sel;
+    HistoryJsonCursor sc;
+    historySelect((HistorySeries)s, true, HIST_MAX_POINTS, 0, sel);
+    std::string name = std::string("series_") + historySeriesName((HistorySeries)s) + ".json";
+    writeJson(name.c_str(), [&](Print& out){ return historySeriesJsonNext(sel, sc, out); });
+  }
+
+  uint16_t pos = 0;
+  writeJson("stats.json", [&](Print& out){ return totalsJsonNext(pos, out); });
+}
+
+static void printSummary()
+{
+  uint64_t nowMs = hostNowUs() / US_PER_MS;
+  stateMs[ctl.state] += nowMs - stateSinceMs;
+  stateSinceMs = nowMs;
+
+  printf("\n== states\n");
+  for(uint8_t s = 0; s < STATE_COUNT; s++)
+    printf("%-12s entries %5u  %9.2f h\n", ctlStateName((State)s),
+           (unsigned)stateEntries[s], stateMs[s] / 3600000.0);
+
+  printf("\n== transitions\n");
+  for(uint8_t a = 0; a < STATE_COUNT; a++)
+    for(uint8_t b = 0; b < STATE_COUNT; b++)
+      if(trans[a][b])
+        printf("%-12s -> %-12s %5u\n", ctlStateName((State)a), ctlStateName((State)b), (unsigned)trans[a][b]);
+
+  printf("\n== stop reasons\n");
+  for(const auto& r : stopReasons) printf("%-24s %5u\n", r.first.c_str(), (unsigned)r.second);
+
+  printf("\n== messages (ERROR/INFO)\n");
+  for(const auto& m : messages) printf("%-36s %5u\n", m.first.c_str(), (unsigned)m.second);
+
+  PlantStats p;
+  plantGetStats(p);
+  printf("\n== water\n");
+  printf("runs %u  produced %.2f L (controller)  %.2f L into tank (plant)\n",
+         (unsigned)runs, litersTotal, p.tankInL);
+  printf("fed %.2f L  drain %.2f L  drawn %.2f L  short %.2f L  overflows %u\n",
+         p.fedL, p.drainL, p.drawnL, p.shortL, (unsigned)p.overflows);
+  printf("pulses in %u / counted %u  out %u / counted %u  float edges %u\n",
+         (unsigned)p.pulsesIn, (unsigned)cntIn, (unsigned)p.pulsesOut, (unsigned)cntOut,
+         (unsigned)p.floatEdges);
+  printf("level now %.2f L  min %.2f  max %.2f\n", p.levelL, p.levelMinL, p.levelMaxL);
+
+  printf("\n== firmware\n");
+  printf("control ticks %u  pushover %u  operator resets %u  pcf writes %u\n",
+         (unsigned)controlTicks, (unsigned)pushes, (unsigned)resets, (unsigned)hostExpWrites());
+  printf("history rows %u  fs used %lu bytes\n",
+         (unsigned)historyGetRowCount(), (unsigned long)SPIFFS.usedBytes());
+}
+
+/* ============================================================
+   MAIN
+   ============================================================ */
+
+static void wipeDir(const char* dir)
+{
+  if(DIR* d = opendir(dir)) {
+    while(struct dirent* e = readdir(d))
+      if(e->d_name[0] != '.') unlink((std::string(dir) + "/" + e->d_name).c_str());
+    closedir(d);
+  }
+}
+
+/* pio test -e native baut src/ + sim/ mit, main() kommt dann aus test/ */
+#ifndef PIO_UNIT_TESTING
+
+int main(int argc, char** argv)
+{
+  if(!parseArgs(argc, argv)) {
+    fprintf(stderr, "usage: %s [--days N] [--seed N] [--mode auto|manual] [--draw L]\n"
+                    "          [--idle-ms MS] [--leak-day D] [--reset-min MIN]\n"
+                    "          [--fs DIR] [--out DIR] [--record] [--trace] [--verbose]\n", argv[0]);
+    return 2;
+  }
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  hostSetEpoch(SIM_EPOCH0);
+  hostSeed(opt.seed);
+  hostSetQuiet(!opt.verbose);
+  hostFsRoot(opt.fsDir);
+  if(opt.record) hostFsSize(1UL << 30);   // Aufzeichnung über Tage, ohne Flash-Grenze
+  wipeDir(opt.fsDir);                  // jeder Lauf ab leerem Flash
+
+  PlantConfig pc;
+  pc.drawLitersDay = opt.drawL;
+  if(opt.leakDay >= 0) {
+    pc.leakAtSec  = opt.leakDay * 86400 + 3 * 3600;   // nachts, Anlage ruht
+    pc.leakForSec = 600;
+  }
+  plantInit(pc, { PIN_WCOUNT_IN, PIN_WCOUNT_OUT, PIN_WLOW, PIN_WHIGH }, opt.seed);
+
+  /* ---- setup() ---- */
+  halFsBegin();
+#if SIM_JSON_SETTINGS
+  configLoad();
+  settingsLoad();
+#endif
+  if(opt.record && recBegin(TASK_CONTROL_MS, UINT32_MAX))
+    for(SimTask& t : tasks)
+      if(!strcmp(t.name, "rec")) t.due = 0;
+  totalsInit();
+  historyInit();
+  setSwitch(opt.mode);
+  inputsInit(inputDefs, IN_COUNT);
+  uint8_t inMask = 0;
+  for(uint8_t i = 0; i < IN_COUNT; i++) if(inputActive(i)) inMask |= 1 << i;
+  recInputsInit(inputDefs, IN_COUNT, inMask);
+  inputsSetEdgeHook(recEdge);
+  halPulseAttach(PIN_WCOUNT_IN,  isrIn);
+  halPulseAttach(PIN_WCOUNT_OUT, isrOut);
+  halExpBegin(0x38);
+  outputsInit(0xFF);             // pinInvert: alle Kanäle invertiert
+  tdsCalApply(settings.tdsCal.c_str());
+  recCtlInit(millis());
+  ctlInit(ctl, &settings, millis());
+
+  dayReset();
+
+  auto t0 = std::chrono::steady_clock::now();
+  runUntil(opt.days * US_PER_DAY);
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  recStop();
+  printSummary();
+  if(opt.outDir) writeOutputs();
+
+  fprintf(stderr, "simulated %u days in %.2f s (%.0fx real time)\n",
+          (unsigned)opt.days, wall, opt.days * 86400.0 / max(wall, 1e-6));
+  return 0;
+}
+
+#endif  // PIO_UNIT_TESTING
@@ -11,6 +11,7 @@
 // Process
 #define DEF_TDS_LIMIT                17.0f
 #define DEF_TDS_MAX_ALLOWED          30.0f
+#define DEF_TDS_CAL                  ""      // leer = eingebaute Kennlinie
 
 #define DEF_MAX_RUNTIME_AUTO_SEC     2400.0f
 #define DEF_MAX_RUNTIME_MANUAL_SEC   3000.0f
@@ -40,3 +41,6 @@
 #define DEF_SERVICE_FLUSH_ENABLED     true
 #define DEF_SERVICE_FLUSH_INTERVAL_S  86400  //24h
 #define DEF_SERVICE_FLUSH_TIME_S      120
+
+// Diagnose
+#define DEF_RECORD_INPUTS            false   // Roh-Eingänge aufzeichnen (recorder.h)
@@ -1,5 +1,5 @@
 #include "config_settings.h"
-#include <SPIFFS.h>
+#include "hal.h"
 
 /* ============================================================ */
 
@@ -13,12 +13,12 @@ JsonDocument configDoc;
 
 bool configLoad()
 {
-  if(!SPIFFS.exists("/config.json")){
+  if(!halFs().exists("/config.json")){
     Serial.println("[CFG] no config.json -> defaults");
     return false;
   }
 
-  File f = SPIFFS.open("/config.json","r");
+  File f = halFs().open("/config.json","r");
   if(!f) return false;
 
   auto err = deserializeJson(configDoc, f);
@@ -36,7 +36,7 @@ bool configLoad()
 
 bool configSave()
 {
-  File f = SPIFFS.open("/config.json","w");
+  File f = halFs().open("/config.json","w");
   if(!f) return false;
 
   serializeJsonPretty(configDoc, f);
@@ -0,0 +1,502 @@
+#include "controller.h"
+
+/* ============================================================
+   HELPERS
+   ============================================================ */
+
+#define S(x)  (1 << (x))
+#define S_ANY 0xFF
+
+typedef bool (*CtlGuard)(const Controller&, const CtlInputs&);
+typedef void (*CtlAction)(Controller&, const CtlInputs&, CtlOutputs&);
+
+static_assert(STATE_COUNT <= 8, "Zustandsmaske ist ein Byte");
+
+float ctlProducedLiters(const Controller& c, uint32_t cntOut)
+{
+  int32_t diff = (int32_t)cntOut - (int32_t)c.prodStartCnt;
+  if(diff < 0) diff = 0;
+  return diff / c.cfg->pulsesPerLiterOut;
+}
+
+float ctlFlowInLpm(const Controller& c, float hzIn)
+{
+  if(c.state < PREPARE || c.state > POSTFLUSH) return 0.0f;
+  return hzIn * 60.0f / c.cfg->pulsesPerLiterIn;
+}
+
+float ctlFlowOutLpm(const Controller& c, float hzOut)
+{
+  if(c.state != PRODUCTION) return 0.0f;
+  return hzOut * 60.0f / c.cfg->pulsesPerLiterOut;
+}
+
+static void setReason(Controller& c, const char* r)
+{
+  strncpy(c.lastStopReason, r, sizeof(c.lastStopReason) - 1);
+  c.lastStopReason[sizeof(c.lastStopReason) - 1] = 0;
+}
+
+static void setAct(Controller& c, uint32_t now, uint8_t act)
+{
+  if(act == c.act) return;
+
+  if((c.act & ACT(ACT_WIN)) && !(act & ACT(ACT_WIN)))
+    c.valveClosedMs = now;              // Einlass gerade geschlossen
+
+  c.act = act;
+  c.actChangedMs = now;
+}
+
+static bool elapsed(const Controller& c, const CtlInputs& in, float sec)
+{
+  return in.now - c.stateStart > sec * 1000.0f;
+}
+
+/* ============================================================
+   ZUSTÄNDE (enter / exit / tick)
+   ============================================================ */
+
+static void enterIdle(Controller& c, const CtlInputs&, CtlOutputs& o)
+{
+  c.autoStartNotified = false;
+
+  // Produktion physikalisch abgeschlossen → History schreiben
+  if(c.productionEnded) {
+    c.productionEnded = false;
+    o.fx |= CTL_FX_HISTORY_END;
+  }
+}
+
+static void enterAutoflush(Controller& c, const CtlInputs& in, CtlOutputs&)
+{
+  // erster Produkt-Puls sofort
+  c.flushPulse   = false;
+  c.flushPulseMs = in.now - AUTOFLUSH_PRODUCT_INTERVAL_MS;
+}
+
+static void tickAutoflush(Controller& c, const CtlInputs& in, CtlOutputs&)
+{
+  /* ---------- Produkt-Puls starten / beenden ---------- */
+  if(!c.flushPulse && in.now - c.flushPulseMs >= AUTOFLUSH_PRODUCT_INTERVAL_MS) {
+    c.flushPulse   = true;
+    c.flushPulseMs = in.now;
+  }
+  if(c.flushPulse && in.now - c.flushPulseMs >= AUTOFLUSH_PRODUCT_PULSE_MS)
+    c.flushPulse = false;
+
+  setAct(c, in.now, c.flushPulse ? (c.act | ACT(ACT_OOUT)) : (c.act & ~ACT(ACT_OOUT)));
+}
+
+static void enterProduction(Controller& c, const CtlInputs& in, CtlOutputs& o)
+{
+  c.runtimeTimeoutActive = false;
+  c.ratioStartMs = in.now;
+  c.ratioLowMs   = 0;
+
+  /* ========= START Produktion (nur aus PREPARE/AUTOFLUSH) ========= */
+  c.prodStartCnt      = in.cntOut;
+  c.productionStartMs = in.now;
+  o.fx |= CTL_FX_HISTORY_START;
+}
+
+static void exitProduction(Controller& c, const CtlInputs& in, CtlOutputs&)
+{
+  /* ========= ENDE Produktion ========= */
+  if(!c.productionEnded) {
+    c.lastProducedLiters = ctlProducedLiters(c, in.cntOut);   // 🔒 FINAL einfrieren
+    c.productionEnded = true;
+  }
+}
+
+struct StateDef{
+  const char* name;
+  uint8_t     act;                     // Aktoren in diesem Zustand
+  CtlAction   enter, exit, tick;
+};
+
+/* Reihenfolge = enum State */
+static const StateDef states[STATE_COUNT] = {
+  /* name            Aktoren                                               enter            exit            tick */
+  { "IDLE",         0,                                                    enterIdle,       nullptr,        nullptr       },
+  { "PREPARE",      ACT(ACT_RELAY) | ACT(ACT_WIN),                        nullptr,         nullptr,        nullptr       },
+  { "AUTOFLUSH",    ACT(ACT_RELAY) | ACT(ACT_WIN) | ACT(ACT_OTOS),        enterAutoflush,  nullptr,        tickAutoflush },
+  { "PRODUCTION",   ACT(ACT_RELAY) | ACT(ACT_WIN) | ACT(ACT_OOUT),        enterProduction, exitProduction, nullptr       },
+  { "POSTFLUSH",    ACT(ACT_RELAY) | ACT(ACT_WIN),                        nullptr,         nullptr,        nullptr       },  // Osmose gesperrt
+  { "SERVICEFLUSH", ACT(ACT_RELAY) | ACT(ACT_WIN) | ACT(ACT_OTOS),        nullptr,         nullptr,        nullptr       },  // nur Spülweg
+  { "INFO",         0,                                                    nullptr,         nullptr,        nullptr       },
+  { "ERROR",        0,                                                    nullptr,         nullptr,        nullptr       },
+};
+
+const char* ctlStateName(State s)
+{
+  return s < STATE_COUNT ? states[s].name : "?";
+}
+
+/* ============================================================
+   BEDINGUNGEN
+   ============================================================ */
+
+static bool autoOnly(const CtlInputs& in) { return in.autoMode && !in.manualMode; }
+
+static bool gWebStart(const Controller&, const CtlInputs& in)   { return in.webStart; }
+static bool gWebStop(const Controller&, const CtlInputs& in)    { return in.webStop; }
+static bool gManualRose(const Controller&, const CtlInputs& in) { return in.manualRose; }
+static bool gOff(const Controller&, const CtlInputs& in)        { return !in.autoMode && !in.manualMode; }
+static bool gWerror(const Controller&, const CtlInputs& in)     { return in.werror; }
+static bool gInflow(const Controller& c, const CtlInputs&)      { return c.inflowFault; }
+static bool gRatio(const Controller& c, const CtlInputs&)       { return c.ratioFault; }
+
+static bool gWebStopPost(const Controller& c, const CtlInputs& in)
+{
+  return in.webStop && c.cfg->postFlushEnabled;
+}
+
+/* oben Wasser, unten trocken → unmöglich */
+static bool gLevelMismatch(const Controller&, const CtlInputs& in)
+{
+  return in.autoMode && in.highSwim && !in.lowSwim;
+}
+
+static bool gServiceDue(const Controller& c, const CtlInputs& in)
+{
+  return c.cfg->serviceFlushEnabled &&
+         c.cfg->serviceFlushIntervalSec > 0 &&
+         in.now - c.lastServiceFlushMs > c.cfg->serviceFlushIntervalSec * 1000;
+}
+
+/* AUTO START nur wenn beide Schwimmer NICHT schwimmen */
+static bool gAutoStart(const Controller& c, const CtlInputs& in)
+{
+  return autoOnly(in) && !c.autoBlocked && !in.lowSwim && !in.highSwim;
+}
+
+static bool gPrepareDone(const Controller& c, const CtlInputs& in)
+{
+  return elapsed(c, in, c.cfg->prepareTimeSec);
+}
+
+static bool gPrepareDoneFlush(const Controller& c, const CtlInputs& in)
+{
+  return gPrepareDone(c, in) && c.cfg->autoFlushEnabled;
+}
+
+/* Mindest-Spülzeit um, TDS gut, Entscheidung nur außerhalb des Pulses */
+static bool gFlushDone(const Controller& c, const CtlInputs& in)
+{
+  return in.now - c.stateStart >= (uint32_t)(c.cfg->autoFlushMinTimeSec * 1000.0f) &&
+         !c.flushPulse && in.tds < c.cfg->tdsLimit;
+}
+
+static bool gFlushTimeout(const Controller& c, const CtlInputs& in)
+{
+  return elapsed(c, in, c.cfg->maxFlushTimeSec);
+}
+
+/* AUTO STOP → Tank voll */
+static bool gTankFull(const Controller&, const CtlInputs& in)
+{
+  return autoOnly(in) && in.lowSwim && in.highSwim;
+}
+
+static bool gTankFullPost(const Controller& c, const CtlInputs& in)
+{
+  return gTankFull(c, in) && c.cfg->postFlushEnabled;
+}
+
+static bool gTdsHigh(const Controller& c, const CtlInputs& in)
+{
+  return in.now - c.actChangedMs > TDS_SETTLE_MS && in.tds > c.cfg->tdsMaxAllowed;
+}
+
+static bool volumeLimit(const Controller& c, const CtlInputs& in)
+{
+  float maxProd = in.manualMode ? c.cfg->maxProductionManualLiters
+                                : c.cfg->maxProductionAutoLiters;
+  return maxProd > 0 && ctlProducedLiters(c, in.cntOut) > maxProd;
+}
+
+static bool runtimeLimit(const Controller& c, const CtlInputs& in)
+{
+  float maxRun = in.manualMode ? c.cfg->maxRuntimeManualSec
+                               : c.cfg->maxRuntimeAutoSec;
+  return maxRun > 0 && elapsed(c, in, maxRun);
+}
+
+/* MANUAL → normal fertig, AUTO → ERROR */
+static bool gVolumeManualPost(const Controller& c, const CtlInputs& in) { return in.manualMode && c.cfg->postFlushEnabled && volumeLimit(c, in); }
+static bool gVolumeManual(const Controller& c, const CtlInputs& in)     { return in.manualMode && volumeLimit(c, in); }
+static bool gVolumeAuto(const Controller& c, const CtlInputs& in)       { return volumeLimit(c, in); }
+
+/* MANUAL → INFO (ggf. nach PostFlush), AUTO → ERROR */
+static bool gRuntimeManualPost(const Controller& c, const CtlInputs& in) { return in.manualMode && c.cfg->postFlushEnabled && runtimeLimit(c, in); }
+static bool gRuntimeManual(const Controller& c, const CtlInputs& in)     { return in.manualMode && runtimeLimit(c, in); }
+static bool gRuntimeAuto(const Controller& c, const CtlInputs& in)       { return runtimeLimit(c, in); }
+
+static bool gPostflushDone(const Controller& c, const CtlInputs& in)
+{
+  return elapsed(c, in, c.cfg->postFlushTimeSec);
+}
+
+static bool gPostflushDoneInfo(const Controller& c, const CtlInputs& in)
+{
+  return gPostflushDone(c, in) && c.runtimeTimeoutActive;
+}
+
+static bool gServiceDone(const Controller& c, const CtlInputs& in)
+{
+  return elapsed(c, in, c.cfg->serviceFlushTimeSec);
+}
+
+static bool gServiceDonePost(const Controller& c, const CtlInputs& in)
+{
+  return gServiceDone(c, in) && c.cfg->postFlushEnabled;
+}
+
+/* Info war vor dem Flush aktiv → wiederherstellen */
+static bool gServiceDoneInfo(const Controller& c, const CtlInputs& in)
+{
+  return gServiceDone(c, in) && c.msg[0];
+}
+
+/* ============================================================
+   AKTIONEN (vor dem Wechsel)
+   ============================================================ */
+
+static void aAbortStart(Controller& c, const CtlInputs&, CtlOutputs&)
+{
+  c.lastProducedLiters = 0.0f;
+  c.productionEnded = false;
+  setReason(c, "User stop");
+}
+
+static void aClearBlock(Controller& c, const CtlInputs&, CtlOutputs&)
+{
+  c.autoBlocked = false;
+  c.autoPauseBlink = false;
+  c.msg = "";
+}
+
+static void aManualStart(Controller& c, const CtlInputs&, CtlOutputs&)
+{
+  c.autoBlocked = false;
+}
+
+static void aAutoStart(Controller& c, const CtlInputs&, CtlOutputs& o)
+{
+  if(c.autoStartNotified) return;
+  c.autoStartNotified = true;
+  o.fx  |= CTL_FX_PUSH;
+  o.push = "Osmose Auto-Bezug gestartet";
+}
+
+static void aBlockAuto(Controller& c, const CtlInputs&, CtlOutputs&)
+{
+  c.autoBlocked = true;
+}
+
+static void aRuntimeTimeout(Controller& c, const CtlInputs&, CtlOutputs&)
+{
+  c.runtimeTimeoutActive = true;
+}
+
+static void aRuntimeInfo(Controller& c, const CtlInputs&, CtlOutputs&)
+{
+  c.runtimeTimeoutActive = false;
+}
+
+static void aServiceDone(Controller& c, const CtlInputs& in, CtlOutputs&)
+{
+  c.lastServiceFlushMs = in.now;
+}
+
+/* ============================================================
+   ÜBERGÄNGE
+   text: Ziel ERROR/INFO → Meldung; aus PRODUCTION → Stop-Grund
+   ============================================================ */
+
+struct Transition{
+  uint8_t     from;                    // Maske der Quellzustände
+  CtlGuard    guard;
+  State       to;
+  const char* text;
+  CtlAction   action;
+};
+
+static const Transition transitions[] = {
+  /* ---- Web / Schalter ---- */
+  { S(IDLE) | S(INFO) | S(ERROR) | S(SERVICEFLUSH), gWebStart, PREPARE, nullptr, nullptr },
+  { S(PRODUCTION),              gWebStopPost,       POSTFLUSH,    "User stop",  nullptr         },
+  { S(PRODUCTION),              gWebStop,           IDLE,         "User stop",  nullptr         },
+  { S(PREPARE) | S(AUTOFLUSH),  gWebStop,           IDLE,         nullptr,      aAbortStart     },   // kein PostFlush!
+  { S(ERROR),                   gWebStop,           IDLE,         nullptr,      aClearBlock     },
+  { S(IDLE),                    gManualRose,        PREPARE,      nullptr,      aManualStart    },
+  { S(ERROR),                   gOff,               IDLE,         nullptr,      aClearBlock     },
+
+  /* ---- Sicherheit ---- */
+  { S_ANY & ~S(ERROR),          gWerror,            ERROR,        "Water error",                     nullptr },
+  { S_ANY & ~S(ERROR),          gInflow,            ERROR,        "Inflow while inlet valve closed", nullptr },
+  { S(PRODUCTION),              gRatio,             ERROR,        "Bad flow ratio (<30%)",           nullptr },
+
+  /* ---- OFF (SERVICEFLUSH läuft weiter) ---- */
+  { S(PRODUCTION),              gOff,               IDLE,         "User stop",  nullptr         },
+  { S(PREPARE) | S(AUTOFLUSH) | S(POSTFLUSH) | S(INFO), gOff, IDLE, nullptr,    nullptr         },
+
+  { S_ANY & ~S(ERROR),          gLevelMismatch,     ERROR,        "Level sensor mismatch (upper only)", nullptr },
+  { S(IDLE) | S(INFO),          gServiceDue,        SERVICEFLUSH, nullptr,      nullptr         },
+
+  /* ---- Ablauf ---- */
+  { S(IDLE),                    gAutoStart,         PREPARE,      nullptr,      aAutoStart      },
+  { S(PREPARE),                 gPrepareDoneFlush,  AUTOFLUSH,    nullptr,      nullptr         },
+  { S(PREPARE),                 gPrepareDone,       PRODUCTION,   nullptr,      nullptr         },
+  { S(AUTOFLUSH),               gFlushDone,         PRODUCTION,   nullptr,      nullptr         },
+  { S(AUTOFLUSH),               gFlushTimeout,      ERROR,        "Flush timeout", nullptr      },
+
+  { S(PRODUCTION),              gTankFullPost,      POSTFLUSH,    "Container full", nullptr     },
+  { S(PRODUCTION),              gTankFull,          IDLE,         "Container full", nullptr     },
+  { S(PRODUCTION),              gTdsHigh,           ERROR,        "TDS too high",   nullptr     },
+  { S(PRODUCTION),              gVolumeManualPost,  POSTFLUSH,    "Volume limit",   nullptr     },
+  { S(PRODUCTION),              gVolumeManual,      IDLE,         "Volume limit",   nullptr     },
+  { S(PRODUCTION),              gVolumeAuto,        ERROR,        "Volume limit",   aBlockAuto  },
+  { S(PRODUCTION),              gRuntimeManualPost, POSTFLUSH,    "Max runtime reached", aRuntimeTimeout },
+  { S(PRODUCTION),              gRuntimeManual,     INFO,         "Max runtime reached", nullptr },
+  { S(PRODUCTION),              gRuntimeAuto,       ERROR,        "Max runtime reached", aBlockAuto },
+
+  { S(POSTFLUSH),               gPostflushDoneInfo, INFO,         "Max runtime reached", aRuntimeInfo },
+  { S(POSTFLUSH),               gPostflushDone,     IDLE,         nullptr,      nullptr         },
+
+  { S(SERVICEFLUSH),            gServiceDonePost,   POSTFLUSH,    nullptr,      aServiceDone    },
+  { S(SERVICEFLUSH),            gServiceDoneInfo,   INFO,         nullptr,      aServiceDone    },
+  { S(SERVICEFLUSH),            gServiceDone,       IDLE,         nullptr,      aServiceDone    },
+};
+
+#define TRANSITION_COUNT (sizeof(transitions) / sizeof(transitions[0]))
+
+static void go(Controller& c, const CtlInputs& in, CtlOutputs& o, State to, const char* text)
+{
+  State from = c.state;
+  if(states[from].exit) states[from].exit(c, in, o);
+
+  if(text && from == PRODUCTION) setReason(c, text);
+  if(text && (to == ERROR || to == INFO)) c.msg = text;
+
+  if(to == ERROR) {
+    // laufende Produktion sofort abschließen (nicht erst in IDLE)
+    if(from == PRODUCTION) {
+      c.productionEnded = false;
+      o.fx |= CTL_FX_HISTORY_END;
+    }
+    o.fx  |= CTL_FX_PUSH;
+    o.push = c.msg;
+  }
+
+  /* Nutzung setzt Service-Timer zurück */
+  if(to == PRODUCTION || to == PREPARE)
+    c.lastServiceFlushMs = in.now;
+
+  c.state = to;
+  c.stateStart = in.now;
+
+  if(to != ERROR && to != INFO && to != SERVICEFLUSH)
+    c.msg = "";
+
+  setAct(c, in.now, states[to].act);
+  if(states[to].enter) states[to].enter(c, in, o);
+}
+
+/* ============================================================
+   ÜBERWACHUNG (Zustand für die Bedingungen)
+   ============================================================ */
+
+static void monitor(Controller& c, const CtlInputs& in)
+{
+  /* Einlauf trotz geschlossenem Einlassventil */
+  c.inflowFault = false;
+
+  if(!(c.act & ACT(ACT_WIN))) {
+    // Nachlauf ignorieren
+    if(in.cntIn != c.closedLastCnt && in.now - c.valveClosedMs > FLOW_CLOSED_GRACE_MS) {
+      if(c.closedStartMs == 0) {
+        c.closedStartMs = in.now;
+        c.closedPulses  = 0;
+      }
+      c.closedPulses += in.cntIn - c.closedLastCnt;
+      c.inflowFault = c.closedPulses > FLOW_CLOSED_MAX_PULSES &&
+                      in.now - c.closedStartMs < FLOW_CLOSED_WINDOW_MS;
+    }
+  } else {
+    // Ventil offen → Reset
+    c.closedPulses  = 0;
+    c.closedStartMs = 0;
+  }
+  c.closedLastCnt = in.cntIn;
+
+  /* Flow-Ratio (nur PRODUCTION, nach Anlauf, nur mit Durchfluss) */
+  c.ratioFault = false;
+  if(c.state != PRODUCTION || in.now - c.ratioStartMs <= FLOW_RATIO_STARTUP_MS) return;
+
+  if(in.hzIn > 0.0f && in.hzOut / in.hzIn < FLOW_RATIO_MIN) {
+    if(!c.ratioLowMs) c.ratioLowMs = in.now;
+    else c.ratioFault = in.now - c.ratioLowMs > FLOW_RATIO_HOLD_MS;
+  } else {
+    c.ratioLowMs = 0;
+  }
+}
+
+/* ============================================================
+   API
+   ============================================================ */
+
+void ctlInit(Controller& c, const Settings* cfg, uint32_t now)
+{
+  c = {};
+  c.cfg   = cfg;
+  c.state = IDLE;
+  c.msg   = "";
+  c.stateStart = c.actChangedMs = c.valveClosedMs = now;
+  c.lastServiceFlushMs = now;
+}
+
+CtlOutputs ctlStep(Controller& c, const CtlInputs& in)
+{
+  CtlOutputs o = {};
+  o.from = c.state;
+  uint8_t act0 = c.act;
+
+  /* ---- Flags aus Schaltern / Web (kein Zustandswechsel) ---- */
+  if(in.autoRose || in.webStart) {
+    c.autoBlocked = false;
+    c.autoPauseBlink = false;
+    c.msg = "";
+  }
+
+  // Web-Stop in AUTO → Auto-Neustart blockieren
+  if(in.webStop && !in.manualMode) {
+    c.autoBlocked = true;
+    c.autoPauseBlink = true;
+  }
+
+  if(gOff(c, in) && c.state != SERVICEFLUSH) {
+    c.autoPauseBlink = false;
+    c.runtimeTimeoutActive = false;
+    c.msg = "";
+  }
+
+  monitor(c, in);
+
+  /* ---- Arbeit im Zustand, dann erster passender Übergang ---- */
+  if(states[c.state].tick) states[c.state].tick(c, in, o);
+
+  for(uint8_t i = 0; i < TRANSITION_COUNT; i++) {
+    const Transition& t = transitions[i];
+    if(!(t.from & S(c.state)) || !t.guard(c, in)) continue;
+
+    if(t.action) t.action(c, in, o);
+    go(c, in, o, t.to, t.text);
+    break;
+  }
+
+  o.act = c.act;
+  o.actChanged = c.act != act0;
+  return o;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/* ============================================================
+   CONTROLLER
+   Zustandsautomat der Anlage als Tabelle:
+
+     - je Zustand: Aktor-Bitmaske + enter/exit/tick-Aktionen
+     - Übergänge: geordnete Tabelle {Quellzustände, Bedingung,
+       Ziel, Meldung, Aktion}; pro Tick feuert der erste Treffer
+
+   ctlStep() ist rein: keine I/O, kein millis(). Alles kommt über
+   CtlInputs, alles geht über CtlOutputs (Aktoren, Effekte wie
+   History/Pushover führt main.cpp aus). Aktoren ändern sich nur
+   bei Übergängen (plus Produkt-Puls im AUTOFLUSH).
+   ============================================================ */
+
+enum State : uint8_t {
+  IDLE,PREPARE,AUTOFLUSH,PRODUCTION,POSTFLUSH,SERVICEFLUSH,INFO,ERROR,
+  STATE_COUNT
+};
+
+/* Aktoren = PCF8574-Kanäle 0..3 */
+enum CtlActuator : uint8_t { ACT_WIN, ACT_OOUT, ACT_OTOS, ACT_RELAY };
+#define ACT(a) (1 << (a))
+
+// ---- Flow-Sicherheitsparameter ----
+#define FLOW_CLOSED_GRACE_MS    1500   // Nachlauf nach Ventil-ZU ignorieren
+#define FLOW_CLOSED_MAX_PULSES  10     // erlaubte Impulse danach
+#define FLOW_CLOSED_WINDOW_MS   3000   // Zeitfenster für Bewertung
+#define FLOW_RATIO_STARTUP_MS   8000   // Anlauf bis zur Ratio-Bewertung
+#define FLOW_RATIO_MIN          0.3f   // Pulse OUT/IN
+#define FLOW_RATIO_HOLD_MS      3000   // Ratio so lange zu klein -> Fehler
+
+#define AUTOFLUSH_PRODUCT_INTERVAL_MS 5000  // Pulsperiode bei Autoflush in ms
+#define AUTOFLUSH_PRODUCT_PULSE_MS     100  // Pulsdauer bei Autoflush
+
+#define TDS_SETTLE_MS  500             // nach Aktor-Wechsel kein TDS-Limit
+
+struct CtlInputs{
+  uint32_t now;
+  bool     autoMode, manualMode;       // Wahlschalter (entprellt)
+  bool     autoRose, manualRose;       // Flanken im Schnappschuss
+  bool     lowSwim, highSwim;          // Schwimmer, schwimmt = true
+  bool     werror;
+  bool     webStart, webStop;
+  float    tds;
+  uint32_t cntIn, cntOut;              // Pulszähler
+  float    hzIn, hzOut;                // Pulsfrequenz (flow_meter)
+};
+
+/* Effekte, die der Aufrufer ausführt */
+#define CTL_FX_HISTORY_START  0x01     // historyStartProduction(Modus)
+#define CTL_FX_HISTORY_END    0x02     // historyEndProduction(lastStopReason, lastProducedLiters)
+#define CTL_FX_PUSH           0x04     // sendPushover(push)
+
+struct CtlOutputs{
+  uint8_t     act;                     // Aktor-Bitmaske
+  bool        actChanged;
+  State       from;                    // Zustand vor dem Tick
+  uint8_t     fx;
+  const char* push;
+};
+
+struct Controller{
+  const Settings* cfg;
+
+  State    state;
+  uint32_t stateStart;
+  uint8_t  act;
+  uint32_t actChangedMs;               // letzte Aktor-Änderung
+  uint32_t valveClosedMs;              // Einlass zuletzt geschlossen
+
+  /* Lauf */
+  uint32_t prodStartCnt;
+  uint32_t productionStartMs;
+  float    lastProducedLiters;
+  bool     productionEnded;            // History-Ende steht aus (IDLE schreibt)
+  char     lastStopReason[20];
+  const char* msg;                     // Fehler/Info-Text, "" = keiner
+
+  bool     autoBlocked;                // verhindert Auto-Neustart nach Schutzlimit
+  bool     autoPauseBlink;
+  bool     runtimeTimeoutActive;
+  bool     autoStartNotified;
+  uint32_t lastServiceFlushMs;
+
+  /* Überwachung */
+  uint32_t ratioStartMs, ratioLowMs;
+  bool     ratioFault;
+  uint32_t closedLastCnt, closedPulses, closedStartMs;
+  bool     inflowFault;
+
+  /* AUTOFLUSH Produkt-Puls */
+  uint32_t flushPulseMs;
+  bool     flushPulse;
+};
+
+void ctlInit(Controller& c, const Settings* cfg, uint32_t now);
+
+/* ein Tick: Eingänge -> Übergang (max. einer) -> Ausgänge */
+CtlOutputs ctlStep(Controller& c, const CtlInputs& in);
+
+const char* ctlStateName(State s);
+
+/* Liter seit Produktionsstart (nur in PRODUCTION sinnvoll) */
+float ctlProducedLiters(const Controller& c, uint32_t cntOut);
+
+/* Durchfluss in l/min aus der Pulsfrequenz für Anzeige und History:
+   Zulauf in jeder Laufphase (PREPARE..POSTFLUSH, Spülwasser zählt
+   mit), Produkt nur in PRODUCTION; sonst 0 */
+float ctlFlowInLpm(const Controller& c, float hzIn);
+float ctlFlowOutLpm(const Controller& c, float hzOut);
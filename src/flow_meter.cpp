@@ -0,0 +1,144 @@
+#include "flow_meter.h"
+#include "json_writer.h"
+#include <math.h>
+
+static_assert((FLOW_RING & (FLOW_RING - 1)) == 0, "FLOW_RING muss 2^n sein");
+
+/* ============================================================
+   RING (ISR schreibt, Task liest)
+   ============================================================ */
+
+struct FlowRing{
+  volatile uint32_t ts[FLOW_RING];
+  volatile uint32_t head;        // Anzahl gültiger Pulse, nach ts[] erhöht
+  volatile uint32_t glitches;
+  uint32_t last;                 // nur ISR
+};
+
+static FlowRing  rings[FLOW_CHANNELS];
+static FlowStats stats[FLOW_CHANNELS];
+
+static const char* const chName[FLOW_CHANNELS] = { "in", "out" };
+
+bool IRAM_ATTR flowPulse(FlowChannel ch, uint32_t t)
+{
+  FlowRing& r = rings[ch];
+
+  if(r.head && t - r.last < FLOW_MIN_PERIOD_US) {
+    r.glitches = r.glitches + 1;
+    return false;
+  }
+
+  r.last = t;
+  r.ts[r.head & (FLOW_RING - 1)] = t;
+  r.head = r.head + 1;
+  return true;
+}
+
+/* ============================================================
+   AUSWERTUNG
+   ============================================================ */
+
+static void updateChannel(FlowChannel ch, uint32_t nowUs)
+{
+  FlowRing&  r = rings[ch];
+  FlowStats& s = stats[ch];
+
+  /* Schnappschuss, nur Pulse bis nowUs: was während der Auswertung
+     eintrifft, zählt erst beim nächsten Mal (sonst since < 0 und das
+     Ergebnis hinge vom Zeitpunkt der ISR ab, vgl. recorder.h) */
+  uint32_t head = r.head;
+  while(head) {
+    uint32_t ahead = r.ts[(head - 1) & (FLOW_RING - 1)] - nowUs;
+    if(ahead == 0 || ahead > FLOW_TIMEOUT_US) break;       // nicht neuer (micros-Überlauf)
+    head--;
+  }
+  s = {};
+  s.pulses   = head;
+  s.glitches = r.glitches;
+
+  /* Slot head wird von der ISR als nächster beschrieben -> auslassen */
+  uint32_t avail = min(head, (uint32_t)FLOW_RING - 1);
+  if(avail < 2) return;
+
+  uint32_t tLast = r.ts[(head - 1) & (FLOW_RING - 1)];
+  uint32_t since = nowUs - tLast;
+  if(since > FLOW_TIMEOUT_US) return;
+
+  /* Perioden rückwärts sammeln, mind. eine */
+  uint32_t period[FLOW_RING];
+  uint16_t k = 0;
+  uint32_t tPrev = tLast;
+
+  for(uint32_t i = 1; i < avail; i++) {
+    uint32_t t = r.ts[(head - 1 - i) & (FLOW_RING - 1)];
+    if(k && tLast - t > FLOW_WINDOW_US) break;
+    period[k++] = tPrev - t;
+    tPrev = t;
+  }
+
+  uint32_t span = tLast - tPrev;
+  float mean = (float)span / k;
+
+  float var = 0.0f;
+  s.minPeriodUs = UINT32_MAX;
+  for(uint16_t i = 0; i < k; i++) {
+    float d = period[i] - mean;
+    var += d * d;
+    s.minPeriodUs = min(s.minPeriodUs, period[i]);
+    s.maxPeriodUs = max(s.maxPeriodUs, period[i]);
+  }
+
+  s.periods  = k;
+  s.periodUs = (uint32_t)(mean + 0.5f);
+  s.jitterUs = (uint32_t)(sqrtf(var / k) + 0.5f);
+
+  /* seit dem letzten Puls schon länger still -> obere Schranke 1/since */
+  s.hz = since > mean ? 1e6f / since : 1e6f / mean;
+}
+
+void flowUpdate(uint32_t now)
+{
+  for(uint8_t c = 0; c < FLOW_CHANNELS; c++)
+    updateChannel((FlowChannel)c, now);
+}
+
+float flowHz(FlowChannel ch)
+{
+  return stats[ch].hz;
+}
+
+void flowGetStats(FlowChannel ch, FlowStats& out)
+{
+  out = stats[ch];
+}
+
+/* ============================================================
+   JSON
+   ============================================================ */
+
+bool flowJsonNext(uint16_t& pos, Print& out)
+{
+  if(pos >= FLOW_CHANNELS) {
+    out.write('}');
+    return false;
+  }
+
+  if(pos == 0) out.write('{');
+
+  const FlowStats& s = stats[pos];
+  jsonWriteKey(out, chName[pos], pos == 0);
+  out.write('{');
+  jsonWriteKey(out, "pulses", true); jsonWriteUInt(out, s.pulses);
+  jsonWriteKey(out, "glitches");     jsonWriteUInt(out, s.glitches);
+  jsonWriteKey(out, "hz");           jsonWriteFloat(out, s.hz, 5);
+  jsonWriteKey(out, "periods");      jsonWriteUInt(out, s.periods);
+  jsonWriteKey(out, "periodUs");     jsonWriteUInt(out, s.periodUs);
+  jsonWriteKey(out, "jitterUs");     jsonWriteUInt(out, s.jitterUs);
+  jsonWriteKey(out, "minPeriodUs");  jsonWriteUInt(out, s.minPeriodUs);
+  jsonWriteKey(out, "maxPeriodUs");  jsonWriteUInt(out, s.maxPeriodUs);
+  out.write('}');
+
+  pos++;
+  return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   FLOW METER
+   Die ISRs legen Zeitstempel (micros) in einen Ring je Kanal
+   (ein Schreiber = ISR, ein Leser = Flow-Task -> ohne Sperre).
+   Durchfluss = reziproke Messung über die Pulsperioden im
+   Fenster FLOW_WINDOW_US (mind. eine Periode), dadurch auch bei
+   kleinem Durchfluss sofort mit voller Auflösung.
+
+   - Glitch-Filter: Pulse mit Abstand < FLOW_MIN_PERIOD_US werden
+     verworfen und gezählt (nicht in Literzähler).
+   - seit dem letzten Puls länger als eine Periode still ->
+     Frequenz fällt mit 1/t ab, nach FLOW_TIMEOUT_US = 0.
+   - Jitter = Standardabweichung der Perioden im Fenster.
+   ============================================================ */
+
+#define FLOW_RING           64          // Zeitstempel je Kanal (2^n)
+#define FLOW_MIN_PERIOD_US  2000        // kürzer = Störimpuls (500 Hz)
+#define FLOW_WINDOW_US      1000000     // Mittelungsfenster
+#define FLOW_TIMEOUT_US     3000000     // kein Puls seitdem -> 0 Hz
+
+enum FlowChannel : uint8_t { FLOW_IN, FLOW_OUT, FLOW_CHANNELS };
+
+/* aus der ISR: Zeitstempel (micros) ablegen; false = als Glitch verworfen.
+   Die Zeit kommt vom Aufrufer, damit recorder.cpp denselben Wert sieht */
+bool flowPulse(FlowChannel ch, uint32_t us);
+
+/* Frequenz + Statistik aus dem Ring neu berechnen (Flow-Task, nowUs = micros) */
+void flowUpdate(uint32_t nowUs);
+
+/* Pulsfrequenz in Hz (Stand des letzten flowUpdate) */
+float flowHz(FlowChannel ch);
+
+struct FlowStats{
+  uint32_t pulses;           // gültige Pulse seit Start
+  uint32_t glitches;         // verworfene Pulse
+  float    hz;
+  uint16_t periods;          // Perioden im Fenster
+  uint32_t periodUs;         // mittlere Periode
+  uint32_t jitterUs;         // Standardabweichung
+  uint32_t minPeriodUs;
+  uint32_t maxPeriodUs;
+};
+
+void flowGetStats(FlowChannel ch, FlowStats& out);
+
+/* GET /api/flow gestreamt: ein Kanal pro Aufruf, false = fertig */
+bool flowJsonNext(uint16_t& pos, Print& out);
@@ -0,0 +1,42 @@
+#pragma once
+
+/* ============================================================
+   FLASH-BUDGET (SPIFFS)
+   Partition "spiffs" 0x170000 = 1472 KB (partitions.csv). SPIFFS
+   braucht freie Blöcke für die Garbage Collection, belegen lassen
+   sich ~75 % -> alle Dateien zusammen bleiben unter FS_BUDGET_BYTES.
+
+     Web-Oberfläche (data/, uploadfs)           ~300 KB   FS_WEB_BYTES
+     /config.json, Totals /tot                   ~14 KB   FS_MISC_BYTES
+     Tabelle /history.bin (+.tmp) + /htab        ~40 KB   FS_TABLE_BYTES
+     Stufen-Logs /h600 /h3600 /h21600         3 x 16 KB   FS_TIER_LOG_BYTES
+     Recorder /rec.bin + /rec_prev.bin        2 x 128 KB  FS_REC_BYTES
+     Lauf-Traces /tr<run>.bin                   192 KB    FS_TRACE_BYTES
+
+   Die Module dimensionieren ihre Dateien aus diesen Werten, nicht
+   aus RAM-Größen. Wer zur Laufzeit wächst (Recorder, Traces),
+   prüft vor dem Start halFsFree() gegen FS_FREE_MIN_BYTES.
+   ============================================================ */
+
+#define FS_PARTITION_BYTES 0x170000UL
+#define FS_BUDGET_BYTES    (1100UL * 1024)
+#define FS_FREE_MIN_BYTES  (FS_PARTITION_BYTES - FS_BUDGET_BYTES)
+
+#define FS_WEB_BYTES       (320UL * 1024)
+#define FS_MISC_BYTES      (16UL * 1024)
+#define FS_TABLE_BYTES     (40UL * 1024)
+
+/* je Stufe (600 s, 3600 s, 21600 s) */
+#define FS_TIER_LOG_BYTES  (16UL * 1024)
+#define FS_TIER_LOGS       3
+
+/* aktuelle + vorige Aufzeichnung */
+#define FS_REC_BYTES       (256UL * 1024)
+
+/* alle Traces inkl. offenem Lauf, >= 4 volle 3-h-Läufe */
+#define FS_TRACE_BYTES     (192UL * 1024)
+
+static_assert(FS_WEB_BYTES + FS_MISC_BYTES + FS_TABLE_BYTES
+              + FS_TIER_LOGS * FS_TIER_LOG_BYTES + FS_REC_BYTES
+              + FS_TRACE_BYTES <= FS_BUDGET_BYTES,
+              "SPIFFS budget exceeded");
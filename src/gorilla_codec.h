@@ -0,0 +1,246 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   GORILLA BLOCK CODEC
+   Bitstrom für Buckets aus Zeitstempel + N floats (nach
+   "Gorilla", Pelkonen et al. 2015):
+
+   - erster Bucket eines Blocks: ts und alle Werte roh (32 Bit)
+   - Zeitstempel: delta-of-delta
+       '0'                 dod == 0
+       '10'   + 7 Bit      dod in [-63, 64]
+       '110'  + 9 Bit      dod in [-255, 256]
+       '1110' + 12 Bit     dod in [-2047, 2048]
+       '1111' + 32 Bit     sonst
+   - Werte: XOR mit dem Vorgänger
+       '0'                 gleich
+       '10' + Bits         signifikante Bits im vorherigen Fenster
+       '11' + 5 Bit führende Nullen + 5 Bit (Länge-1) + Bits
+
+   Werte werden vorher auf GORILLA_MANTISSA Bit Mantisse gerundet
+   (relativer Fehler < 2^-13), damit die hinteren Bits Null sind;
+   ausgenommen sind die Felder in Exact (Bit k = Feld k, z.B.
+   Zählerstände), die bitgenau gespeichert werden.
+   Der Writer überschreitet seine Kapazität nie; ein Bucket, der
+   nicht mehr passt, wird komplett zurückgerollt.
+   ============================================================ */
+
+#define GORILLA_MANTISSA 12
+
+class BitWriter
+{
+public:
+  void begin(uint8_t* b, uint16_t capBytes) { buf = b; cap = capBytes * 8; pos = 0; overflow = false; }
+
+  void put(uint32_t v, uint8_t bits)
+  {
+    if(pos + bits > cap) { overflow = true; return; }
+
+    for(int8_t i = bits - 1; i >= 0; i--) {
+      uint8_t& byte = buf[pos >> 3];
+      uint8_t  mask = 0x80 >> (pos & 7);
+      if((v >> i) & 1) byte |= mask;
+      else             byte &= ~mask;
+      pos++;
+    }
+  }
+
+  uint8_t* buf = nullptr;
+  uint32_t cap = 0;
+  uint32_t pos = 0;
+  bool     overflow = false;
+};
+
+class BitReader
+{
+public:
+  void begin(const uint8_t* b, uint32_t endBits, uint32_t start = 0) { buf = b; end = endBits; pos = start; }
+
+  uint32_t get(uint8_t bits)
+  {
+    uint32_t v = 0;
+    for(uint8_t i = 0; i < bits; i++) {
+      v <<= 1;
+      if(pos < end) v |= (buf[pos >> 3] >> (7 - (pos & 7))) & 1;
+      pos++;
+    }
+    return v;
+  }
+
+  const uint8_t* buf = nullptr;
+  uint32_t end = 0;
+  uint32_t pos = 0;
+};
+
+/* Zustand eines Blocks: beim Schreiben und Lesen identisch */
+template<uint8_t N>
+struct GorillaState{
+  uint16_t n;              // Buckets im Block
+  uint32_t ts;
+  int32_t  delta;
+  uint32_t prev[N];
+  uint8_t  lead[N];        // Fenster des letzten XOR (lead 0xFF = keins)
+  uint8_t  trail[N];
+};
+
+static inline uint32_t gorillaQuantize(float f)
+{
+  uint32_t b;
+  memcpy(&b, &f, 4);
+  if(((b >> 23) & 0xFF) == 0xFF) return b;       // NaN / Inf unverändert
+
+  const uint32_t drop = 23 - GORILLA_MANTISSA;
+  b += 1u << (drop - 1);
+  return b & ~((1u << drop) - 1);
+}
+
+static inline uint8_t gorillaClz(uint32_t v)
+{
+  return v ? __builtin_clz(v) : 32;
+}
+
+static inline uint8_t gorillaCtz(uint32_t v)
+{
+  return v ? __builtin_ctz(v) : 32;
+}
+
+template<uint8_t N, uint32_t Exact = 0>
+class GorillaCodec
+{
+public:
+  typedef GorillaState<N> State;
+
+  static uint32_t quantize(uint8_t k, float f)
+  {
+    if((Exact >> k) & 1) {
+      uint32_t b;
+      memcpy(&b, &f, 4);
+      return b;
+    }
+    return gorillaQuantize(f);
+  }
+
+  /* hängt einen Bucket an; false = passt nicht mehr (Zustand unverändert) */
+  static bool append(BitWriter& w, State& s, uint32_t ts, const float* v)
+  {
+    State    saved  = s;
+    uint32_t savedP = w.pos;
+
+    if(s.n == 0) {
+      w.put(ts, 32);
+      for(uint8_t k = 0; k < N; k++) {
+        s.prev[k] = quantize(k, v[k]);
+        s.lead[k] = 0xFF;
+        w.put(s.prev[k], 32);
+      }
+      s.delta = 0;
+    } else {
+      int32_t delta = (int32_t)(ts - s.ts);
+      putDod(w, delta - s.delta);
+      s.delta = delta;
+
+      for(uint8_t k = 0; k < N; k++)
+        putXor(w, s, k, quantize(k, v[k]));
+    }
+
+    if(w.overflow) {
+      s = saved;
+      w.pos = savedP;
+      w.overflow = false;
+      return false;
+    }
+
+    s.ts = ts;
+    s.n++;
+    return true;
+  }
+
+  /* liest den nächsten Bucket (s.n = bereits gelesene Buckets) */
+  static void next(BitReader& r, State& s, uint32_t& ts, float* v)
+  {
+    if(s.n == 0) {
+      s.ts = r.get(32);
+      s.delta = 0;
+      for(uint8_t k = 0; k < N; k++) {
+        s.prev[k] = r.get(32);
+        s.lead[k] = 0xFF;
+      }
+    } else {
+      s.delta += getDod(r);
+      s.ts += s.delta;
+      for(uint8_t k = 0; k < N; k++) getXor(r, s, k);
+    }
+
+    s.n++;
+    ts = s.ts;
+    for(uint8_t k = 0; k < N; k++) memcpy(&v[k], &s.prev[k], 4);
+  }
+
+private:
+  static void putDod(BitWriter& w, int32_t d)
+  {
+    if(d == 0)                        w.put(0, 1);
+    else if(d >= -63 && d <= 64)     { w.put(0b10, 2);   w.put((uint32_t)(d + 63) , 7); }
+    else if(d >= -255 && d <= 256)   { w.put(0b110, 3);  w.put((uint32_t)(d + 255), 9); }
+    else if(d >= -2047 && d <= 2048) { w.put(0b1110, 4); w.put((uint32_t)(d + 2047), 12); }
+    else                             { w.put(0b1111, 4); w.put((uint32_t)d, 32); }
+  }
+
+  static int32_t getDod(BitReader& r)
+  {
+    if(!r.get(1)) return 0;
+    if(!r.get(1)) return (int32_t)r.get(7)  - 63;
+    if(!r.get(1)) return (int32_t)r.get(9)  - 255;
+    if(!r.get(1)) return (int32_t)r.get(12) - 2047;
+    return (int32_t)r.get(32);
+  }
+
+  static void putXor(BitWriter& w, State& s, uint8_t k, uint32_t cur)
+  {
+    uint32_t x = cur ^ s.prev[k];
+    s.prev[k] = cur;
+
+    if(x == 0) {
+      w.put(0, 1);
+      return;
+    }
+
+    uint8_t lead  = min<uint8_t>(gorillaClz(x), 31);
+    uint8_t trail = gorillaCtz(x);
+
+    if(s.lead[k] != 0xFF && lead >= s.lead[k] && trail >= s.trail[k]) {
+      w.put(0b10, 2);
+      w.put(x >> s.trail[k], 32 - s.lead[k] - s.trail[k]);
+      return;
+    }
+
+    uint8_t len = 32 - lead - trail;
+    w.put(0b11, 2);
+    w.put(lead, 5);
+    w.put(len - 1, 5);
+    w.put(x >> trail, len);
+
+    s.lead[k]  = lead;
+    s.trail[k] = trail;
+  }
+
+  static void getXor(BitReader& r, State& s, uint8_t k)
+  {
+    if(!r.get(1)) return;
+
+    if(!r.get(1)) {
+      uint8_t len = 32 - s.lead[k] - s.trail[k];
+      s.prev[k] ^= r.get(len) << s.trail[k];
+      return;
+    }
+
+    uint8_t lead = r.get(5);
+    uint8_t len  = r.get(5) + 1;
+    uint8_t trail = 32 - lead - len;
+    s.prev[k] ^= r.get(len) << trail;
+
+    s.lead[k]  = lead;
+    s.trail[k] = trail;
+  }
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+/* ============================================================
+   HAL
+   Dünne Hardware-Schicht unter den Firmware-Modulen: Uhr, GPIO,
+   ADC, Pulszähler-Interrupts, Ausgangs-Expander, Dateispeicher.
+   Die Module (History, Settings, Controller, Inputs, Outputs, ...)
+   rufen nur noch hal*; was dahinter steckt, wählt der Build:
+
+     hal_esp32.cpp        ESP32-C3, Arduino-Core (env:usb, env:ota)
+     posix/hal_posix.cpp  Linux (env:native, sim/): virtuelle Uhr,
+                          Pins aus dem Anlagenmodell, FS auf einem
+                          Verzeichnis, Steuerung über posix/host.h
+
+   Nicht in der HAL: WiFi/Web (main.cpp, web.cpp) und die DMA-
+   Abtastung in tds_adc.cpp bleiben ESP-only.
+   Aus ISRs aufrufbar: halMillis, halMicros, halPinRead.
+   ============================================================ */
+
+/* ---------- Uhr ---------- */
+uint32_t halMillis();
+uint32_t halMicros();
+uint32_t halEpoch();                   // Unix-Zeit (0..klein = noch kein NTP)
+#define TIME_VALID_MIN 1600000000UL   // halEpoch() darunter: NTP noch nicht synchron
+uint32_t halRandom();
+
+/* Zyklenzähler für den Profiler */
+uint32_t halCycles();
+uint32_t halCpuMHz();
+
+/* ---------- GPIO ---------- */
+void halPinInput(uint8_t pin);         // Eingang mit Pull-up
+bool halPinRead(uint8_t pin);          // true = HIGH
+
+/* Pegelwechsel-Interrupt (CHANGE) mit Argument */
+void halPinIrq(uint8_t pin, void (*fn)(void*), void* arg);
+
+/* ---------- Pulszähler ---------- */
+/* steigende Flanke -> fn (Flowmeter); Zählen/Stempeln macht fn */
+void halPulseAttach(uint8_t pin, void (*fn)());
+
+/* ---------- ADC ---------- */
+void     halAdcInit();                 // 12 Bit
+uint16_t halAdcRead(uint8_t pin);      // Rohwert 0..4095
+
+/* ---------- Ausgangs-Expander (PCF8574, 8 Kanäle) ---------- */
+bool    halExpBegin(uint8_t addr);
+bool    halExpWrite(uint8_t pins);     // false = I2C-Fehler
+uint8_t halExpRead();
+
+/* ---------- Dateispeicher ---------- */
+bool    halFsBegin();                  // formatiert bei Fehler
+fs::FS& halFs();
+uint32_t halFsFree();                  // totalBytes - usedBytes
@@ -0,0 +1,66 @@
+#include "hal.h"
+#include <Adafruit_PCF8574.h>
+#include <SPIFFS.h>
+#include <time.h>
+
+/* ============================================================
+   HAL ESP32
+   Backend für den ESP32-C3 (Arduino-Core). Nur in env:usb/ota
+   gebaut; env:native nimmt posix/hal_posix.cpp.
+   ============================================================ */
+
+/* ============================================================
+   UHR
+   ============================================================ */
+
+uint32_t IRAM_ATTR halMillis() { return millis(); }
+uint32_t IRAM_ATTR halMicros() { return micros(); }
+
+uint32_t halEpoch()  { return (uint32_t)time(nullptr); }
+uint32_t halRandom() { return esp_random(); }
+
+uint32_t halCycles() { return ESP.getCycleCount(); }
+uint32_t halCpuMHz() { return ESP.getCpuFreqMHz(); }
+
+/* ============================================================
+   GPIO / PULSE / ADC
+   ============================================================ */
+
+void halPinInput(uint8_t pin)           { pinMode(pin, INPUT_PULLUP); }
+bool IRAM_ATTR halPinRead(uint8_t pin)  { return digitalRead(pin) == HIGH; }
+
+void halPinIrq(uint8_t pin, void (*fn)(void*), void* arg)
+{
+  attachInterruptArg(digitalPinToInterrupt(pin), fn, arg, CHANGE);
+}
+
+void halPulseAttach(uint8_t pin, void (*fn)())
+{
+  attachInterrupt(digitalPinToInterrupt(pin), fn, RISING);
+}
+
+void     halAdcInit()              { analogReadResolution(12); }
+uint16_t halAdcRead(uint8_t pin)   { return analogRead(pin); }
+
+/* ============================================================
+   EXPANDER (Wire ist in setup() gestartet)
+   ============================================================ */
+
+static Adafruit_PCF8574 pcf;
+
+bool    halExpBegin(uint8_t addr) { return pcf.begin(addr); }
+bool    halExpWrite(uint8_t pins) { return pcf.digitalWriteByte(pins); }
+uint8_t halExpRead()              { return pcf.digitalReadByte(); }
+
+/* ============================================================
+   FS
+   ============================================================ */
+
+bool    halFsBegin() { return SPIFFS.begin(true); }
+fs::FS& halFs()      { return SPIFFS; }
+
+uint32_t halFsFree()
+{
+  size_t used = SPIFFS.usedBytes();
+  return used < SPIFFS.totalBytes() ? SPIFFS.totalBytes() - used : 0;
+}
@@ -1,74 +1,110 @@
 #include "history.h"
-#include <SPIFFS.h>
-#include <ArduinoJson.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include "fs_budget.h"
+#include "hal.h"
+#include "json_writer.h"
+#include "history_series.h"
+#include "logstore.h"
+#include "profiler.h"
+#include "totals.h"
+
+static const char* const chName[CH_COUNT]  = { HIST_CHANNELS(CH_NAME) };
+
+/* Spalten mit stats: Mittel je Kanal + Min/Max/Letzter je AGG_STATS-Kanal */
+static constexpr uint8_t maxColumns()
+{
+  uint8_t n = CH_COUNT;
+  for(uint8_t ch = 0; ch < CH_COUNT; ch++)
+    if(HistChannels::agg[ch] == AGG_STATS) n += 3;
+  return n;
+}
 
-/* ============================================================
-   SERIES CONFIG
-   ============================================================ */
+static_assert(HIST_MAX_COLS >= maxColumns(), "HIST_MAX_COLS too small");
+/* Mindestlänge kostet das Archiv (~8 KB), Pools ~5 KB, 2 s roh ~3 KB */
+static_assert(sizeof(HistSeries) <= 18 * 1024, "history RAM over budget");
 
-#define HIST_2S_COUNT    150     // ~5 Minuten
-#define HIST_30S_COUNT   150     // ~75 Minuten
-#define HIST_600S_COUNT  150     // ~25 Stunden
-#define HIST_3600S_COUNT 168     // 7 Tage
-#define HIST_21600S_COUNT 120    // ~30 Tage
+static HistSeries series;
 
-/* ============================================================
-   SERIES BUFFERS (RAM, FIXED SIZE, ZERO-FILLED)
-   ============================================================ */
+/* Web-Handler (async_tcp-Task) lesen, loop() schreibt -> alle
+   Zugriffe auf series unter dieser Sperre, je Anfrage einmal
+   (historySelect* füllt eine Momentaufnahme); rekursiv, weil
+   Bucket-Callbacks innerhalb von add() lesen. */
+static std::recursive_mutex seriesLock;
 
-static float tds2s[HIST_2S_COUNT];
-static float flow2s[HIST_2S_COUNT];
-static float prod2s[HIST_2S_COUNT];
+#define SERIES_GUARD() std::lock_guard<std::recursive_mutex> seriesGuard(seriesLock)
 
-static float tds30s[HIST_30S_COUNT];
-static float flow30s[HIST_30S_COUNT];
-static float prod30s[HIST_30S_COUNT];
+static const char* const seriesNames[HistSeries::TIERS] = {
+  "2s", "30s", "600s", "3600s", "21600s"
+};
 
-static float tds600s[HIST_600S_COUNT];
-static float flow600s[HIST_600S_COUNT];
-static float prod600s[HIST_600S_COUNT];
+static uint32_t bootId   = 0;     // neu je Start -> Clients erkennen Seq-Neubeginn
 
-static float tds3600s[HIST_3600S_COUNT];
-static float flow3600s[HIST_3600S_COUNT];
-static float prod3600s[HIST_3600S_COUNT];
+/* ============================================================
+   TABLE
+   Ring aus MAX_ROWS Zeilen, rowHead = neueste Zeile.
+   Persistenz: Snapshot /history.bin + Journal (LogStore /htab).
+   Start/Ende eines Laufs hängen nur einen kleinen Record an das
+   Journal; historyLoop() schreibt gelegentlich einen neuen
+   Snapshot und leert das Journal (Kompaktierung).
+   ============================================================ */
+
+#define MAX_ROWS 100
+static const char* FILE_NAME = "/history.bin";
+static const char* TMP_NAME  = "/history.tmp";
 
-static float tds21600s[HIST_21600S_COUNT];
-static float flow21600s[HIST_21600S_COUNT];
-static float prod21600s[HIST_21600S_COUNT];
+typedef HistoryRunStats RunStats;
+typedef HistoryRow      Row;
 
-static uint16_t idx2s   = 0;
-static uint16_t idx30s  = 0;
-static uint16_t idx600s = 0;
-static uint16_t idx3600s = 0;
-static uint16_t idx21600s = 0;
+static Row      rows[MAX_ROWS];
+static uint8_t  rowHead    = MAX_ROWS - 1;
+static uint8_t  rowCount   = 0;
+static int      currentRow = -1;
+static uint32_t nextRun    = 1;
 
-static uint32_t last2sMs = 0;
+/* loop() schreibt die Zeilen, Web-Handler lesen sie -> Änderungen
+   und Lesen aus den Handlern unter dieser Sperre (loop() selbst
+   liest ohne) */
+static std::mutex tableLock;
 
-/* aggregation helpers */
-static float accTds30   = 0;
-static float accFlow30  = 0;
-static uint8_t accCnt30 = 0;
+#define TABLE_GUARD() std::lock_guard<std::mutex> tableGuard(tableLock)
 
-static float accTds600    = 0;
-static float accFlow600   = 0;
-static uint16_t accCnt600 = 0;
+/* i = 0 -> neueste Zeile */
+static Row& rowAt(uint8_t i)
+{
+  return rows[(rowHead + MAX_ROWS - i) % MAX_ROWS];
+}
 
-static float accTds3600=0;
-static float accFlow3600=0;
-static uint16_t accCnt3600=0;
+/* ============================================================
+   UPDATE CALLBACK
+   ============================================================ */
 
-static float accTds21600=0;
-static float accFlow21600=0;
-static uint16_t accCnt21600=0;
+static HistoryUpdateCallback updateCb = nullptr;
+
+void historySetUpdateCallback(HistoryUpdateCallback cb)
+{
+  updateCb = cb;
+}
 
 /* ============================================================
-   TABLE (persistent, UNCHANGED)
+   TABLE SNAPSHOT
+   Header { u32 magic, u16 version, u16 count, u32 nextRun },
+   danach count Rows, älteste zuerst.
+   Altformat (v0): u8 rowCount + Row[100] mit time_t, neueste zuerst.
    ============================================================ */
 
-#define MAX_ROWS 100
-static const char* FILE_NAME = "/history.bin";
+#define TABLE_MAGIC   0x3148534FUL   // "OSH1"
+#define TABLE_VERSION 1
 
-struct Row{
+struct TableHeader{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t nextRun;
+};
+
+struct RowV0{
   time_t startTs;
   time_t endTs;
   float  liters;
@@ -76,54 +112,595 @@ struct Row{
   char   mode[10];
 };
 
-static Row rows[MAX_ROWS];
-static uint8_t rowCount = 0;
-static int currentRow = -1;
+/* Zeilen aus dem Altformat haben keine Laufstatistik */
+static void noStats(RunStats& st)
+{
+  st = {};
+  st.tdsMin = st.tdsMean = st.tdsMax = st.tdsSd = NAN;
+  st.flowPeak = st.flowAvg = NAN;
+}
+
+static void insertRow(const Row& r)
+{
+  TABLE_GUARD();
+  rowHead = (rowHead + 1) % MAX_ROWS;
+  rows[rowHead] = r;
+  if(rowCount < MAX_ROWS) rowCount++;
+  if(r.run >= nextRun) nextRun = r.run + 1;
+}
+
+static void clearRows()
+{
+  TABLE_GUARD();
+  memset(rows, 0, sizeof(rows));
+  rowHead    = MAX_ROWS - 1;
+  rowCount   = 0;
+  currentRow = -1;
+}
+
+static bool saveSnapshot()
+{
+  File f = halFs().open(TMP_NAME, "w");
+  if(!f) return false;
+
+  TableHeader h = { TABLE_MAGIC, TABLE_VERSION, rowCount, nextRun };
+  bool ok = f.write((uint8_t*)&h, sizeof(h)) == sizeof(h);
+
+  for(int i = rowCount - 1; i >= 0 && ok; i--)
+    ok = f.write((uint8_t*)&rowAt(i), sizeof(Row)) == sizeof(Row);
+
+  f.close();
+
+  if(!ok) {
+    halFs().remove(TMP_NAME);
+    return false;
+  }
+
+  halFs().remove(FILE_NAME);
+  return halFs().rename(TMP_NAME, FILE_NAME);
+}
+
+static void loadLegacyTable(File& f)
+{
+  uint8_t n = 0;
+  if(f.read(&n, 1) != 1) return;
+  n = min<uint8_t>(n, MAX_ROWS);
+
+  /* neueste zuerst gespeichert -> rückwärts einfügen */
+  for(int i = n - 1; i >= 0; i--) {
+    RowV0 o;
+    f.seek(1 + i * sizeof(RowV0));
+    if(f.read((uint8_t*)&o, sizeof(o)) != sizeof(o)) continue;
+
+    Row r = {};
+    noStats(r.st);
+    r.run     = nextRun;
+    r.startTs = (uint32_t)o.startTs;
+    r.endTs   = (uint32_t)o.endTs;
+    r.liters  = o.liters;
+    memcpy(r.reason, o.reason, sizeof(r.reason));
+    memcpy(r.mode, o.mode, sizeof(r.mode));
+    r.reason[sizeof(r.reason) - 1] = 0;
+    r.mode[sizeof(r.mode) - 1] = 0;
+    insertRow(r);
+  }
+}
+
+static bool loadSnapshot()
+{
+  /* Abbruch zwischen remove und rename -> tmp ist der gültige Stand */
+  if(!halFs().exists(FILE_NAME) && halFs().exists(TMP_NAME))
+    halFs().rename(TMP_NAME, FILE_NAME);
+
+  if(!halFs().exists(FILE_NAME)) return false;
+
+  File f = halFs().open(FILE_NAME, "r");
+  if(!f) return false;
+
+  TableHeader h;
+  bool ours = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == TABLE_MAGIC;
+
+  if(ours && h.version == TABLE_VERSION) {
+    for(uint16_t i = 0; i < min<uint16_t>(h.count, MAX_ROWS); i++) {
+      Row r;
+      if(f.read((uint8_t*)&r, sizeof(r)) != sizeof(r)) break;
+      insertRow(r);
+    }
+    nextRun = max(nextRun, h.nextRun);
+  } else if(!ours) {
+    f.seek(0);
+    loadLegacyTable(f);
+  }
+
+  f.close();
+  return !ours;            // Altformat -> neu schreiben
+}
 
 /* ============================================================
-   UPDATE CALLBACK
+   TABLE JOURNAL
+   Records sind idempotent (Lauf-Nummer), ein Replay über einen
+   bereits kompaktierten Snapshot schadet also nicht.
    ============================================================ */
 
-static HistoryUpdateCallback updateCb = nullptr;
+#define TABLE_LOG_FORMAT   1
+#define TABLE_COMPACT_AT   48     // Records bis zur Kompaktierung
 
-void historySetUpdateCallback(HistoryUpdateCallback cb)
+enum TableRecType : uint8_t {
+  TREC_START = 1,
+  TREC_END   = 2
+};
+
+struct TableRecStart{
+  uint32_t run;
+  uint32_t ts;
+  char     mode[10];
+};
+
+struct TableRecEnd{
+  uint32_t run;
+  uint32_t ts;
+  float    liters;
+  char     reason[20];
+  RunStats st;
+};
+
+/* 2 Segmente, jedes fasst alle Records bis zur Kompaktierung */
+#define TABLE_SEG_BYTES LogStore::segmentBytesFor(TABLE_COMPACT_AT * 2, sizeof(TableRecEnd))
+
+/* Snapshot + .tmp beim Schreiben + Journal */
+static_assert(2 * (sizeof(TableHeader) + MAX_ROWS * sizeof(Row)) + 2 * TABLE_SEG_BYTES
+              <= FS_TABLE_BYTES, "table over flash budget");
+
+static LogStore tableLog("/htab", 2, TABLE_SEG_BYTES, TABLE_LOG_FORMAT);
+
+static uint16_t journalRecords = 0;
+
+static Row* findRun(uint32_t run)
 {
-  updateCb = cb;
+  for(uint8_t i = 0; i < rowCount; i++)
+    if(rowAt(i).run == run) return &rowAt(i);
+  return nullptr;
+}
+
+static void applyStart(const TableRecStart& s)
+{
+  if(s.run < nextRun) return;        // schon im Snapshot
+
+  Row r = {};
+  r.run     = s.run;
+  r.startTs = s.ts;
+  memcpy(r.mode, s.mode, sizeof(r.mode));
+  r.mode[sizeof(r.mode) - 1] = 0;
+  insertRow(r);
+}
+
+static void applyEnd(const TableRecEnd& e)
+{
+  TABLE_GUARD();
+  Row* r = findRun(e.run);
+  if(!r) return;
+
+  r->endTs  = e.ts;
+  r->liters = e.liters;
+  r->st     = e.st;
+  memcpy(r->reason, e.reason, sizeof(r->reason));
+  r->reason[sizeof(r->reason) - 1] = 0;
+}
+
+static void onTableRecord(uint8_t type, uint32_t, const uint8_t* data, uint8_t len, void*)
+{
+  journalRecords++;
+
+  if(type == TREC_START && len == sizeof(TableRecStart)) {
+    TableRecStart s;
+    memcpy(&s, data, sizeof(s));
+    applyStart(s);
+  } else if(type == TREC_END && len == sizeof(TableRecEnd)) {
+    TableRecEnd e;
+    memcpy(&e, data, sizeof(e));
+    applyEnd(e);
+  }
+}
+
+static void loadTable()
+{
+  clearRows();
+  nextRun = 1;
+  journalRecords = 0;
+  bool legacy = loadSnapshot();
+
+  tableLog.replay(onTableRecord, nullptr);
+
+  if(legacy) {
+    saveSnapshot();
+    tableLog.clear();
+    journalRecords = 0;
+  }
+}
+
+static void compactTable()
+{
+  if(!saveSnapshot()) return;
+  tableLog.clear();
+  journalRecords = 0;
+}
+
+/* ============================================================
+   PERSISTENZ (600s / 3600s / 21600s)
+   Jeder abgeschlossene Bucket wird als Record an einen LogStore
+   angehängt und beim Boot wieder in den Ring eingespielt.
+   Größe je Stufe fest aus dem Flash-Budget (FS_TIER_LOG_BYTES,
+   4 Segmente); nach Rotation bleiben 3 Segmente, die mindestens
+   count Buckets fassen müssen.
+   ============================================================ */
+
+#define TIER_LOG_FORMAT   1
+#define TIER_LOG_SEGMENTS 4
+
+/* Abschlusszeit + Bucket */
+struct TierRec{
+  uint32_t ts;
+  float    b[HistSeries::FIELDS];
+};
+
+#define TIER_SEG_BYTES    (FS_TIER_LOG_BYTES / TIER_LOG_SEGMENTS)
+#define TIER_LOG_HOLDS    ((TIER_LOG_SEGMENTS - 1) * \
+                           LogStore::recordsPerSegment(TIER_SEG_BYTES, sizeof(TierRec)))
+
+static_assert(TIER_LOG_HOLDS >= HistSeries::tierCount[HIST_600S] &&
+              TIER_LOG_HOLDS >= HistSeries::tierCount[HIST_3600S] &&
+              TIER_LOG_HOLDS >= HistSeries::tierCount[HIST_21600S],
+              "FS_TIER_LOG_BYTES too small to refill the RAM tiers");
+
+static LogStore log600  ("/h600",   TIER_LOG_SEGMENTS, TIER_SEG_BYTES, TIER_LOG_FORMAT);
+static LogStore log3600 ("/h3600",  TIER_LOG_SEGMENTS, TIER_SEG_BYTES, TIER_LOG_FORMAT);
+static LogStore log21600("/h21600", TIER_LOG_SEGMENTS, TIER_SEG_BYTES, TIER_LOG_FORMAT);
+
+static LogStore* tierLog(uint8_t t)
+{
+  if(t == HIST_600S)   return &log600;
+  if(t == HIST_3600S)  return &log3600;
+  if(t == HIST_21600S) return &log21600;
+  return nullptr;       // 2s / 30s nur im RAM
+}
+
+static void onTierRecord(uint8_t type, uint32_t, const uint8_t* data, uint8_t len, void*)
+{
+  if(type >= HistSeries::TIERS || len != sizeof(TierRec)) return;
+
+  TierRec r;
+  memcpy(&r, data, sizeof(r));
+  series.restore(type, r.b, r.ts);
+}
+
+static void restoreTiers()
+{
+  const HistorySeries tiers[] = { HIST_600S, HIST_3600S, HIST_21600S };
+
+  for(HistorySeries s : tiers) {
+    uint32_t n = tierLog(s)->replay(onTierRecord, nullptr);
+    Serial.printf("[HIST] tier %u: %lu buckets restored\n", (unsigned)s, (unsigned long)n);
+  }
+}
+
+/* ============================================================
+   RUN STATISTICS
+   Läuft im 2-s-Takt mit: beginnt mit dem ersten Sample in einer
+   Lauf-Phase, endet mit historyEndProduction(). TDS per Welford
+   (nur PRODUCTION), Volumen aus Durchfluss x 2 s.
+   ============================================================ */
+
+struct RunAcc{
+  bool     active;
+  uint32_t tdsN;
+  double   tdsMean;
+  double   tdsM2;
+  float    tdsMin;
+  float    tdsMax;
+  uint32_t flowN;
+  double   flowSum;
+  float    flowPeak;
+  double   litersIn;
+  double   litersOut;
+  uint32_t phaseSamples[HIST_PHASES];
+  double   phaseInL[HIST_PHASES];
+};
+
+static RunAcc runAcc;
+
+static void runAccAdd(float tds, float flowOut, float flowIn, uint8_t state)
+{
+  bool inRun = state >= HST_PREPARE && state <= HST_POSTFLUSH;
+
+  /* außerhalb eines Laufs verwerfen, außer die Produktion ist noch offen */
+  if(!inRun) {
+    if(currentRow < 0) runAcc.active = false;
+    return;
+  }
+
+  if(!runAcc.active) {
+    runAcc = {};
+    runAcc.active = true;
+  }
+
+  const float dtMin = 2.0f / 60.0f;
+  uint8_t ph = state - HST_PREPARE;
+
+  runAcc.phaseSamples[ph]++;
+  runAcc.phaseInL[ph] += flowIn * dtMin;
+  runAcc.litersIn     += flowIn * dtMin;
+  runAcc.litersOut    += flowOut * dtMin;
+
+  if(state != HST_PRODUCTION) return;
+
+  if(isfinite(tds)) {
+    runAcc.tdsN++;
+    double d = tds - runAcc.tdsMean;
+    runAcc.tdsMean += d / runAcc.tdsN;
+    runAcc.tdsM2   += d * (tds - runAcc.tdsMean);
+
+    if(runAcc.tdsN == 1 || tds < runAcc.tdsMin) runAcc.tdsMin = tds;
+    if(runAcc.tdsN == 1 || tds > runAcc.tdsMax) runAcc.tdsMax = tds;
+  }
+
+  runAcc.flowN++;
+  runAcc.flowSum += flowOut;
+  runAcc.flowPeak = max(runAcc.flowPeak, flowOut);
+}
+
+static void runAccFinish(RunStats& st)
+{
+  const RunAcc& a = runAcc;
+
+  st = {};
+  st.tdsMin    = a.tdsN ? a.tdsMin : NAN;
+  st.tdsMean   = a.tdsN ? (float)a.tdsMean : NAN;
+  st.tdsMax    = a.tdsN ? a.tdsMax : NAN;
+  st.tdsSd     = a.tdsN > 1 ? sqrtf(a.tdsM2 / (a.tdsN - 1)) : NAN;
+  st.flowPeak  = a.flowPeak;
+  st.flowAvg   = a.flowN ? (float)(a.flowSum / a.flowN) : 0;
+  st.litersIn  = a.litersIn;
+  st.litersOut = a.litersOut;
+
+  for(uint8_t p = 0; p < HIST_PHASES; p++) {
+    st.phaseSec[p] = min<uint32_t>(a.phaseSamples[p] * 2, 0xFFFF);
+    st.phaseInL[p] = a.phaseInL[p];
+  }
+
+  runAcc.active = false;
 }
 
 /* ============================================================
-   TABLE SAVE / LOAD
+   RUN TRACE
+   Pro Lauf eine Datei /tr<run>.bin mit einem 8-Byte-Record alle
+   2 s, solange der Lauf offen ist. Alle Traces zusammen bleiben in
+   FS_TRACE_BYTES: historyLoop() löscht die ältesten, bis neben
+   ihnen ein voller Trace (TRACE_FILE_MAX) für den offenen Lauf
+   Platz hat.
+
+   Header (16 Byte): u32 magic "OST1", u16 version, u16 intervalSec,
+                     u32 run, u32 startTs
+   Record  (8 Byte): u16 tds x10, u16 flowOut x1000, u16 flowIn x1000,
+                     u8 state, u8 reserviert
+   RAM-Puffer von TRACE_BUF Records -> ein Append alle 32 s.
    ============================================================ */
 
-static void saveTable()
+#define TRACE_MAGIC        0x3154534FUL   // "OST1"
+#define TRACE_VERSION      1
+#define TRACE_MAX_RECORDS  5400           // 3 h, ~43 KB
+#define TRACE_BUF          16
+#define TRACE_PAGE         256            // SPIFFS belegt ganze Pages
+
+struct TraceHeader{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t intervalSec;
+  uint32_t run;
+  uint32_t startTs;
+};
+
+struct TraceRec{
+  uint16_t tds;
+  uint16_t flowOut;
+  uint16_t flowIn;
+  uint8_t  state;
+  uint8_t  rsv;
+};
+
+static_assert(sizeof(TraceRec) == 8, "trace record must stay 8 bytes");
+
+/* Flash-Belegung einer Trace-Datei: Daten-Pages + Index-Page */
+static constexpr uint32_t traceFileBytes(uint32_t size)
+{
+  return (size + TRACE_PAGE - 1) / TRACE_PAGE * TRACE_PAGE + TRACE_PAGE;
+}
+
+#define TRACE_FILE_MAX traceFileBytes(sizeof(TraceHeader) + TRACE_MAX_RECORDS * sizeof(TraceRec))
+
+static_assert(FS_TRACE_BYTES >= 2 * TRACE_FILE_MAX, "trace budget must hold the open and one closed trace");
+
+static uint32_t traceRun     = 0;       // 0 = keine Aufzeichnung
+static uint32_t traceRecords = 0;
+static TraceRec traceBuf[TRACE_BUF];
+static uint8_t  traceFill    = 0;
+static bool     tracePrune   = true;
+static volatile bool traceFlushReq = false;   // Web-Abruf des offenen Laufs
+
+static void tracePath(uint32_t run, char* out, size_t n)
+{
+  snprintf(out, n, "/tr%lu.bin", (unsigned long)run);
+}
+
+static uint16_t fixedU16(float v, float scale)
 {
-  File f = SPIFFS.open(FILE_NAME, "w");
+  if(!(v > 0)) return 0;
+  return (uint16_t)min(v * scale + 0.5f, 65535.0f);
+}
+
+static void traceFlush()
+{
+  if(!traceRun || !traceFill) return;
+
+  char path[24];
+  tracePath(traceRun, path, sizeof(path));
+
+  File f = halFs().open(path, "a");
+  if(f) {
+    f.write((uint8_t*)traceBuf, sizeof(TraceRec) * traceFill);
+    f.close();
+  }
+  traceFill = 0;
+}
+
+static void traceBegin(uint32_t run, uint32_t startTs)
+{
+  traceFlush();
+
+  traceRun = 0;
+  uint32_t fsFree = halFsFree();
+  if(fsFree < FS_FREE_MIN_BYTES + TRACE_FILE_MAX) {
+    Serial.printf("[HIST] %lu bytes free, no trace for run %lu\n",
+                  (unsigned long)fsFree, (unsigned long)run);
+    return;
+  }
+
+  char path[24];
+  tracePath(run, path, sizeof(path));
+
+  File f = halFs().open(path, "w");
   if(!f) return;
 
-  f.write((uint8_t*)&rowCount, sizeof(rowCount));
-  f.write((uint8_t*)rows, sizeof(rows));
+  TraceHeader h = { TRACE_MAGIC, TRACE_VERSION, 2, run, startTs };
+  f.write((uint8_t*)&h, sizeof(h));
   f.close();
 
-  if(updateCb) updateCb();
+  traceRun     = run;
+  traceRecords = 0;
+  traceFill    = 0;
+  tracePrune   = true;
 }
 
-static void loadTable()
+static void traceEnd()
 {
-  if(!SPIFFS.exists(FILE_NAME)) return;
+  traceFlush();
+  traceRun = 0;
+}
 
-  File f = SPIFFS.open(FILE_NAME, "r");
-  if(!f) return;
+static void traceAdd(float tds, float flowOut, float flowIn, uint8_t state)
+{
+  if(!traceRun || traceRecords >= TRACE_MAX_RECORDS) return;
+
+  TraceRec& r = traceBuf[traceFill++];
+  r.tds     = fixedU16(tds, 10);
+  r.flowOut = fixedU16(flowOut, 1000);
+  r.flowIn  = fixedU16(flowIn, 1000);
+  r.state   = state;
+  r.rsv     = 0;
+  traceRecords++;
+
+  if(traceFill >= TRACE_BUF) traceFlush();
+}
+
+/* Run-Nummer aus "tr<run>.bin" (mit oder ohne führendes '/') */
+static uint32_t traceRunOf(const char* name)
+{
+  if(*name == '/') name++;
+  if(strncmp(name, "tr", 2) != 0) return 0;
 
-  size_t n = 0;
-  n += f.read((uint8_t*)&rowCount, sizeof(rowCount));
-  n += f.read((uint8_t*)rows, sizeof(rows));
+  char* end;
+  uint32_t run = strtoul(name + 2, &end, 10);
+  return strcmp(end, ".bin") == 0 ? run : 0;
+}
 
-  if(n != sizeof(rowCount) + sizeof(rows)) {
-    memset(rows, 0, sizeof(rows));
-    rowCount = 0;
+/* Abgeschlossene Traces löschen, älteste zuerst, bis sie zusammen mit
+   TRACE_FILE_MAX für den offenen Lauf in FS_TRACE_BYTES passen;
+   keepAll = false -> alle außer dem laufenden */
+static void tracePruneFiles(bool keepAll)
+{
+  char path[24];
+
+  for(;;) {
+    uint32_t total = 0, oldest = 0;
+
+    File root = halFs().open("/");
+    File f = root.openNextFile();
+
+    while(f) {
+      uint32_t run  = traceRunOf(f.name());
+      uint32_t size = f.size();
+      f.close();
+
+      if(run && run != traceRun) {
+        if(!keepAll) {
+          tracePath(run, path, sizeof(path));
+          halFs().remove(path);
+        } else {
+          total += traceFileBytes(size);
+          if(!oldest || run < oldest) oldest = run;
+        }
+      }
+      f = root.openNextFile();
+    }
+
+    if(!oldest || total + TRACE_FILE_MAX <= FS_TRACE_BYTES) return;
+
+    tracePath(oldest, path, sizeof(path));
+    if(!halFs().remove(path)) return;
   }
+}
 
-  f.close();
+/* läuft im Web-Task: schreibt nichts selbst. Beim offenen Lauf
+   schreibt der nächste Sample-Takt (loop) den Puffer; geliefert
+   wird, was schon in der Datei steht. */
+bool historyTracePath(uint32_t run, char* out, size_t n)
+{
+  if(run && run == traceRun) traceFlushReq = true;
+
+  tracePath(run, out, n);
+  return run && halFs().exists(out);
+}
+
+static HistoryBucketCallback bucketCb = nullptr;
+
+void historySetBucketCallback(HistoryBucketCallback cb)
+{
+  bucketCb = cb;
+}
+
+/* Abgeschlossene Buckets eines Sample-Takts. onClose läuft unter
+   SERIES_GUARD -> dort nur kopieren; Log, Totals und WS-Broadcast
+   danach ohne Lock (je Takt schließt jede Stufe höchstens einmal) */
+struct PendingBucket{
+  uint8_t t;
+  TierRec r;
+};
+
+static PendingBucket pendingBuckets[HistSeries::TIERS];
+static uint8_t       pendingCount = 0;
+
+static void onBucketClosed(uint8_t t, const float* b, uint32_t ts)
+{
+  if(pendingCount >= HistSeries::TIERS) return;
+
+  PendingBucket& p = pendingBuckets[pendingCount++];
+  p.t    = t;
+  p.r.ts = ts;
+  memcpy(p.r.b, b, sizeof(p.r.b));
+}
+
+static void bucketClosed(const PendingBucket& p)
+{
+  LogStore* l = tierLog(p.t);
+  if(l) l->append(p.t, &p.r, sizeof(p.r));
+
+  /* Kalender-Rollups: TDS je 600 s, Sicherung je 21600 s */
+  if(p.t == HIST_600S)
+    totalsOnBucket(p.r.ts, HistSeries::value(p.r.b, CH_TDS, STAT_MEAN),
+                           HistSeries::value(p.r.b, CH_TDS, STAT_MAX));
+  if(p.t == HIST_21600S)
+    totalsSave();
+
+  if(bucketCb) bucketCb((HistorySeries)p.t);
 }
 
 /* ============================================================
@@ -134,154 +711,524 @@ void historyInit()
 {
   loadTable();
 
-  memset(tds2s,   0, sizeof(tds2s));
-  memset(flow2s,  0, sizeof(flow2s));
-  memset(prod2s,  0, sizeof(prod2s));
-
-  memset(tds30s,  0, sizeof(tds30s));
-  memset(flow30s, 0, sizeof(flow30s));
-  memset(prod30s, 0, sizeof(prod30s));
+  bootId = halRandom();
 
-  memset(tds600s,  0, sizeof(tds600s));
-  memset(flow600s, 0, sizeof(flow600s));
-  memset(prod600s, 0, sizeof(prod600s));
+  series.clear();
+  series.onClose(onBucketClosed);
 
-  idx2s = idx30s = idx600s = 0;
-  accCnt30 = accCnt600 = 0;
+  restoreTiers();
 }
 
 /* ============================================================
-   2s BASE SAMPLE + AGGREGATION
+   2s BASE SAMPLE (Aggregation kaskadiert im TieredSeries)
+   Takt kommt vom Scheduler (main.cpp, TASK_HISTORY_MS)
    ============================================================ */
 
 void historyAddSample2s(float tds,
                         float produced,
                         float flowOutLpm,
-                        float flowInLpm)
+                        float flowInLpm,
+                        uint8_t state)
+{
+  traceAdd(tds, flowOutLpm, flowInLpm, state);
+  if(traceFlushReq) {
+    traceFlushReq = false;
+    traceFlush();
+  }
+  runAccAdd(tds, flowOutLpm, flowInLpm, state);
+
+  float sample[CH_COUNT];
+  sample[CH_TDS]     = tds;
+  sample[CH_FLOW]    = flowOutLpm;
+  sample[CH_FLOW_IN] = flowInLpm;
+  sample[CH_PROD]    = produced;
+
+  uint32_t ts = halEpoch();
+  if(ts < TIME_VALID_MIN) ts = 0;
+
+  PendingBucket closedNow[HistSeries::TIERS];
+  uint8_t n;
+  {
+    SERIES_GUARD();
+    series.add(sample, ts);
+    n = pendingCount;
+    memcpy(closedNow, pendingBuckets, sizeof(PendingBucket) * n);
+    pendingCount = 0;
+  }
+
+  for(uint8_t i = 0; i < n; i++) bucketClosed(closedNow[i]);
+}
+
+/* ============================================================
+   META
+   ============================================================ */
+
+uint32_t historyBootId()
 {
-  uint32_t now = millis();
-  if(now - last2sMs < 2000) return;
-  last2sMs = now;
+  return bootId;
+}
+
+const char* historySeriesName(HistorySeries s)
+{
+  return seriesNames[s];
+}
+
+bool historySeriesByName(const char* name, HistorySeries& s)
+{
+  for(uint8_t t = 0; t < HistSeries::TIERS; t++) {
+    if(strcmp(name, seriesNames[t]) == 0) {
+      s = (HistorySeries)t;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* ============================================================
+   SELECTION (+ optional LTTB-Downsampling)
+   Punkte werden über den Mittelwert von Kanal 0 (TDS) ausgewählt
+   (Largest-Triangle-Three-Buckets). Min/Max eines Punkts fassen
+   alle Buckets seit dem vorherigen Punkt zusammen -> Spitzen
+   bleiben auch in der reduzierten Serie sichtbar.
 
-  /* --- 2s --- */
-  tds2s[idx2s]  = tds;
-  flow2s[idx2s] = flowOutLpm;
-  prod2s[idx2s] = produced;
-  idx2s = (idx2s + 1) % HIST_2S_COUNT;
+   Spalten-Id: (Kanal << 2) | ChannelStat
+   ============================================================ */
+
+#define COL_CH(c)   ((c) >> 2)
+#define COL_STAT(c) ((ChannelStat)((c) & 3))
 
-  /* --- 30s aggregation (15 × 2s) --- */
-  accTds30  += tds;
-  accFlow30 += flowOutLpm;
-  accCnt30++;
+/* zusammenhängender Ausschnitt einer Stufe */
+struct SelSegment{
+  uint8_t  tier;
+  uint16_t start;
+  uint16_t count;
+};
 
-  if(accCnt30 >= 15) {
-    tds30s[idx30s]  = accTds30 / accCnt30;
-    flow30s[idx30s] = accFlow30 / accCnt30;
-    prod30s[idx30s] = produced;
+/* alle Buckets der Segmente der Reihe nach an fn(v, b, ts),
+   v = Index über alle Segmente */
+template<typename Fn>
+static void selScan(const SelSegment* seg, uint8_t segments, Fn fn)
+{
+  uint16_t v = 0;
+  for(uint8_t k = 0; k < segments; k++)
+    series.scan(seg[k].tier, seg[k].start, seg[k].count,
+      [&](uint16_t, const float* b, uint32_t ts) { fn(v++, b, ts); });
+}
 
-    idx30s = (idx30s + 1) % HIST_30S_COUNT;
-    accTds30 = accFlow30 = 0;
-    accCnt30 = 0;
+/* wählt points Indizes aus [0, n) */
+static void lttbSelect(const float* y, uint16_t n, uint16_t points, uint16_t* out)
+{
+  float every = (float)(n - 2) / (points - 2);
+  uint16_t a = 0;
+  out[0] = 0;
+
+  for(uint16_t j = 0; j < points - 2; j++) {
+    /* Mittelwert des nächsten Buckets als dritter Eckpunkt */
+    uint16_t nStart = (uint16_t)((j + 1) * every) + 1;
+    uint16_t nEnd   = min<uint16_t>((uint16_t)((j + 2) * every) + 1, n);
+    float avgX = 0, avgY = 0;
+    for(uint16_t i = nStart; i < nEnd; i++) { avgX += i; avgY += y[i]; }
+    uint16_t nLen = max<uint16_t>(nEnd - nStart, 1);
+    avgX /= nLen;
+    avgY /= nLen;
+
+    /* größtes Dreieck im aktuellen Bucket */
+    uint16_t cStart = (uint16_t)(j * every) + 1;
+    uint16_t cEnd   = (uint16_t)((j + 1) * every) + 1;
+    float bestArea = -1;
+    uint16_t best = cStart;
+    float ya = y[a];
+
+    for(uint16_t i = cStart; i < cEnd; i++) {
+      float area = fabsf((a - avgX) * (y[i] - ya) - (a - i) * (avgY - ya));
+      if(area > bestArea) { bestArea = area; best = i; }
+    }
+
+    out[j + 1] = best;
+    a = best;
   }
 
-  /* --- 600s aggregation (300 × 2s) --- */
-  accTds600  += tds;
-  accFlow600 += flowOutLpm;
-  accCnt600++;
+  out[points - 1] = n - 1;
+}
 
-  if(accCnt600 >= 300) {
-    tds600s[idx600s]  = accTds600 / accCnt600;
-    flow600s[idx600s] = accFlow600 / accCnt600;
-    prod600s[idx600s] = produced;
+static void selColumns(bool stats, HistorySelection& sel)
+{
+  sel.columns = 0;
+
+  /* Primärspalte je Kanal, mit stats zusätzlich Min/Max/Last */
+  for(uint8_t ch = 0; ch < CH_COUNT; ch++)
+    sel.col[sel.columns++] = (ch << 2) | STAT_MEAN;
+
+  if(stats) {
+    for(uint8_t ch = 0; ch < CH_COUNT; ch++) {
+      if(HistChannels::agg[ch] != AGG_STATS) continue;
+      sel.col[sel.columns++] = (ch << 2) | STAT_MIN;
+      sel.col[sel.columns++] = (ch << 2) | STAT_MAX;
+      sel.col[sel.columns++] = (ch << 2) | STAT_LAST;
+    }
+  }
+}
 
-    idx600s = (idx600s + 1) % HIST_600S_COUNT;
-    accTds600 = accFlow600 = 0;
-    accCnt600 = 0;
+/* Momentaufnahme der Segmente nach sel (unter SERIES_GUARD): mit
+   LTTB erst die Schlüsselspalte in einen temporären Puffer, dann
+   ein Lauf, der die Ausgabepunkte füllt */
+static void selSnapshot(const SelSegment* seg, uint8_t segments, uint16_t maxPoints,
+                        HistorySelection& sel)
+{
+  uint16_t n = 0;
+  for(uint8_t k = 0; k < segments; k++) n += seg[k].count;
+
+  if(maxPoints == 0 || maxPoints > HIST_MAX_POINTS) maxPoints = HIST_MAX_POINTS;
+
+  /* ohne LTTB (oder ohne Puffer): die neuesten Buckets */
+  uint16_t pos[HIST_MAX_POINTS];
+  sel.count = min<uint16_t>(n, maxPoints);
+  for(uint16_t i = 0; i < sel.count; i++) pos[i] = n - sel.count + i;
+
+  if(maxPoints >= 3 && maxPoints < n) {
+    std::unique_ptr<float[]> y(new (std::nothrow) float[n]);
+    if(y) {
+      selScan(seg, segments, [&](uint16_t v, const float* b, uint32_t) {
+        y[v] = HistSeries::value(b, 0, STAT_MEAN);
+      });
+      lttbSelect(y.get(), n, maxPoints, pos);
+    }
   }
 
-  /* --- 3600s aggregation (1800 × 2s) --- */
-  accTds3600 += tds;
-  accFlow3600 += flowOutLpm;
-  accCnt3600++;
+  /* Min/Max über alle Buckets seit dem vorherigen Punkt */
+  float    span[HIST_MAX_COLS];
+  uint16_t j = 0;
+  for(uint8_t c = 0; c < sel.columns; c++) span[c] = NAN;
+
+  selScan(seg, segments, [&](uint16_t v, const float* b, uint32_t ts) {
+    if(j >= sel.count) return;
+
+    for(uint8_t c = 0; c < sel.columns; c++) {
+      ChannelStat st = COL_STAT(sel.col[c]);
+      if(st != STAT_MIN && st != STAT_MAX) continue;
+
+      float x = HistSeries::value(b, COL_CH(sel.col[c]), st);
+      if(isnan(span[c]))      span[c] = x;
+      else if(st == STAT_MIN) span[c] = min(span[c], x);
+      else                    span[c] = max(span[c], x);
+    }
+
+    if(v != pos[j]) return;
+
+    sel.t[j] = ts;
+    for(uint8_t c = 0; c < sel.columns; c++) {
+      ChannelStat st = COL_STAT(sel.col[c]);
+      bool minMax = st == STAT_MIN || st == STAT_MAX;
+      sel.v[c][j] = minMax ? span[c] : HistSeries::value(b, COL_CH(sel.col[c]), st);
+      span[c] = NAN;
+    }
+    j++;
+  });
+}
 
-  if(accCnt3600 >= 1800) {
+void historySelect(HistorySeries s, bool stats, uint16_t maxPoints, uint32_t since,
+                   HistorySelection& sel)
+{
+  SERIES_GUARD();
 
-    tds3600s[idx3600s]  = accTds3600 / accCnt3600;
-    flow3600s[idx3600s] = accFlow3600 / accCnt3600;
-    prod3600s[idx3600s] = produced;
+  sel.series = s;
+  sel.seq    = series.lastSeq(s);
+  selColumns(stats, sel);
 
-    idx3600s = (idx3600s + 1) % HIST_3600S_COUNT;
+  /* ohne since: ganze Stufe, sonst nur Buckets mit seq > since */
+  uint16_t n = series.count(s);
+  uint16_t start = 0;
 
-    accTds3600 = accFlow3600 = 0;
-    accCnt3600 = 0;
+  if(since) {
+    uint32_t fresh = (since < sel.seq) ? sel.seq - since : 0;
+    fresh = min<uint32_t>(fresh, series.filled(s));
+    start = n - fresh;
+    n = fresh;
   }
 
-  /* --- 21600s aggregation (10800 × 2s) --- */
-  accTds21600 += tds;
-  accFlow21600 += flowOutLpm;
-  accCnt21600++;
+  SelSegment seg = { (uint8_t)s, start, n };
+  selSnapshot(&seg, 1, maxPoints, sel);
+}
 
-  if(accCnt21600 >= 10800) {
+/* ============================================================
+   RANGE (zusammengesetzt aus mehreren Stufen)
+   Ein Bucket deckt (ts - bucketSec, ts] ab. Von fein nach grob:
+   jede Stufe liefert die Buckets im Bereich, die vollständig vor
+   dem Beginn der feineren Abdeckung enden. Buckets ohne gültige
+   Zeit (vor NTP) werden übersprungen.
+   ============================================================ */
 
-    tds21600s[idx21600s]  = accTds21600 / accCnt21600;
-    flow21600s[idx21600s] = accFlow21600 / accCnt21600;
-    prod21600s[idx21600s] = produced;
+bool historySelectRange(uint32_t from, uint32_t to, bool stats, uint16_t maxPoints,
+                        HistorySelection& sel)
+{
+  selColumns(stats, sel);
+  sel.count = 0;
+
+  if(to <= from) return false;
+
+  SERIES_GUARD();
+
+  SelSegment found[HistSeries::TIERS];
+  uint8_t  nFound = 0;
+  uint32_t edge   = to;        // feinere Stufen decken (edge, to] ab
+  int8_t   finest = -1;
+
+  for(uint8_t t = 0; t < HistSeries::TIERS && edge > from; t++) {
+    uint16_t n     = series.count(t);
+    uint16_t start = n - series.filled(t);
+    uint16_t end   = start;
+    uint32_t first = 0;
+
+    /* vorwärts (komprimierte Stufen decodieren sequentiell): gesucht
+       ist der jüngste zusammenhängende Lauf gültiger Zeiten > from,
+       davon alles bis edge */
+    series.scan(t, start, n - start, [&](uint16_t i, const float*, uint32_t ts) {
+      if(ts < TIME_VALID_MIN || ts <= from) { start = end = i + 1; return; }
+      if(start == i) first = ts;
+      if(ts <= edge) end = i + 1;
+    });
+
+    if(start >= end) continue;
+
+    found[nFound++] = { t, start, (uint16_t)(end - start) };
+    edge = first - series.bucketSec(t);
+    if(finest < 0) finest = t;
+  }
+
+  if(finest < 0) return false;
+
+  /* grob -> fein = zeitlich aufsteigend */
+  SelSegment seg[HistSeries::TIERS];
+  for(uint8_t k = 0; k < nFound; k++) seg[k] = found[nFound - 1 - k];
 
-    idx21600s = (idx21600s + 1) % HIST_21600S_COUNT;
+  sel.series = (HistorySeries)finest;
+  sel.seq    = series.lastSeq(finest);
+
+  selSnapshot(seg, nFound, maxPoints, sel);
+  return true;
+}
 
-    accTds21600 = accFlow21600 = 0;
-    accCnt21600 = 0;
+static void writeColumnKey(Print& out, uint8_t c)
+{
+  static const char* const suffix[4] = { "", "Min", "Max", "Last" };
+
+  char key[24];
+  snprintf(key, sizeof(key), "%s%s", chName[COL_CH(c)], suffix[COL_STAT(c)]);
+  jsonWriteString(out, key);
+}
+
+/* ============================================================
+   SERIES JSON (gestreamt, ein Wert pro Aufruf)
+   {"boot":..,"seq":..,"dt":..,"t":[...],"tds":[...],...}
+   seq = Sequenznummer des neuesten Buckets der Stufe,
+   t   = Abschlusszeit je Punkt (Epoch s, 0 = unbekannt)
+   ============================================================ */
+
+bool historySeriesJsonNext(const HistorySelection& sel, HistoryJsonCursor& c, Print& out)
+{
+  /* Stufe 0 = Meta + Zeitstempel, danach je Spalte eine Stufe */
+  if(c.stage > sel.columns) {
+    out.write('}');
+    return false;
   }
+
+  if(c.stage == 0 && c.pos == 0) {
+    out.write('{');
+    jsonWriteKey(out, "boot", true); jsonWriteUInt(out, bootId);
+    jsonWriteKey(out, "seq");        jsonWriteUInt(out, sel.seq);
+    jsonWriteKey(out, "dt");         jsonWriteUInt(out, series.bucketSec(sel.series));
+    jsonWriteKey(out, "t");
+    out.write('[');
+  } else if(c.pos == 0) {
+    out.write(',');
+    writeColumnKey(out, sel.col[c.stage - 1]);
+    out.write(':');
+    out.write('[');
+  }
+
+  if(c.pos < sel.count) {
+    if(c.pos) out.write(',');
+
+    if(c.stage == 0) jsonWriteUInt(out, sel.t[c.pos]);
+    else             jsonWriteFloat(out, sel.v[c.stage - 1][c.pos], 6);
+    c.pos++;
+  }
+
+  if(c.pos >= sel.count) {
+    out.write(']');
+    c.pos = 0;
+    c.stage++;
+  }
+  return true;
 }
 
+/* neuester Bucket einer Stufe als WS-Nachricht:
+   {"hist":{"series":"600s","boot":..,"seq":..,"t":..,"tds":..,...}} */
+void historyWriteLastBucketJson(HistorySeries s, Print& out)
+{
+  static const char* const suffix[4] = { "", "Min", "Max", "Last" };
+
+  SERIES_GUARD();
+
+  uint16_t last = series.count(s) - 1;
+  float    b[HistSeries::FIELDS];
+  uint32_t ts;
+  series.read(s, last, b, &ts);
+
+  out.write((const uint8_t*)"{\"hist\":{", 9);
+  jsonWriteKey(out, "series", true); jsonWriteString(out, seriesNames[s]);
+  jsonWriteKey(out, "boot");         jsonWriteUInt(out, bootId);
+  jsonWriteKey(out, "seq");          jsonWriteUInt(out, series.lastSeq(s));
+  jsonWriteKey(out, "t");            jsonWriteUInt(out, ts);
+
+  for(uint8_t ch = 0; ch < CH_COUNT; ch++) {
+    uint8_t stats = (HistChannels::agg[ch] == AGG_STATS) ? 4 : 1;
+
+    for(uint8_t st = 0; st < stats; st++) {
+      char key[24];
+      snprintf(key, sizeof(key), "%s%s", chName[ch], suffix[st]);
+      jsonWriteKey(out, key);
+      jsonWriteFloat(out, HistSeries::value(b, ch, (ChannelStat)st), 6);
+    }
+  }
+
+  out.write((const uint8_t*)"}}", 2);
+}
 
 /* ============================================================
-   SERIES JSON
+   SERIES BINARY (columnar, little-endian)
+
+   Header (20 Byte):
+     u8  version   (HIST_BIN_VERSION)
+     u8  tier      (HistorySeries)
+     u8  encoding  (HistoryBinEncoding)
+     u8  columns
+     u32 bucketSec
+     u16 reserved  (0)
+     u16 count
+     u32 seq       (Sequenznummer des neuesten Buckets)
+     u32 boot
+   Spalten-Ids:
+     columns x u8 ((Kanal << 2) | ChannelStat), auf 4 Byte aufgefüllt
+   Zeitstempel:
+     count x u32 (Epoch s, 0 = unbekannt)
+
+   Danach je Spalte, ältester Wert zuerst:
+     HIST_BIN_F32:   count x f32
+     HIST_BIN_DI16:  f32 scale, count x i16 (erster Wert absolut,
+                     danach Deltas; Wert = Summe * scale),
+                     auf 4 Byte aufgefüllt
    ============================================================ */
 
-String historyGetSeriesJson(HistorySeries s)
+#define HIST_BIN_VERSION 1
+#define HIST_BIN_HEADER  20
+
+static void putU16(Print& out, uint16_t v)
+{
+  uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+  out.write(b, 2);
+}
+
+static void putU32(Print& out, uint32_t v)
+{
+  uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8),
+                   (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+  out.write(b, 4);
+}
+
+static void putF32(Print& out, float f)
+{
+  uint32_t v;
+  memcpy(&v, &f, sizeof(v));
+  putU32(out, v);
+}
+
+/* DI16: Skala so wählen, dass Werte und Deltas sicher in int16 passen */
+static float columnScale(const HistorySelection& sel, uint8_t c)
+{
+  float maxAbs = 0;
+  for(uint16_t j = 0; j < sel.count; j++) {
+    float a = fabsf(sel.v[c][j]);
+    if(isfinite(a) && a > maxAbs) maxAbs = a;
+  }
+  return max(HistChannels::scale[COL_CH(sel.col[c])], maxAbs / 16000.0f);
+}
+
+size_t historySeriesBinSize(const HistorySelection& sel, HistoryBinEncoding enc)
 {
-  StaticJsonDocument<16384> doc;
-  JsonArray t = doc["tds"].to<JsonArray>();
-  JsonArray f = doc["flow"].to<JsonArray>();
-  JsonArray p = doc["prod"].to<JsonArray>();
+  size_t col = (enc == HIST_BIN_DI16)
+    ? 4 + ((sel.count + 1) & ~1u) * 2
+    : (size_t)sel.count * 4;
+
+  return HIST_BIN_HEADER + ((sel.columns + 3) & ~3u)
+       + (size_t)sel.count * 4 + sel.columns * col;
+}
 
-  float *tdsArr, *flowArr, *prodArr;
-  uint16_t count, idx;
+/* Werte je Fragment: 4-Byte-Werte bzw. int16-Deltas (<= STREAM_FRAG_MAX) */
+#define BIN_FRAG_U32  60
+#define BIN_FRAG_I16  120
 
-  if(s == HIST_2S) {
-    tdsArr = tds2s; flowArr = flow2s; prodArr = prod2s;
-    count = HIST_2S_COUNT; idx = idx2s;
-  } else if(s == HIST_30S) {
-    tdsArr = tds30s; flowArr = flow30s; prodArr = prod30s;
-    count = HIST_30S_COUNT; idx = idx30s;
-  } else if(s == HIST_600S) {
-    tdsArr = tds600s; flowArr = flow600s; prodArr = prod600s;
-    count = HIST_600S_COUNT; idx = idx600s;
-  } else if(s == HIST_3600S) {
-    tdsArr = tds3600s; flowArr = flow3600s; prodArr = prod3600s;
-    count = HIST_3600S_COUNT; idx = idx3600s;
-  } else /*if(s == HIST_21600S)*/ {
-    tdsArr = tds21600s; flowArr = flow21600s; prodArr = prod21600s;
-    count = HIST_21600S_COUNT; idx = idx21600s;
+enum BinStage : uint8_t { BIN_HEAD, BIN_TIMES, BIN_COLUMNS };
+
+bool historySeriesBinNext(const HistorySelection& sel, HistoryBinEncoding enc,
+                          HistoryBinCursor& c, Print& out)
+{
+  if(c.stage == BIN_HEAD) {
+    uint8_t hdr[4] = { HIST_BIN_VERSION, (uint8_t)sel.series, (uint8_t)enc, sel.columns };
+    out.write(hdr, sizeof(hdr));
+    putU32(out, series.bucketSec(sel.series));
+    putU16(out, 0);
+    putU16(out, sel.count);
+    putU32(out, sel.seq);
+    putU32(out, bootId);
+
+    out.write(sel.col, sel.columns);
+    for(uint8_t k = sel.columns; k & 3; k++) out.write((uint8_t)0);
+
+    c.stage = BIN_TIMES;
+    c.pos   = 0;
+    return true;
   }
 
+  if(c.stage == BIN_TIMES) {
+    uint16_t end = min<uint16_t>(sel.count, c.pos + BIN_FRAG_U32);
+    for(; c.pos < end; c.pos++) putU32(out, sel.t[c.pos]);
+    if(c.pos < sel.count) return true;
 
+    c.stage = BIN_COLUMNS;
+    c.col   = 0;
+    c.pos   = 0;
+    return c.col < sel.columns;
+  }
 
-  for(uint16_t i = 0; i < count; i++) {
-    uint16_t k = (idx + i) % count;
-    t.add(tdsArr[k]);
-    f.add(flowArr[k]);
-    p.add(prodArr[k]);
+  /* BIN_COLUMNS: eine Spalte in Teilen, DI16 mit Skala vorneweg */
+  if(enc == HIST_BIN_DI16) {
+    if(c.pos == 0) {
+      c.scale = columnScale(sel, c.col);
+      c.prev  = 0;
+      putF32(out, c.scale);
+    }
+    uint16_t end = min<uint16_t>(sel.count, c.pos + BIN_FRAG_I16);
+    for(; c.pos < end; c.pos++) {
+      float x = sel.v[c.col][c.pos];
+      int32_t q = isfinite(x) ? (int32_t)lroundf(x / c.scale) : c.prev;
+      putU16(out, (uint16_t)(int16_t)(q - c.prev));
+      c.prev = q;
+    }
+    if(c.pos < sel.count) return true;
+    if(sel.count & 1) putU16(out, 0);   // Padding auf 4 Byte
+  } else {
+    uint16_t end = min<uint16_t>(sel.count, c.pos + BIN_FRAG_U32);
+    for(; c.pos < end; c.pos++) putF32(out, sel.v[c.col][c.pos]);
+    if(c.pos < sel.count) return true;
   }
 
-  String out;
-  serializeJson(doc, out);
-  return out;
+  c.pos = 0;
+  return ++c.col < sel.columns;
 }
 
 /* ============================================================
-   PRODUCTION TABLE (UNCHANGED BEHAVIOR)
+   PRODUCTION TABLE
    ============================================================ */
 
 uint8_t historyGetRowCount()
@@ -291,77 +1238,279 @@ uint8_t historyGetRowCount()
 
 void historyStartProduction(const char* mode)
 {
-  currentRow = 0;
+  TableRecStart s = {};
+  s.run = nextRun;
+  s.ts  = halEpoch();
+  strncpy(s.mode, mode, sizeof(s.mode) - 1);
 
-  uint8_t moveCount = min(rowCount, (uint8_t)(MAX_ROWS - 1));
-  if(moveCount > 0)
-    memmove(&rows[1], &rows[0], sizeof(Row) * moveCount);
+  applyStart(s);
+  currentRow = rowHead;
+  traceBegin(s.run, s.ts);
 
-  rows[0] = {};
-  rows[0].startTs = time(nullptr);
+  if(tableLog.append(TREC_START, &s, sizeof(s))) journalRecords++;
 
-  strncpy(rows[0].mode, mode, sizeof(rows[0].mode) - 1);
-  rows[0].mode[sizeof(rows[0].mode) - 1] = 0;
-
-  if(rowCount < MAX_ROWS)
-    rowCount++;
-
-  saveTable();
+  if(updateCb) updateCb();
 }
 
 void historyEndProduction(const char* reason, float finalLiters)
 {
   if(currentRow < 0) return;
 
-  Row &r = rows[currentRow];
-
-  r.endTs  = time(nullptr);
-  r.liters = finalLiters;
-
   if(!reason || !reason[0])
     reason = "Stopped";
 
-  strncpy(r.reason, reason, sizeof(r.reason) - 1);
-  r.reason[sizeof(r.reason) - 1] = 0;
+  TableRecEnd e = {};
+  e.run    = rows[currentRow].run;
+  e.ts     = halEpoch();
+  e.liters = finalLiters;
+  strncpy(e.reason, reason, sizeof(e.reason) - 1);
+  runAccFinish(e.st);
 
+  applyEnd(e);
   currentRow = -1;
-  saveTable();
+  traceEnd();
+  totalsOnRunEnd(e.ts);
+
+  if(tableLog.append(TREC_END, &e, sizeof(e))) journalRecords++;
+
+  if(updateCb) updateCb();
 }
 
-String historyGetTableJson()
+/* Kompaktierung außerhalb des Steuerpfads, nicht während eines Laufs */
+static const ProfStage profCompact = profStage("tableCompact");
+
+void historyLoop()
 {
-  StaticJsonDocument<8192> doc;
-  JsonArray arr = doc.to<JsonArray>();
+  if(journalRecords >= TABLE_COMPACT_AT && currentRow < 0) {
+    PROF_SCOPE(profCompact);
+    compactTable();
+  }
 
-  for(int i = 0; i < rowCount; i++) {
-    JsonObject o = arr.add<JsonObject>();
+  if(tracePrune) {
+    tracePrune = false;
+    tracePruneFiles(true);
+  }
+}
 
-    o["mode"]   = rows[i].mode;
-    o["start"]  = rows[i].startTs;
-    o["end"]    = rows[i].endTs;
+/* ============================================================
+   TABLE QUERY
+   Cursor: run = zuletzt geprüfter Lauf, stage = bisher passende
+   Zeilen, head = ausgegebene Zeilen. Die Zeile wird beim ersten
+   Fragment unter tableLock in den Cursor kopiert; das zweite
+   Fragment liest nur die Kopie.
+   ============================================================ */
 
-    uint32_t dur = 0;
-    if(rows[i].startTs && rows[i].endTs)
-      dur = rows[i].endTs - rows[i].startTs;
+static bool rowMatches(const HistoryTableQuery& q, const Row& r)
+{
+  if(q.mode[0]   && strcasecmp(q.mode, r.mode) != 0)     return false;
+  if(q.reason[0] && strcasecmp(q.reason, r.reason) != 0) return false;
+  if(q.from && r.startTs < q.from) return false;
+  if(q.to   && r.startTs > q.to)   return false;
+  return true;
+}
 
-    o["duration"] = dur;
-    o["liters"]   = rows[i].liters;
-    o["reason"]   = rows[i].reason;
+uint16_t historyTableCount(const HistoryTableQuery& q)
+{
+  TABLE_GUARD();
+  uint16_t n = 0;
+  for(uint8_t i = 0; i < rowCount; i++)
+    if(rowMatches(q, rowAt(i))) n++;
+  return n;
+}
+
+/* nächste Zeile der Seite nach c.row; false = keine mehr. Läufe
+   sind fortlaufend nummeriert, neueste zuerst -> nächste Zeile =
+   neueste mit kleinerer Nummer als c.run (neue Läufe oder eine
+   geleerte Tabelle verschieben so nichts) */
+static bool nextTableRow(const HistoryTableQuery& q, HistoryTableCursor& c)
+{
+  TABLE_GUARD();
+  for(uint8_t i = 0; i < rowCount && c.head < q.limit; i++) {
+    const Row& r = rowAt(i);
+    if(c.run && r.run >= c.run) continue;
+    c.run = r.run;
+    if(!rowMatches(q, r)) continue;
+    if(c.stage++ < q.offset) continue;
+    c.head++;
+    c.row = r;
+    return true;
   }
+  return false;
+}
 
-  String out;
-  serializeJson(doc, out);
-  return out;
+static uint32_t rowDuration(const Row& r)
+{
+  return (r.startTs && r.endTs) ? r.endTs - r.startTs : 0;
 }
 
-void historyClearProduction()
+/* ein Row-Objekt pro Aufruf: [{...},{...}] */
+static void writeFloatArray(Print& out, const float* v, uint8_t n)
 {
-  rowCount = 0;
-  currentRow = -1;
-  memset(rows, 0, sizeof(rows));
+  out.write('[');
+  for(uint8_t i = 0; i < n; i++) {
+    if(i) out.write(',');
+    jsonWriteFloat(out, v[i], 5);
+  }
+  out.write(']');
+}
+
+/* zweites Fragment einer Zeile: Laufstatistik (Phasen in der
+   Reihenfolge prepare, autoflush, production, postflush) */
+static void writeRowStatsJson(Print& out, const Row& r)
+{
+  const RunStats& st = r.st;
+
+  jsonWriteKey(out, "tdsMin");    jsonWriteFloat(out, st.tdsMin, 5);
+  jsonWriteKey(out, "tdsMean");   jsonWriteFloat(out, st.tdsMean, 5);
+  jsonWriteKey(out, "tdsMax");    jsonWriteFloat(out, st.tdsMax, 5);
+  jsonWriteKey(out, "tdsSd");     jsonWriteFloat(out, st.tdsSd, 4);
+  jsonWriteKey(out, "flowPeak");  jsonWriteFloat(out, st.flowPeak, 4);
+  jsonWriteKey(out, "flowAvg");   jsonWriteFloat(out, st.flowAvg, 4);
+  jsonWriteKey(out, "litersIn");  jsonWriteFloat(out, st.litersIn, 5);
+  jsonWriteKey(out, "ratio");
+  jsonWriteFloat(out, st.litersIn > 0 ? st.litersOut / st.litersIn : NAN, 4);
+
+  jsonWriteKey(out, "phaseSec");
+  out.write('[');
+  for(uint8_t p = 0; p < HIST_PHASES; p++) {
+    if(p) out.write(',');
+    jsonWriteUInt(out, st.phaseSec[p]);
+  }
+  out.write(']');
+
+  jsonWriteKey(out, "phaseInL");
+  writeFloatArray(out, st.phaseInL, HIST_PHASES);
+}
+
+bool historyTableJsonNext(const HistoryTableQuery& q, HistoryTableCursor& c, Print& out)
+{
+  if(c.sub) {
+    c.sub = 0;
+    writeRowStatsJson(out, c.row);
+    out.write('}');
+    return true;
+  }
+
+  bool first = (c.head == 0);
+  if(!nextTableRow(q, c)) {
+    if(first) out.write('[');
+    out.write(']');
+    return false;
+  }
+  const Row* r = &c.row;
 
-  File f = SPIFFS.open(FILE_NAME, "w");
-  if(f) f.close();
+  out.write(first ? '[' : ',');
+  out.write('{');
+
+  jsonWriteKey(out, "run", true);   jsonWriteUInt(out, r->run);
+  jsonWriteKey(out, "mode");        jsonWriteString(out, r->mode);
+  jsonWriteKey(out, "start");       jsonWriteUInt(out, r->startTs);
+  jsonWriteKey(out, "end");         jsonWriteUInt(out, r->endTs);
+  jsonWriteKey(out, "duration");    jsonWriteUInt(out, rowDuration(*r));
+  jsonWriteKey(out, "liters");      jsonWriteFloat(out, r->liters);
+  jsonWriteKey(out, "reason");      jsonWriteString(out, r->reason);
+
+  c.sub = 1;
+  return true;
+}
+
+/* ============================================================
+   TABLE CSV (RFC 4180, Zeiten als lokale Zeit "YYYY-MM-DD HH:MM:SS")
+   ============================================================ */
+
+static void csvWriteTime(Print& out, uint32_t ts)
+{
+  if(!ts) return;
+
+  time_t t = ts;
+  struct tm tm;
+  localtime_r(&t, &tm);
+
+  char buf[20];
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  out.write((const uint8_t*)buf, n);
+}
+
+/* NaN -> leeres Feld */
+static void csvWriteNum(Print& out, float v, uint8_t decimals)
+{
+  out.write(',');
+  if(!isfinite(v)) return;
+
+  char num[20];
+  snprintf(num, sizeof(num), "%.*f", decimals, v);
+  out.print(num);
+}
+
+static void csvWriteString(Print& out, const char* s)
+{
+  out.write('"');
+  for(; *s; s++) {
+    if(*s == '"') out.write('"');
+    out.write((uint8_t)*s);
+  }
+  out.write('"');
+}
+
+bool historyTableCsvNext(const HistoryTableQuery& q, HistoryTableCursor& c, Print& out)
+{
+  static const char header[] =
+    "run,mode,start,end,duration_s,liters,reason,"
+    "tds_min,tds_mean,tds_max,tds_sd,flow_peak,flow_avg,liters_in,ratio,"
+    "prepare_s,autoflush_s,production_s,postflush_s,"
+    "prepare_in_l,autoflush_in_l,production_in_l,postflush_in_l\r\n";
+
+  /* Kopfzeile als eigenes Fragment (sub = 2: Kopf geschrieben) */
+  if(c.run == 0 && c.sub == 0) {
+    out.write((const uint8_t*)header, sizeof(header) - 1);
+    c.sub = 2;
+    return true;
+  }
+
+  /* zweiter Teil der Zeile: Laufstatistik */
+  if(c.sub == 1) {
+    c.sub = 0;
+    const RunStats& st = c.row.st;
+
+    csvWriteNum(out, st.tdsMin, 1);
+    csvWriteNum(out, st.tdsMean, 1);
+    csvWriteNum(out, st.tdsMax, 1);
+    csvWriteNum(out, st.tdsSd, 2);
+    csvWriteNum(out, st.flowPeak, 3);
+    csvWriteNum(out, st.flowAvg, 3);
+    csvWriteNum(out, st.litersIn, 2);
+    csvWriteNum(out, st.litersIn > 0 ? st.litersOut / st.litersIn : NAN, 3);
+    for(uint8_t p = 0; p < HIST_PHASES; p++) csvWriteNum(out, st.phaseSec[p], 0);
+    for(uint8_t p = 0; p < HIST_PHASES; p++) csvWriteNum(out, st.phaseInL[p], 2);
+
+    out.write((const uint8_t*)"\r\n", 2);
+    return true;
+  }
+
+  if(!nextTableRow(q, c)) return false;
+  const Row* r = &c.row;
+
+  char num[16];
+
+  jsonWriteUInt(out, r->run);                  out.write(',');
+  csvWriteString(out, r->mode);                out.write(',');
+  csvWriteTime(out, r->startTs);               out.write(',');
+  csvWriteTime(out, r->endTs);                 out.write(',');
+  jsonWriteUInt(out, rowDuration(*r));         out.write(',');
+  snprintf(num, sizeof(num), "%.2f", r->liters);
+  out.print(num);                              out.write(',');
+  csvWriteString(out, r->reason);
+
+  c.sub = 1;
+  return true;
+}
+
+void historyClearProduction()
+{
+  traceEnd();
+  tracePruneFiles(false);
+  clearRows();
+  compactTable();          // leerer Snapshot, nextRun bleibt erhalten
 
   if(updateCb) updateCb();
 }
@@ -12,20 +12,115 @@ void historySetUpdateCallback(HistoryUpdateCallback cb);
 /* ============================================================ */
 
 void historyInit();
+void historyLoop();        // aus loop(): Kompaktierung des Tabellen-Journals
 
 enum HistorySeries{
   HIST_2S,
   HIST_30S,
   HIST_600S,
   HIST_3600S,
-  HIST_21600S
+  HIST_21600S,
+  HIST_SERIES_COUNT
 };
 
+/* wird bei jedem abgeschlossenen Bucket (jede Stufe) gerufen */
+typedef void (*HistoryBucketCallback)(HistorySeries series);
+void historySetBucketCallback(HistoryBucketCallback cb);
+
+uint32_t    historyBootId();
+const char* historySeriesName(HistorySeries series);
+bool        historySeriesByName(const char* name, HistorySeries& series);
+
+/* Zustands-Codes für historyAddSample2s (= State in main.cpp);
+   PREPARE..POSTFLUSH sind die Phasen eines Laufs */
+enum HistoryState : uint8_t {
+  HST_IDLE = 0,
+  HST_PREPARE,
+  HST_AUTOFLUSH,
+  HST_PRODUCTION,
+  HST_POSTFLUSH
+};
+
+#define HIST_PHASES 4          // HST_PREPARE .. HST_POSTFLUSH
+
+/* alle 2 s aus dem Scheduler (TASK_HISTORY_MS) */
 void historyAddSample2s(float tds,
                         float produced,
                         float flowOutLpm,
-                        float flowInLpm);
-String historyGetSeriesJson(HistorySeries series);
+                        float flowInLpm,
+                        uint8_t state);
+
+/* Trace-Datei eines Laufs (siehe history.cpp); false = keine vorhanden.
+   Beim offenen Lauf fehlen bis zu 2 s lang die gepufferten Records. */
+bool historyTracePath(uint32_t run, char* out, size_t n);
+/* Cursor für gestreamte JSON-Ausgabe (frisch angelegt = Anfang) */
+struct HistoryJsonCursor{
+  uint16_t stage = 0;
+  uint16_t pos   = 0;
+  uint16_t head  = 0;
+  uint8_t  sub   = 0;     // Teilfragment innerhalb eines Eintrags
+};
+
+/* ============================================================
+   SERIES SELECTION
+   Momentaufnahme für die Ausgabe: historySelect* decodiert den
+   gewählten Bereich einmal unter der Sperre der History und legt
+   Zeitstempel und Spaltenwerte der Ausgabepunkte in sel ab; die
+   Ausgabe (JSON/Binär) liest danach nur noch sel (~14 KB, im
+   Heap des Requests).
+   historySelect: eine Stufe; mit since > 0 nur Buckets mit
+   neuerer Sequenznummer.
+   historySelectRange: Zeitbereich [from, to] (Epoch s), je
+   Teilbereich die feinste Stufe mit Daten, ohne Überlappung.
+   Mit maxPoints wird per LTTB auf weniger Punkte reduziert.
+   ============================================================ */
+
+#define HIST_MAX_POINTS  256     // mehr Buckets -> LTTB
+#define HIST_MAX_COLS    13      // Mittel je Kanal + Min/Max/Letzter je Statistik-Kanal
+
+struct HistorySelection{
+  HistorySeries series;                // Stufe bzw. feinste Stufe im Bereich
+  uint32_t seq;                        // Seq des neuesten Buckets dieser Stufe
+  uint8_t  columns;
+  uint8_t  col[HIST_MAX_COLS];         // (Kanal << 2) | Statistik
+  uint16_t count;                      // Ausgabepunkte, ältester zuerst
+  uint32_t t[HIST_MAX_POINTS];         // Abschlusszeit je Punkt
+  float    v[HIST_MAX_COLS][HIST_MAX_POINTS];
+};
+
+void historySelect(HistorySeries series, bool stats, uint16_t maxPoints,
+                   uint32_t since, HistorySelection& sel);
+
+bool historySelectRange(uint32_t from, uint32_t to, bool stats, uint16_t maxPoints,
+                        HistorySelection& sel);
+
+/* neuester Bucket als WS-Nachricht {"hist":{...}} */
+void historyWriteLastBucketJson(HistorySeries series, Print& out);
+
+/* schreibt das nächste Fragment nach out; false = letztes Fragment */
+bool historySeriesJsonNext(const HistorySelection& sel, HistoryJsonCursor& c, Print& out);
+
+/* Binärer Spaltenframe für /api/history/series.bin */
+enum HistoryBinEncoding{
+  HIST_BIN_F32  = 0,     // float32 je Wert
+  HIST_BIN_DI16 = 1      // int16 delta-codiert + Skala je Spalte
+};
+
+/* Cursor für den gestreamten Binärframe (frisch angelegt = Anfang) */
+struct HistoryBinCursor{
+  uint8_t  stage = 0;
+  uint8_t  col   = 0;
+  uint16_t pos   = 0;
+  float    scale = 0;     // DI16: Skala der laufenden Spalte
+  int32_t  prev  = 0;     // DI16: letzter Wert der Spalte
+};
+
+size_t historySeriesBinSize(const HistorySelection& sel, HistoryBinEncoding enc);
+
+/* schreibt das nächste Fragment (<= STREAM_FRAG_MAX) nach out;
+   false = letztes Fragment */
+bool historySeriesBinNext(const HistorySelection& sel, HistoryBinEncoding enc,
+                          HistoryBinCursor& c, Print& out);
 
 
 
@@ -33,5 +128,62 @@ void historyStartProduction(const char* mode);
 void historyEndProduction(const char* reason, float finalLiters);
 void historyClearProduction();
 
-String historyGetTableJson();
+/* ============================================================
+   TABLE QUERY
+   Filter (leer/0 = egal) + Seite, neueste Zeile zuerst.
+   mode/reason: exakt, ohne Groß-/Kleinschreibung;
+   from/to: Startzeit des Laufs (Epoch s, inklusive).
+   ============================================================ */
+
+struct HistoryTableQuery{
+  uint16_t offset = 0;
+  uint16_t limit  = 0xFFFF;
+  char     mode[10]   = "";
+  char     reason[20] = "";
+  uint32_t from = 0;
+  uint32_t to   = 0;
+};
+
+/* Anzahl passender Zeilen (ohne offset/limit) */
+uint16_t historyTableCount(const HistoryTableQuery& q);
+
+/* ein Fragment pro Aufruf; false = letztes Fragment */
+/* Statistik eines Laufs (PREPARE bis POSTFLUSH) */
+struct HistoryRunStats{
+  float    tdsMin;
+  float    tdsMean;
+  float    tdsMax;
+  float    tdsSd;
+  float    flowPeak;               // Permeat in PRODUCTION, L/min
+  float    flowAvg;
+  float    litersIn;               // alle Phasen, aus Durchfluss integriert
+  float    litersOut;
+  uint16_t phaseSec[HIST_PHASES];  // Zeit je Phase
+  float    phaseInL[HIST_PHASES];  // Zulauf je Phase
+};
+
+/* Zeile der Lauftabelle (= Record im Snapshot /history.bin) */
+struct HistoryRow{
+  uint32_t run;          // fortlaufende Lauf-Nummer (nie 0)
+  uint32_t startTs;
+  uint32_t endTs;
+  float    liters;
+  char     reason[20];
+  char     mode[10];
+  HistoryRunStats st;
+};
+
+/* Cursor der Tabellen-Ausgabe (frisch angelegt = Anfang); hält
+   die Kopie der gerade ausgegebenen Zeile */
+struct HistoryTableCursor{
+  uint32_t   run   = 0;   // zuletzt geprüfter Lauf (0 = Anfang)
+  uint16_t   stage = 0;   // bisher passende Zeilen (offset)
+  uint16_t   head  = 0;   // ausgegebene Zeilen
+  uint8_t    sub   = 0;   // 1 = Statistik steht aus, 2 = CSV-Kopf geschrieben
+  HistoryRow row   = {};
+};
+
+bool historyTableJsonNext(const HistoryTableQuery& q, HistoryTableCursor& c, Print& out);
+bool historyTableCsvNext(const HistoryTableQuery& q, HistoryTableCursor& c, Print& out);
+
 uint8_t historyGetRowCount();
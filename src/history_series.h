@@ -0,0 +1,47 @@
+#pragma once
+#include <Arduino.h>
+#include "history.h"
+#include "tiered_series.h"
+
+/* ============================================================
+   SERIES CONFIG
+   Kanäle: eine Zeile je Kanal (id, JSON-Name, Aggregation,
+   Anzeigeauflösung für den int16-Binärframe und das Archiv).
+   ============================================================ */
+
+#define HIST_CHANNELS(X)                          \
+  X(CH_TDS,     "tds",    AGG_STATS, 0.1f)        \
+  X(CH_FLOW,    "flow",   AGG_STATS, 0.01f)       \
+  X(CH_FLOW_IN, "flowIn", AGG_STATS, 0.01f)       \
+  X(CH_PROD,    "prod",   AGG_LAST,  0.01f)
+
+#define CH_ID(id, name, agg, scale)    id,
+#define CH_NAME(id, name, agg, scale)  name,
+#define CH_AGG(id, name, agg, scale)   agg,
+#define CH_SCALE(id, name, agg, scale) scale,
+
+enum HistChannel : uint8_t { HIST_CHANNELS(CH_ID) CH_COUNT };
+
+struct HistChannels{
+  static constexpr uint8_t    count = CH_COUNT;
+  static constexpr ChannelAgg agg[] = { HIST_CHANNELS(CH_AGG) };
+  static constexpr float      scale[] = { HIST_CHANNELS(CH_SCALE) };
+};
+
+/* Stufen: Bucket-Sekunden, Länge, Pool (Reihenfolge = HistorySeries).
+   2 s bleibt roh (Live-Ansicht, nur das Sample je Bucket). Count ist
+   die feste Mindestlänge jeder Stufe (= die früheren Ringe); die
+   groben Stufen liegen Gorilla-komprimiert in zusammen 20 Blöcken,
+   ältere Buckets gehen von dort ins Archiv (Mittelwerte, 14 Byte).
+   Der Pool verlängert die Stufe über Count hinaus, je nach
+   Komprimierbarkeit (Sim, ein Lauf/Tag: 30 s ~3.5 Byte/Bucket bis
+   21600 s ~18 Byte/Bucket). */
+typedef TieredSeries<HistChannels,
+                     TierDef<2,     150>,          // 5 Minuten
+                     TierDef<30,    150,   768>,   // >= 75 Minuten
+                     TierDef<600,   150,  1280>,   // >= 25 Stunden
+                     TierDef<3600,  168,  1536>,   // >= 7 Tage
+                     TierDef<21600, 120,  1536>>   // >= 30 Tage
+        HistSeries;
+
+static_assert(HistSeries::TIERS == HIST_SERIES_COUNT, "tier list must match HistorySeries");
@@ -0,0 +1,132 @@
+#include "inputs.h"
+#include "hal.h"
+
+static_assert((INPUTS_QUEUE & (INPUTS_QUEUE - 1)) == 0, "INPUTS_QUEUE muss 2^n sein");
+static_assert(INPUTS_MAX <= 8, "Schnappschuss ist ein Byte");
+
+/* ============================================================
+   EVENT QUEUE (ISR schreibt, Control-Task liest)
+   ============================================================ */
+
+struct InputEvent{
+  uint32_t ms;
+  uint8_t  id;
+  bool     active;
+};
+
+static InputEvent        queue[INPUTS_QUEUE];
+static volatile uint8_t  qHead = 0, qTail = 0;
+static volatile bool     qOverflow = false;
+
+/* ============================================================
+   STATE
+   ============================================================ */
+
+struct InputState{
+  uint8_t  pin;
+  uint16_t debounceMs;
+  bool     raw;              // letzter gesehener Pegel (aktiv)
+  uint32_t rawSince;         // Zeit der letzten Flanke
+};
+
+static InputState in[INPUTS_MAX];
+static uint8_t    inCount = 0;
+
+static uint8_t  active = 0, rose = 0;   // Schnappschuss
+static uint32_t lastResync = 0;
+
+static InputEdgeHook edgeHook = nullptr;
+
+static void IRAM_ATTR onEdge(void* arg)
+{
+  uint8_t  id    = (uint8_t)(uintptr_t)arg;
+  uint32_t ms    = halMillis();
+  bool     level = !halPinRead(in[id].pin);
+
+  if(edgeHook) edgeHook(id, level, ms);
+
+  uint8_t next = (qHead + 1) & (INPUTS_QUEUE - 1);
+  if(next == qTail) {
+    qOverflow = true;
+    return;
+  }
+
+  queue[qHead] = { ms, id, level };
+  qHead = next;
+}
+
+/* ============================================================
+   INIT
+   ============================================================ */
+
+void inputsInit(const InputDef* defs, uint8_t n)
+{
+  inCount = min(n, (uint8_t)INPUTS_MAX);
+  active = rose = 0;
+  uint32_t now = halMillis();
+
+  for(uint8_t i = 0; i < inCount; i++) {
+    InputState& s = in[i];
+    s.pin        = defs[i].pin;
+    s.debounceMs = defs[i].debounceMs;
+
+    halPinInput(s.pin);
+    s.raw      = !halPinRead(s.pin);
+    s.rawSince = now;
+    if(s.raw) active |= 1 << i;          // Startzustand ohne Entprellung
+
+    halPinIrq(s.pin, onEdge, (void*)(uintptr_t)i);
+  }
+
+  lastResync = now;
+}
+
+/* ============================================================
+   POLL
+   ============================================================ */
+
+static void applyLevel(uint8_t id, bool level, uint32_t ms)
+{
+  InputState& s = in[id];
+  if(level == s.raw) return;             // Flanke ohne Pegelwechsel (Prellen)
+  s.raw      = level;
+  s.rawSince = ms;
+}
+
+void inputsPoll(uint32_t now)
+{
+  while(qTail != qHead) {
+    const InputEvent& e = queue[qTail];
+    applyLevel(e.id, e.active, e.ms);
+    qTail = (qTail + 1) & (INPUTS_QUEUE - 1);
+  }
+
+  if(qOverflow || now - lastResync >= INPUTS_RESYNC_MS) {
+    qOverflow  = false;
+    lastResync = now;
+    for(uint8_t i = 0; i < inCount; i++)
+      applyLevel(i, !halPinRead(in[i].pin), now);
+  }
+
+  uint8_t prev = active;
+  for(uint8_t i = 0; i < inCount; i++) {
+    const InputState& s = in[i];
+    if(now - s.rawSince < s.debounceMs) continue;
+    if(s.raw) active |=  (1 << i);
+    else      active &= ~(1 << i);
+  }
+
+  rose = active & ~prev;
+}
+
+void inputsSetEdgeHook(InputEdgeHook fn)
+{
+  edgeHook = fn;
+}
+
+/* ============================================================
+   ABFRAGE
+   ============================================================ */
+
+bool inputActive(uint8_t id) { return active & (1 << id); }
+bool inputRose(uint8_t id)   { return rose & (1 << id); }
@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   INPUTS
+   Digitale Eingänge (aktiv LOW, Pull-up) über Flanken-Interrupts:
+   die ISR legt {Zeit, Eingang, Pegel} in eine Event-Queue, der
+   Control-Task übernimmt sie einmal pro Tick (inputsPoll) und
+   entprellt je Eingang: ein Pegel gilt erst, wenn er debounceMs
+   lang ohne weitere Flanke anliegt.
+
+   Alle Abfragen danach lesen denselben Schnappschuss -> innerhalb
+   eines Ticks konsistent, kein digitalRead je Aufrufstelle.
+   Gegen verlorene Flanken (Queue voll, Prellen schneller als die
+   ISR) werden die Pins alle INPUTS_RESYNC_MS einmal nachgelesen.
+   ============================================================ */
+
+#define INPUTS_MAX        8
+#define INPUTS_QUEUE      32        // Events (2^n)
+#define INPUTS_RESYNC_MS  1000
+
+struct InputDef{
+  uint8_t  pin;
+  uint16_t debounceMs;
+};
+
+/* Pins konfigurieren, Interrupts an; Index in defs = Eingangs-ID */
+void inputsInit(const InputDef* defs, uint8_t n);
+
+/* Events übernehmen + entprellen -> neuer Schnappschuss (je Tick);
+   now = millis() des Ticks, dieselbe Zeit wie CtlInputs.now */
+void inputsPoll(uint32_t now);
+
+/* optional: jede Flanke so, wie die ISR sie sieht, auch bei voller
+   Queue (recorder.cpp); läuft im Interrupt */
+typedef void (*InputEdgeHook)(uint8_t id, bool active, uint32_t ms);
+void inputsSetEdgeHook(InputEdgeHook fn);
+
+/* aus dem aktuellen Schnappschuss */
+bool inputActive(uint8_t id);
+bool inputRose(uint8_t id);          // seit dem vorigen Poll aktiv geworden
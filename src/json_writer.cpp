@@ -0,0 +1,92 @@
+#include "json_writer.h"
+
+/* Bytes eines Zeichens im JSON-String */
+static uint8_t escapedLen(char c)
+{
+  if(c == '"' || c == '\\') return 2;
+  if((uint8_t)c < 0x20)      return 6;
+  return 1;
+}
+
+static void writeEscaped(Print& out, char c)
+{
+  if(c == '"' || c == '\\') {
+    out.write('\\');
+    out.write(c);
+  } else if((uint8_t)c < 0x20) {
+    char buf[8];
+    snprintf(buf, sizeof(buf), "\\u%04x", (uint8_t)c);
+    out.write((const uint8_t*)buf, 6);
+  } else {
+    out.write(c);
+  }
+}
+
+void jsonWriteString(Print& out, const char* s)
+{
+  out.write('"');
+  for(; s && *s; s++) writeEscaped(out, *s);
+  out.write('"');
+}
+
+bool jsonWriteStringPart(Print& out, const char* s, uint16_t& from, size_t max)
+{
+  size_t n = 0;
+  if(from == 0) {
+    out.write('"');
+    n++;
+  }
+
+  const char* p = s ? s + (from ? from - 1 : 0) : "";
+  for(; *p; p++) {
+    uint8_t k = escapedLen(*p);
+    if(n + k + 1 > max) {             // Platz für das schließende "
+      from = p - s + 1;
+      return false;
+    }
+    writeEscaped(out, *p);
+    n += k;
+  }
+
+  out.write('"');
+  return true;
+}
+
+void jsonWriteFloat(Print& out, float v, uint8_t sigDigits)
+{
+  if(!isfinite(v)) {
+    out.write((const uint8_t*)"null", 4);
+    return;
+  }
+
+  char buf[24];
+  int n = snprintf(buf, sizeof(buf), "%.*g", sigDigits, v);
+  out.write((const uint8_t*)buf, n);
+}
+
+void jsonWriteUInt(Print& out, uint32_t v)
+{
+  char buf[12];
+  int n = snprintf(buf, sizeof(buf), "%lu", (unsigned long)v);
+  out.write((const uint8_t*)buf, n);
+}
+
+void jsonWriteInt(Print& out, int32_t v)
+{
+  char buf[12];
+  int n = snprintf(buf, sizeof(buf), "%ld", (long)v);
+  out.write((const uint8_t*)buf, n);
+}
+
+void jsonWriteBool(Print& out, bool v)
+{
+  if(v) out.write((const uint8_t*)"true", 4);
+  else  out.write((const uint8_t*)"false", 5);
+}
+
+void jsonWriteKey(Print& out, const char* key, bool first)
+{
+  if(!first) out.write(',');
+  jsonWriteString(out, key);
+  out.write(':');
+}
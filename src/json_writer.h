@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   MINI JSON WRITER
+   Schreibt JSON-Fragmente direkt in einen Print (kein Dokument,
+   kein String). Basis für die gestreamten API-Antworten.
+   ============================================================ */
+
+void jsonWriteString(Print& out, const char* s);
+
+/* String in Teilen, höchstens max Bytes je Aufruf (inkl.
+   Anführungszeichen), kein Escape wird zerteilt. from = 0: Anfang
+   (öffnendes "), sonst 1 + nächstes Zeichen. true = fertig
+   (schließendes " geschrieben), sonst weiter mit from. */
+bool jsonWriteStringPart(Print& out, const char* s, uint16_t& from, size_t max);
+void jsonWriteFloat(Print& out, float v, uint8_t sigDigits = 7);
+void jsonWriteUInt(Print& out, uint32_t v);
+void jsonWriteInt(Print& out, int32_t v);
+void jsonWriteBool(Print& out, bool v);
+
+/* "key": (inkl. führendem Komma wenn !first) */
+void jsonWriteKey(Print& out, const char* key, bool first = false);
+
+/* ============================================================
+   FRAGMENTPUFFER
+   Gestreamte Antworten: ein Producer schreibt pro Aufruf höchstens
+   STREAM_FRAG_MAX Bytes. Was darüber hinausgeht, wird nicht
+   geschrieben und setzt overflow (Fehler des Producers, nicht
+   stillschweigend abschneiden).
+   ============================================================ */
+
+#define STREAM_FRAG_MAX 256
+
+template<size_t N>
+struct FixedPrint : public Print
+{
+  uint8_t buf[N];
+  size_t  len = 0;
+  size_t  pos = 0;
+  bool    overflow = false;
+
+  void reset() { len = pos = 0; overflow = false; }
+
+  size_t write(uint8_t b) override {
+    if(len >= sizeof(buf)) {
+      overflow = true;
+      return 0;
+    }
+    buf[len++] = b;
+    return 1;
+  }
+
+  size_t write(const uint8_t *b, size_t n) override {
+    size_t k = min(n, sizeof(buf) - len);
+    if(k < n) overflow = true;
+    memcpy(buf + len, b, k);
+    len += k;
+    return k;
+  }
+};
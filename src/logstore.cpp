@@ -0,0 +1,207 @@
+#include "logstore.h"
+#include "hal.h"
+
+#define LOG_SEG_MAGIC 0x314C534FUL   // "OSL1"
+#define LOG_REC_MAGIC 0xA5
+
+/* ============================================================
+   CRC32 (IEEE, bitweise – Records sind klein)
+   ============================================================ */
+
+uint32_t logCrc32(uint32_t crc, const uint8_t* data, size_t len)
+{
+  crc = ~crc;
+  while(len--) {
+    crc ^= *data++;
+    for(uint8_t k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static void putLe32(uint8_t* p, uint32_t v)
+{
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t getLe32(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ============================================================ */
+
+LogStore::LogStore(const char* b, uint8_t segments, uint32_t segmentBytes, uint16_t fmt)
+  : segCount(constrain(segments, 2, LOG_MAX_SEGMENTS)),
+    segBytes(segmentBytes),
+    format(fmt)
+{
+  strncpy(base, b, sizeof(base) - 1);
+  base[sizeof(base) - 1] = 0;
+}
+
+void LogStore::segPath(uint8_t seg, char* out, size_t n) const
+{
+  snprintf(out, n, "%s.%u", base, seg);
+}
+
+/* ============================================================
+   REPLAY
+   ============================================================ */
+
+uint32_t LogStore::replay(LogReplayFn fn, void* ctx)
+{
+  uint32_t gens[LOG_MAX_SEGMENTS] = {};
+  char path[24];
+
+  /* --- Segment-Header lesen --- */
+  for(uint8_t s = 0; s < segCount; s++) {
+    segPath(s, path, sizeof(path));
+    if(!halFs().exists(path)) continue;
+
+    File f = halFs().open(path, "r");
+    if(!f) continue;
+
+    uint8_t h[LOG_SEG_HDR];
+    if(f.read(h, sizeof(h)) == sizeof(h) &&
+       getLe32(h) == LOG_SEG_MAGIC &&
+       (uint16_t)(h[4] | (h[5] << 8)) == format)
+      gens[s] = getLe32(h + 8);
+
+    f.close();
+  }
+
+  uint32_t total = 0;
+  uint32_t prevGen = 0;
+  needRotate = true;
+
+  /* --- Segmente in gen-Reihenfolge abspielen --- */
+  for(;;) {
+    int8_t seg = -1;
+    for(uint8_t s = 0; s < segCount; s++)
+      if(gens[s] > prevGen && (seg < 0 || gens[s] < gens[seg]))
+        seg = s;
+    if(seg < 0) break;
+    prevGen = gens[seg];
+
+    segPath(seg, path, sizeof(path));
+    File f = halFs().open(path, "r");
+    if(!f) continue;
+
+    size_t fileSize = f.size();
+    uint32_t pos = LOG_SEG_HDR;
+    f.seek(pos);
+
+    uint8_t rec[12 + LOG_MAX_PAYLOAD];
+
+    for(;;) {
+      if(f.read(rec, 8) != 8) break;
+      if(rec[0] != LOG_REC_MAGIC) break;
+
+      uint8_t len = rec[2];
+      if(len > LOG_MAX_PAYLOAD) break;
+      if(f.read(rec + 8, len + 4) != (size_t)len + 4) break;
+
+      uint32_t crc = logCrc32(0, rec + 1, 7 + len);
+      if(crc != getLe32(rec + 8 + len)) break;
+
+      uint32_t seq = getLe32(rec + 4);
+      nextSeq = seq + 1;
+      pos += recordBytes(len);
+      total++;
+
+      if(fn) fn(rec[1], seq, rec + 8, len, ctx);
+    }
+
+    f.close();
+
+    active     = seg;
+    activeSize = pos;
+    lastGen    = gens[seg];
+    needRotate = (pos != fileSize);   // kaputtes Ende -> frisch weiter
+  }
+
+  return total;
+}
+
+/* ============================================================
+   APPEND
+   ============================================================ */
+
+bool LogStore::startSegment(uint8_t seg)
+{
+  char path[24];
+  segPath(seg, path, sizeof(path));
+
+  File f = halFs().open(path, "w");
+  if(!f) return false;
+
+  uint8_t h[LOG_SEG_HDR] = {};
+  putLe32(h, LOG_SEG_MAGIC);
+  h[4] = format;
+  h[5] = format >> 8;
+  putLe32(h + 8, lastGen + 1);
+
+  bool ok = f.write(h, sizeof(h)) == sizeof(h);
+  f.close();
+  if(!ok) return false;
+
+  lastGen++;
+  active     = seg;
+  activeSize = LOG_SEG_HDR;
+  needRotate = false;
+  return true;
+}
+
+bool LogStore::append(uint8_t type, const void* data, uint8_t len)
+{
+  if(len > LOG_MAX_PAYLOAD) return false;
+
+  uint32_t n = recordBytes(len);
+
+  if(needRotate || activeSize + n > segBytes) {
+    uint8_t next = lastGen ? (active + 1) % segCount : 0;
+    if(!startSegment(next)) return false;
+  }
+
+  uint8_t rec[12 + LOG_MAX_PAYLOAD];
+  rec[0] = LOG_REC_MAGIC;
+  rec[1] = type;
+  rec[2] = len;
+  rec[3] = 0;
+  putLe32(rec + 4, nextSeq);
+  memcpy(rec + 8, data, len);
+  putLe32(rec + 8 + len, logCrc32(0, rec + 1, 7 + len));
+
+  char path[24];
+  segPath(active, path, sizeof(path));
+
+  File f = halFs().open(path, "a");
+  if(!f) return false;
+  size_t w = f.write(rec, n);
+  f.close();
+
+  if(w != n) {
+    needRotate = true;      // halber Record -> nicht dahinter weiterschreiben
+    return false;
+  }
+
+  activeSize += n;
+  nextSeq++;
+  return true;
+}
+
+void LogStore::clear()
+{
+  char path[24];
+  for(uint8_t s = 0; s < segCount; s++) {
+    segPath(s, path, sizeof(path));
+    if(halFs().exists(path)) halFs().remove(path);
+  }
+
+  active = 0;
+  activeSize = 0;
+  lastGen = 0;
+  nextSeq = 0;
+  needRotate = true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   LOG STORE
+   Append-only Ringspeicher aus mehreren Segment-Dateien auf SPIFFS.
+
+   Segment  = <base>.<n>, Header { u32 magic, u16 format, u16 rsv, u32 gen }
+   Record   = { u8 magic, u8 type, u8 len, u8 rsv, u32 seq,
+                payload[len], u32 crc32 }
+
+   - Records werden nur angehängt, nie überschrieben.
+   - Ist das aktive Segment voll, wird das älteste Segment neu
+     begonnen (höhere gen) -> Schreiblast rotiert über alle Segmente.
+   - Beim Replay endet ein Segment am ersten kaputten Record
+     (CRC / Länge), danach wird auf ein frisches Segment gewechselt.
+   - Segmente mit anderem format werden ignoriert und überschrieben.
+   ============================================================ */
+
+#define LOG_MAX_SEGMENTS 8
+#define LOG_MAX_PAYLOAD  240
+#define LOG_SEG_HDR      12
+
+typedef void (*LogReplayFn)(uint8_t type, uint32_t seq,
+                            const uint8_t* data, uint8_t len, void* ctx);
+
+class LogStore
+{
+public:
+  LogStore(const char* base, uint8_t segments, uint32_t segmentBytes, uint16_t format);
+
+  /* Alle gültigen Records, ältester zuerst. Muss vor append() laufen. */
+  uint32_t replay(LogReplayFn fn, void* ctx);
+
+  bool append(uint8_t type, const void* data, uint8_t len);
+
+  void clear();
+
+  static constexpr uint32_t recordBytes(uint8_t len) { return 12 + len; }
+
+  static constexpr uint32_t segmentBytesFor(uint32_t records, uint8_t len)
+  {
+    return LOG_SEG_HDR + records * recordBytes(len);
+  }
+
+  static constexpr uint32_t recordsPerSegment(uint32_t segmentBytes, uint8_t len)
+  {
+    return (segmentBytes - LOG_SEG_HDR) / recordBytes(len);
+  }
+
+private:
+  void segPath(uint8_t seg, char* out, size_t n) const;
+  bool startSegment(uint8_t seg);
+
+  char     base[16];
+  uint8_t  segCount;
+  uint32_t segBytes;
+  uint16_t format;
+
+  uint8_t  active     = 0;
+  uint32_t activeSize = 0;
+  uint32_t lastGen    = 0;
+  uint32_t nextSeq    = 0;
+  bool     needRotate = true;     // solange kein gültiges Segment offen ist
+};
+
+uint32_t logCrc32(uint32_t crc, const uint8_t* data, size_t len);
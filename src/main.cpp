@@ -9,10 +9,8 @@
 #include <Wire.h>
 #include <WiFi.h>
 #include <ESPmDNS.h>
-#include <Adafruit_PCF8574.h>
 #include <PubSubClient.h>
 #include <time.h>
-#include <SPIFFS.h>
 #include <DNSServer.h>
 #include <Update.h>
 #include <esp_ota_ops.h>
@@ -22,15 +20,24 @@
 
 #include "web.h"
 #include "config_settings.h"
+#include "controller.h"
+#include "flow_meter.h"
+#include "hal.h"
 #include "history.h"
+#include "inputs.h"
+#include "outputs.h"
+#include "profiler.h"
+#include "recorder.h"
+#include "scheduler.h"
 #include "settings.h"
+#include "tds_adc.h"
+#include "tds_cal.h"
+#include "totals.h"
 
 
 #define PUSHOVER_TOKEN "a17cuw3ujrekv8badbjk9f59i1o663"
 #define PUSHOVER_USER  "u5if6n9see17t7c42ny8id7fqegtkv"
 
-#define TDS_AVG_SAMPLES 8
-
 
 // ================= DEBUG =================
 #if DEBUG_LEVEL>=1
@@ -74,33 +81,18 @@ const long GMT_OFFSET=3600;
 const int  DST_OFFSET=3600;
 
 String lastErrorMsg = "";
-static bool runtimeTimeoutActive = false;
-static bool autoPauseBlink = false;
-
-static uint32_t lastActuatorSwitchMs = 0;
-static bool autoStartNotified = false;
-
-uint32_t productionStartMs = 0;  
-
-static bool autoBlocked = false;   // verhindert Auto-Neustart nach Schutzlimit
-static bool productionEnded = false;
-static char lastStopReason[20] = "";
 static float currentFlowLpm = 0.0f;
-static float lastProducedLiters = 0.0f;
-static uint32_t flowLastCnt = 0;
-static uint32_t flowLastT   = 0;
-
-static uint32_t ratioStartCntIn  = 0;
-static uint32_t ratioStartCntOut = 0;
-static uint32_t ratioStartMs     = 0;
 
+// ---- Profiler-Abschnitte innerhalb der Tasks ----
+static const ProfStage profWifi      = profStage("wifi");
+static const ProfStage profMqttConn  = profStage("mqttReconnect");
+static const ProfStage profMqttLoop  = profStage("mqtt.loop");
+static const ProfStage profMqttPub   = profStage("mqttPublish");
+static const ProfStage profPushover  = profStage("pushover");
+static const ProfStage profHistAdd   = profStage("historyAdd");
+static const ProfStage profHistLoop  = profStage("historyLoop");
 
 
-static float tdsBuf[TDS_AVG_SAMPLES];
-static uint8_t tdsIdx = 0;
-static uint8_t tdsCount = 0;
-static float tdsSum = 0.0f;
-
 
 
 // ================= PINMAP =================
@@ -116,106 +108,82 @@ static float tdsSum = 0.0f;
 #define PIN_I2C_SCL     7
 
 
-// ---- Flow-Sicherheitsparameter ----
-#define FLOW_CLOSED_GRACE_MS    1500   // Nachlauf nach Ventil-ZU ignorieren
-#define FLOW_CLOSED_MAX_PULSES  10     // erlaubte Impulse danach
-#define FLOW_CLOSED_WINDOW_MS   3000   // Zeitfenster für Bewertung
-
-#define AUTOFLUSH_PRODUCT_INTERVAL_MS 5000  // Pulsperiode bei Atoflush in ms
-#define AUTOFLUSH_PRODUCT_PULSE_MS     100  // Pulsdauer bei Autoflush
-
-
-static bool lastSwitchState = false;   // merken für Flanke
-uint32_t valveClosedTs = 0;
-
-static uint32_t autoflushLastPulseMs = 0;  // Helper für Autoflus-Pulses
-static bool autoflushPulseActive = false;
-
-enum State{
-  IDLE,PREPARE,AUTOFLUSH,PRODUCTION,POSTFLUSH,SERVICEFLUSH,INFO,ERROR
+// ---- Task-Raten (Scheduler) ----
+#define TASK_CONTROL_MS     10     // Eingänge, Sicherheit, StateMachine
+#define TASK_SENSE_MS       TDS_ADC_POLL_MS   // TDS-ADC abholen + filtern
+#define TASK_NET_MS         10     // DNS, MQTT-Polling
+#define TASK_LEDS_MS        20
+#define TASK_FLOW_MS       250     // Durchfluss (reziprok, flow_meter.cpp)
+#define TASK_HISTORY_MS   2000     // History-Basistakt
+#define TASK_WEB_MS        300     // WS-Broadcast
+#define TASK_LINK_MS      5000     // WiFi / MQTT Reconnect
+#define TASK_TELEMETRY_MS 10000    // MQTT Heartbeat
+#define TASK_REC_MS       REC_FLUSH_MS   // Aufzeichnung -> SPIFFS
+
+// ---- Eingänge (inputs.cpp): Index = ID, Entprellzeit je Eingang ----
+enum InputId : uint8_t { IN_SAUTO, IN_SMANU, IN_WLOW, IN_WHIGH, IN_WERROR, IN_COUNT };
+
+#define SWITCH_DEBOUNCE_MS  30
+#define FLOAT_DEBOUNCE_MS   50
+#define WERROR_DEBOUNCE_MS 100
+
+static const InputDef inputDefs[IN_COUNT] = {
+  { PIN_SAUTO,  SWITCH_DEBOUNCE_MS },
+  { PIN_SMANU,  SWITCH_DEBOUNCE_MS },
+  { PIN_WLOW,   FLOAT_DEBOUNCE_MS  },
+  { PIN_WHIGH,  FLOAT_DEBOUNCE_MS  },
+  { PIN_WERROR, WERROR_DEBOUNCE_MS },
 };
+
+// history.cpp wertet die Lauf-Phasen über diese Codes aus
+static_assert((int)IDLE == HST_IDLE && (int)PREPARE == HST_PREPARE &&
+              (int)AUTOFLUSH == HST_AUTOFLUSH && (int)PRODUCTION == HST_PRODUCTION &&
+              (int)POSTFLUSH == HST_POSTFLUSH,
+              "State must match HistoryState");
 // ============================================================
-// StateMachine (ORIGINAL + hooks ADD)
+// StateMachine (controller.cpp)
 // ============================================================
-const char* sName[]={
-  "IDLE","PREPARE","AUTOFLUSH","PRODUCTION","POSTFLUSH","SERVICEFLUSH","INFO","ERROR"
-};
-
-State state=IDLE,lastState=IDLE;
-uint32_t stateStart=0;
-uint32_t prodStartCnt=0;
+static Controller ctl;
+static State lastState = IDLE;     // MQTT bei Statewechsel
 
 static float currentFlowInLpm = 0.0f;
-static uint32_t flowInLastCnt = 0;
-static uint32_t flowInLastT   = 0;
 
 // ============================================================
 // Flow Counter (ORIGINAL)
 // ============================================================
 volatile uint32_t cntIn=0,cntOut=0;
-void IRAM_ATTR isrIn(){cntIn++;}
-void IRAM_ATTR isrOut(){cntOut++;}
-
-uint32_t lastServiceFlushMs = 0;
+void IRAM_ATTR isrIn(){                 // Glitches zählen nicht
+  uint32_t t=micros();
+  if(flowPulse(FLOW_IN,t))  cntIn++;
+  recPulse(FLOW_IN,t);
+}
+void IRAM_ATTR isrOut(){
+  uint32_t t=micros();
+  if(flowPulse(FLOW_OUT,t)) cntOut++;
+  recPulse(FLOW_OUT,t);
+}
 
 
 
 // ============================================================
 // Helpers
 // ============================================================
-bool inActive(uint8_t p){ return digitalRead(p)==LOW; }
 
 
-float liters(uint32_t p){
-  return p / settings.pulsesPerLiterOut;
-}
-
-float litersIn(uint32_t p){
-  return p / settings.pulsesPerLiterIn;
-}
-
 float producedLitersSafe()
 {
-  int32_t diff = (int32_t)cntOut - (int32_t)prodStartCnt;
-  if(diff < 0) diff = 0;
-  return liters(diff);
+  return ctlProducedLiters(ctl, cntOut);
 }
 
 
 
-float rawToTds(int raw)
-{
-  // Rohwert → Spannung
-  float v = raw * 3.3f / 4095.0f;
-
-  // Spannung → TDS 
-  float tds =
-    (133.42f*v*v*v - 255.86f*v*v + 857.39f*v) * 0.5f;
-
-  // --- Gleitender Mittelwert ---
-  if(tdsCount < TDS_AVG_SAMPLES) {
-    tdsBuf[tdsIdx] = tds;
-    tdsSum += tds;
-    tdsCount++;
-  } else {
-    tdsSum -= tdsBuf[tdsIdx];
-    tdsBuf[tdsIdx] = tds;
-    tdsSum += tds;
-  }
-
-  tdsIdx = (tdsIdx + 1) % TDS_AVG_SAMPLES;
-
-  return tdsSum / tdsCount;
-}
-
-
 // ============================================================
 // Mode Helper (ADD)
 // ============================================================
 const char* currentModeStr()
 {
-  bool autoMode   = inActive(PIN_SAUTO);
-  bool manualMode = inActive(PIN_SMANU);
+  bool autoMode   = inputActive(IN_SAUTO);
+  bool manualMode = inputActive(IN_SMANU);
 
   if(manualMode) return "MANUAL";
   if(autoMode)   return "AUTO";
@@ -226,8 +194,6 @@ const char* currentModeStr()
 // ============================================================
 // PCF8574 (ORIGINAL + ADD state mirror)
 // ============================================================
-Adafruit_PCF8574 pcf;
-
 enum{
   WIn=0,OOut,OtoS,Relay,
   LedWLAN,LedSpuelen,LedBezug,LedError
@@ -235,21 +201,23 @@ enum{
 
 const bool pinInvert[8]={true,true,true,true,true,true,true,true};
 
-bool wInOn=false;
+// Controller-Aktoren = Kanäle 0..3
+static_assert((int)ACT_WIN == WIn && (int)ACT_OOUT == OOut && (int)ACT_OTOS == OtoS && (int)ACT_RELAY == Relay,
+              "CtlActuator must match PCF channels");
 
+// nur Schattenbyte (outputs.cpp), geschrieben wird in loop()
 void setOut(uint8_t p,bool on){
-   if(p <= Relay) lastActuatorSwitchMs = millis();
-   if(p==WIn){
-    if(wInOn && !on)              // gerade geschlossen
-      valveClosedTs = millis();   // Zeit merken
-    wInOn = on;
-  }
-  pcf.digitalWrite(p,pinInvert[p]? !on:on);
+  outSet(p,on);
 }
 
-void allOff(){
-  // DBG_INFO("[OUT] ALL OFF\n");
-  for(int i=0;i<8;i++) setOut(i,false);
+void setActuators(uint8_t act){
+  outSetMask(ACT(WIn)|ACT(OOut)|ACT(OtoS)|ACT(Relay), act);
+}
+
+uint8_t pinInvertMask(){
+  uint8_t m=0;
+  for(uint8_t i=0;i<8;i++) if(pinInvert[i]) m |= 1<<i;
+  return m;
 }
 
 
@@ -295,16 +263,11 @@ void mqttReconnect(float tds){
   if(!wifiConnected) return;
   if(mqtt.connected()) return;
 
-  static uint32_t lastTry = 0;
-
-  if(millis() - lastTry < 5000) return;   // only every 5s
-  lastTry = millis();
-
   DBG_INFO("[MQTT] try connect...");
 
   if(mqtt.connect("osmose")){
     DBG_INFO("[MQTT] connected");
-    mqttPublish(sName[state], tds, producedLitersSafe(), 0, 0);
+    mqttPublish(ctlStateName(ctl.state), tds, producedLitersSafe(), 0, 0);
   }else{
     DBG_ERR("[MQTT] failed rc=%d", mqtt.state());
   }
@@ -313,6 +276,8 @@ void mqttReconnect(float tds){
 
 void sendPushover(String msg)
 {
+  PROF_SCOPE(profPushover);
+
   if(!wifiConnected) {
     // lastErrorMsg = "PUSH: no wifi";
     return;
@@ -434,128 +399,49 @@ void updateLEDs(State s){
 
   if(s==ERROR)
     setOut(LedError,true);
-  else if(s==INFO || autoPauseBlink)   
+  else if(s==INFO || ctl.autoPauseBlink)   
     setOut(LedError,blinkInfo());
   else
     setOut(LedError,false);
 
 }
 
-void finalizeProductionIfRunning(const char* reason)
+// Ausgänge/Effekte eines Controller-Ticks ausführen
+void applyControl(const CtlOutputs& o)
 {
-  if(state == PRODUCTION && !productionEnded) {
-    lastProducedLiters = producedLitersSafe();
-    productionEnded = true;
-    strncpy(lastStopReason, reason, sizeof(lastStopReason)-1);
-    lastStopReason[sizeof(lastStopReason)-1] = 0;
-  }
-}
+  if(o.actChanged)
+    setActuators(o.act);
 
-
-void setState(State s)
-{
-  if(state == s) return;
-
-  DBG_INFO("[%s] [STATE] %s -> %s\n", currentModeStr(), sName[state], sName[s]);
-  
-  //  Flow-Messung sauber zurücksetzen
-  flowLastCnt = cntOut;
-  flowLastT   = millis();
-  currentFlowLpm = 0.0f;
-
-  
-  if(s == PRODUCTION) {
-    runtimeTimeoutActive = false;
-    ratioStartCntIn  = cntIn;
-    ratioStartCntOut = cntOut;
-    ratioStartMs     = millis();
+  if(ctl.state != o.from) {
+    DBG_INFO("[%s] [STATE] %s -> %s\n", currentModeStr(), ctlStateName(o.from), ctlStateName(ctl.state));
+    currentFlowLpm = 0.0f;
+    recState(ctl.state, o.act);
   }
 
-  /* Nutzung setzt Service-Timer zurück */
-  if(s == PRODUCTION || s == PREPARE)
-    lastServiceFlushMs = millis();
-
-  /* ========= START Produktion ========= */
-  if((state == AUTOFLUSH || state == PREPARE) && s == PRODUCTION) {
-    prodStartCnt = cntOut;
-    productionStartMs = millis();
+  if(o.fx & CTL_FX_HISTORY_START)
     historyStartProduction(currentModeStr());
-  }
-
-  /* ========= ENDE Produktion ========= */
-  if (state == PRODUCTION && s != PRODUCTION && !productionEnded) {
-    lastProducedLiters = producedLitersSafe();   // 🔒 FINAL einfrieren
-    productionEnded = true;
-  }
-
-  if(s == IDLE) {
-    autoStartNotified = false;
-  }
-
-  state = s;
-  stateStart = millis();
-
-  if(s != ERROR && s != INFO && s != SERVICEFLUSH)
-    lastErrorMsg = "";
-}
-
-
-void stopProduction(const char* reason)
-{
-  strcpy(lastStopReason, reason);
-
-  if(state == PRODUCTION){
-    lastProducedLiters = producedLitersSafe();  // 🔒 exakt einmal
-    productionEnded = true;
 
-    if(settings.postFlushEnabled)
-      setState(POSTFLUSH);
-    else
-      setState(IDLE);
-  }
-}
-
-
-void enterError(const char* m)
-{
-  // laufende Produktion sauber abschließen
-  if(state == PRODUCTION || state == PREPARE) {
-    lastProducedLiters = producedLitersSafe();
-    productionEnded = false;   // ⬅ wichtig: wir schreiben JETZT
-    strncpy(lastStopReason, m, sizeof(lastStopReason)-1);
-    lastStopReason[sizeof(lastStopReason)-1] = 0;
-
-    historyEndProduction(lastStopReason, lastProducedLiters);
+  if(o.fx & CTL_FX_HISTORY_END) {
+    historyEndProduction(ctl.lastStopReason, ctl.lastProducedLiters);
     webNotifyHistoryUpdate();
   }
 
-  DBG_ERR("[%s] !!! ERROR: %s !!!\n", currentModeStr(), m);
-  lastErrorMsg = m;
-  sendPushover(m);
- 
-  setState(ERROR);
-}
+  if(ctl.state == ERROR && o.from != ERROR)
+    DBG_ERR("[%s] !!! ERROR: %s !!!\n", currentModeStr(), ctl.msg);
 
-void enterInfo(const char* m){
-  DBG_INFO("[%s] INFO: %s\n", currentModeStr(), m);
-  lastErrorMsg = m;
-  setState(INFO);
-}
+  if(o.fx & CTL_FX_PUSH)
+    sendPushover(o.push);
 
-void hardResetToIdle()
-{
-  allOff();
-  valveClosedTs = millis();
-  setState(IDLE);   // ✅ nur das!
+  // Text für Web/MQTT (nur bei Änderung neu zuweisen)
+  static const char* shownMsg = "";
+  if(ctl.msg != shownMsg) {
+    lastErrorMsg = ctl.msg;
+    shownMsg = ctl.msg;
+  }
 }
 
 void handleWifi()
 {
-  static uint32_t lastCheck = 0;
-
-  if(millis() - lastCheck < 5000) return;   // alle 5 Sekunden
-  lastCheck = millis();
-
   wl_status_t s = WiFi.status();
 
   // ===============================
@@ -604,37 +490,46 @@ void handleWifi()
 // ============================================================
 // Setup 
 // ============================================================
+static void schedulerInit();   // Tasks: siehe unten
+
 void setup(){
   Serial.begin(115200);
   delay(800);
-  SPIFFS.begin(true);  
+  halFsBegin();
+  configLoad();
+  settingsLoad();   // ⭐ zuerst laden (Aufzeichnung startet vor allen Modulen)
+  if(settings.recordInputs && recBegin(TASK_CONTROL_MS))
+    DBG_INFO("[REC] recording inputs -> %s\n", REC_PATH);
+  totalsInit();
   historyInit();
   DBG_INFO(ESP_VERSION); DBG_INFO("\n");
   const esp_partition_t* p = esp_ota_get_running_partition();
   Serial.printf("Running partition: %s\n", p->label);
-  pinMode(PIN_WLOW,INPUT_PULLUP);
-  pinMode(PIN_WHIGH,INPUT_PULLUP);
-  pinMode(PIN_WERROR,INPUT_PULLUP);
-  pinMode(PIN_SAUTO,INPUT_PULLUP);
-  pinMode(PIN_SMANU,INPUT_PULLUP);
-  attachInterrupt(PIN_WCOUNT_IN,isrIn,RISING);
-  attachInterrupt(PIN_WCOUNT_OUT,isrOut,RISING);
-  analogReadResolution(12);
+  inputsInit(inputDefs, IN_COUNT);
+  uint8_t inMask=0;
+  for(uint8_t i=0;i<IN_COUNT;i++) if(inputActive(i)) inMask |= 1<<i;
+  recInputsInit(inputDefs, IN_COUNT, inMask);
+  inputsSetEdgeHook(recEdge);
+  halPulseAttach(PIN_WCOUNT_IN,isrIn);
+  halPulseAttach(PIN_WCOUNT_OUT,isrOut);
+  halAdcInit();
+  tdsAdcInit(PIN_TDS_ADC);
   Wire.begin(PIN_I2C_SDA,PIN_I2C_SCL);
-  pcf.begin(0x38);
-  allOff();
-  configLoad();
-  settingsLoad();   // ⭐ zuerst laden
-  startWifi();      // ⭐ erst danach benutzen
+  halExpBegin(0x38);
+  outputsInit(pinInvertMask());   // alles aus
+  startWifi();      // ⭐ Settings sind geladen
   webInit();
-  lastSwitchState = inActive(PIN_SMANU); // aktuellen Schalterzustand als „bereits gedrückt“ merken. Damit gibt es keine Fake-Flanke.
+  uint32_t now=millis();
+  recCtlInit(now);
+  ctlInit(ctl, &settings, now);
+  schedulerInit();
 }
 
 String buildStatusLine(float tds)
 {
-  bool low  = inActive(PIN_WLOW);
-  bool high = inActive(PIN_WHIGH);
-  bool err  = inActive(PIN_WERROR);
+  bool low  = inputActive(IN_WLOW);
+  bool high = inputActive(IN_WHIGH);
+  bool err  = inputActive(IN_WERROR);
 
   char buf[120];
   snprintf(buf, sizeof(buf),
@@ -651,557 +546,182 @@ String buildStatusLine(float tds)
 
 
 // ============================================================
-// Loop (ORIGINAL + ADD checks)
+// Tasks (Scheduler, feste Raten)
 // ============================================================
-void loop(){
-
-  int raw=analogRead(PIN_TDS_ADC);
-  handleWifi();
-
-  float tds=rawToTds(raw);
- 
-  if(!wifiConnected)
-    dnsServer.processNextRequest();
-
-  mqttReconnect(tds);
-  mqtt.loop();
-
- 
-  // =====================================================
-  // ⭐ GLOBAL Auto-Flankenerkennung (immer aktiv!)
-  // =====================================================
-  static bool lastAutoMode = false;
-  
-  bool autoModeNow = inActive(PIN_SAUTO);
-  
-  if(!lastAutoMode && autoModeNow) {
-    autoBlocked = false;
-    autoPauseBlink = false;
-    lastErrorMsg = "";
-    if(state == IDLE) stateStart = millis();  // sauberer Reset
-  }
-
-  lastAutoMode = autoModeNow;
+static float tdsRaw = 0.0f;
+static float tdsNow = 0.0f;
 
-  /* =========================================
-     Web Start/Stop Requests
-  ========================================= */
-
-  // ===== Web Start =====
-  if(webStartRequest){
-    webStartRequest = false;
-
-    autoBlocked = false;
-    autoPauseBlink = false;
-    lastErrorMsg = "";
+static uint32_t runtimeSecNow()
+{
+  return (ctl.state == PRODUCTION) ? (millis() - ctl.productionStartMs) / 1000 : 0;
+}
 
-    setState(PREPARE);
-  }
+static float litersNow()
+{
+  return (ctl.state == PRODUCTION) ? producedLitersSafe() : ctl.lastProducedLiters;
+}
 
+/* ---------- Sensorik ---------- */
+static void taskSense()
+{
+  tdsAdcPoll();
 
-  // ===== Web Stop =====
-  if(webStopRequest){
-    webStopRequest = false;
-    bool manualMode = inActive(PIN_SMANU);
-    // AUTO → blockieren
-    if(!manualMode) {
-      autoBlocked = true;
-      autoPauseBlink = true;
-    }
-    // ----- Produktion läuft -----
-    if(state == PRODUCTION) {
-      finalizeProductionIfRunning("User stop");
-      stopProduction("User stop");
-    }
-    // ----- Vorbereitung / Spülen -----
-    else if(state == PREPARE || state == AUTOFLUSH) {
-      lastProducedLiters = 0.0f;
-      productionEnded = false;
-      strcpy(lastStopReason, "User stop");
-      setState(IDLE);   // kein PostFlush!
-    }
-  }
+  float raw = tdsAdcValue();
+  if(raw < 0) return;         // noch kein Median voll
 
-  // ===== Manual switch start (0 -> MANU rising edge) =====
-  bool manualNow = inActive(PIN_SMANU);
-  if(state == IDLE && manualNow && !lastSwitchState) {
-    DBG_INFO("[START] manual switch\n");
-    autoBlocked=false;   
-    setState(PREPARE);
-  }
+  tdsRaw = raw;
+  recAdc(tdsCode(raw));
+  tdsNow = tdsLookup(raw);
+}
 
-  lastSwitchState = manualNow;
+/* ---------- Eingänge, Sicherheit, StateMachine ---------- */
+static void taskControl()
+{
+  CtlInputs in;
+
+  /* Zeit, Web-Requests, Eingänge, Zähler unter einer Sperre: ISR-
+     Ereignisse liegen für die Aufzeichnung eindeutig vor/nach dem Tick */
+  recLock();
+  in.now      = millis();
+  in.webStart = webStartRequest;  webStartRequest = false;   // aus dem Web-Task
+  in.webStop  = webStopRequest;   webStopRequest  = false;
+  recCmd(in.webStart, in.webStop);
+  recTick(in.now);
+  inputsPoll(in.now);        // ein entprellter Schnappschuss je Tick
+  in.cntIn    = cntIn;
+  in.cntOut   = cntOut;
+  recUnlock();
+
+  in.autoMode   = inputActive(IN_SAUTO);
+  in.manualMode = inputActive(IN_SMANU);
+  in.autoRose   = inputRose(IN_SAUTO);
+  in.manualRose = inputRose(IN_SMANU);
+  in.lowSwim    = inputActive(IN_WLOW);
+  in.highSwim   = inputActive(IN_WHIGH);
+  in.werror     = inputActive(IN_WERROR);
+
+  in.tds    = tdsNow;
+  in.hzIn   = flowHz(FLOW_IN);    // Stand letzter Flow-Task
+  in.hzOut  = flowHz(FLOW_OUT);
+
+  applyControl(ctlStep(ctl, in));
+
+  DBG_DBG("STATE=%s raw=%.0f tds=%.1f in=%lu out=%lu\n",
+          ctlStateName(ctl.state),tdsRaw,in.tds,in.cntIn,in.cntOut);
+}
 
-  float histLiters =
-    (state == PRODUCTION) ? producedLitersSafe() : lastProducedLiters;
+/* ---------- Flow-Berechnung (Zulauf im ganzen Lauf, Produkt in PRODUCTION) ---------- */
+static void taskFlow()
+{
+  uint32_t us = micros();
+  flowUpdate(us);
+  recFlow(us);
+  currentFlowLpm   = ctlFlowOutLpm(ctl, flowHz(FLOW_OUT));
+  currentFlowInLpm = ctlFlowInLpm(ctl, flowHz(FLOW_IN));
+}
 
-    historyAddSample2s(tds,
-                       histLiters,
+/* ---------- History (2 s Basistakt) ---------- */
+static void taskHistory()
+{
+  {
+    PROF_SCOPE(profHistAdd);
+    historyAddSample2s(tdsNow,
+                       litersNow(),
                        currentFlowLpm,
-                       currentFlowInLpm);
-
-  bool off=!inActive(PIN_SAUTO)&&!inActive(PIN_SMANU);
- 
-  // STOP muss auch im ERROR wirken
-  if((webStopRequest || off) && state == ERROR) {
-    webStopRequest = false;
-    autoBlocked = false;
-    autoPauseBlink = false;
-    lastErrorMsg = "";
-    setState(IDLE);
+                       currentFlowInLpm,
+                       (uint8_t)ctl.state);
   }
+  PROF_SCOPE(profHistLoop);
+  historyLoop();
+  totalsUpdatePulses(cntOut, cntIn);
+}
 
-
-  // ===== ADD: SAFETY =====
-  // =====================================================
-  // WERROR – entprellt / glitchfest
-  // =====================================================
-  static uint32_t werrorSince = 0;
-
-  if(inActive(PIN_WERROR)) {
-    if(werrorSince == 0) {
-      werrorSince = millis();          // Beginn merken
-    } else if(millis() - werrorSince > 100) {
-      enterError("Water error");       // echter Fehler
-    }
-  } else {
-    werrorSince = 0;                   // wieder ruhig
+/* ---------- WiFi / MQTT Verbindung ---------- */
+static void taskLink()
+{
+  {
+    PROF_SCOPE(profWifi);
+    handleWifi();
   }
+  PROF_SCOPE(profMqttConn);
+  mqttReconnect(tdsNow);
+}
 
-  // =====================================================
-  // Einlauf trotz geschlossenem Einlassventil (robust)
-  // =====================================================
-  static uint32_t lastCntIn = 0;
-  static uint32_t closedInPulses = 0;
-  static uint32_t closedInStartMs = 0;
-  
-  if(!wInOn) {   // Einlassventil ZU
-  
-    if(cntIn != lastCntIn) {
-  
-      uint32_t now = millis();
-  
-      // Nachlauf ignorieren
-      if(now - valveClosedTs > FLOW_CLOSED_GRACE_MS) {
-  
-        if(closedInStartMs == 0) {
-          closedInStartMs = now;
-          closedInPulses  = 0;
-        }
-  
-        closedInPulses += (cntIn - lastCntIn);
-  
-        if(closedInPulses > FLOW_CLOSED_MAX_PULSES &&
-           now - closedInStartMs < FLOW_CLOSED_WINDOW_MS)
-        {
-          enterError("Inflow while inlet valve closed");
-        }
-      }
-    }
-  
-  } else {
-    // Ventil offen → Reset
-    closedInPulses = 0;
-    closedInStartMs = 0;
-  }
-  
-  lastCntIn = cntIn;
-
-  // =====================================================
-  // Flow-Ratio-Überwachung (nur PRODUCTION, verzögert)
-  // =====================================================
-  if(state == PRODUCTION) {
-    // erst nach Anlaufzeit bewerten
-    if(millis() - ratioStartMs > 8000) {   // 8 s Anlauf
-      uint32_t dIn  = cntIn  - ratioStartCntIn;
-      uint32_t dOut = cntOut - ratioStartCntOut;
-      // nur bewerten, wenn überhaupt Durchfluss da ist
-      if(dIn > 30) {
-        float ratio = (float)dOut / (float)dIn;
-        if(ratio < 0.3f) {
-          enterError("Bad flow ratio (<30%%)");
-        }
-        // neues Fenster starten
-        ratioStartCntIn  = cntIn;
-        ratioStartCntOut = cntOut;
-        ratioStartMs     = millis();
-      }
-    }
-  }
+/* ---------- Neustart (one-shot, von taskNet scharf geschaltet) ---------- */
+static SchedId rebootTimer = -1;
 
+static void taskReboot()
+{
+  DBG_INFO("[SYS] reboot\n");
+  ESP.restart();
+}
 
-  DBG_DBG("STATE=%s raw=%d tds=%.1f in=%lu out=%lu\n",
-          sName[state],raw,tds,cntIn,cntOut);
+/* ---------- Netz-Polling, MQTT bei Statewechsel ---------- */
+static void taskNet()
+{
+  if(!wifiConnected)
+    dnsServer.processNextRequest();
 
-  // ===== OFF =====
-  if(off && state != SERVICEFLUSH){
-    allOff();
-    lastSwitchState = false; 
+  {
+    PROF_SCOPE(profMqttLoop);
+    mqtt.loop();
+  }
 
-    // laufende Produktion sauber beenden
-    if(state == PRODUCTION) {
-      stopProduction("User stop");
-    }
-  
-    autoPauseBlink = false;
-    runtimeTimeoutActive = false;
-    lastErrorMsg = "";
-  
-    if(state != IDLE) {
-      setState(IDLE);
-    }
+  if(ctl.state != lastState) {
+    PROF_SCOPE(profMqttPub);
+    mqttPublish(ctlStateName(ctl.state), tdsNow, litersNow(), currentFlowLpm, runtimeSecNow());
+    lastState = ctl.state;
   }
 
+  /* Neustart aus dem Web-Handler: erst hier, damit die Antwort noch
+     rausgeht; kein erneutes Scharfschalten (würde die Frist schieben) */
+  if(webRebootMs && !schedArmed(rebootTimer))
+    schedArm(rebootTimer, webRebootMs);
+}
 
-  // =====================================================
-  // Schwimmer-Plausibilität (AUTO, alle States)
-  // =====================================================
-  if(state != ERROR) {
-    bool autoMode = inActive(PIN_SAUTO);
-    if(autoMode) {
-      bool lowSwim  = inActive(PIN_WLOW);
-      bool highSwim = inActive(PIN_WHIGH);
-  
-      // oben Wasser, unten trocken → unmöglich
-      if(highSwim && !lowSwim) {
-        enterError("Level sensor mismatch (upper only)");
-      }
-    }
-  }
+/* ---------- MQTT Heartbeat ---------- */
+static void taskTelemetry()
+{
+  PROF_SCOPE(profMqttPub);
+  mqttPublish(ctlStateName(ctl.state), tdsNow, litersNow(), currentFlowLpm, runtimeSecNow());
+  lastState = ctl.state;
+}
 
+static void taskLeds()
+{
+  updateLEDs(ctl.state);
+}
 
-  if(settings.serviceFlushEnabled &&
-     settings.serviceFlushIntervalSec > 0 &&
-     state != PRODUCTION &&
-     state != PREPARE &&
-     state != AUTOFLUSH &&
-     state != POSTFLUSH &&
-     state != SERVICEFLUSH &&
-     state != ERROR )
-  {
-    if(millis() - lastServiceFlushMs >
-       settings.serviceFlushIntervalSec * 1000)
-    {
-      setState(SERVICEFLUSH);
-    }
-  }
-  // ===== StateMachine =====
-  if(!off || state == SERVICEFLUSH){
-  
-    switch(state) {
-  
-      /* ===================================================== */
-      case IDLE: {
-       
-        // Produktion physikalisch abgeschlossen → History schreiben
-        if (productionEnded) {
-          productionEnded = false;
-
-          historyEndProduction(lastStopReason, lastProducedLiters);
-          webNotifyHistoryUpdate();
-        }
-        
-        setOut(Relay,false);
-        setOut(WIn,false);
-        setOut(OOut,false);
-        setOut(OtoS,false);
-
-
-        bool autoMode   = inActive(PIN_SAUTO);
-        bool manualMode = inActive(PIN_SMANU);
-
-        bool lowSwim  = inActive(PIN_WLOW);   // schwimmt = true
-        bool highSwim = inActive(PIN_WHIGH);  // schwimmt = true
-               
-        /* ========= AUTO START nur wenn beide NICHT schwimmen ========= */
-        if(autoMode && !manualMode && !autoBlocked)
-        {
-          if(!lowSwim && !highSwim) { // trocken unten
-            if(!autoStartNotified) {
-              sendPushover("Osmose Auto-Bezug gestartet");
-              autoStartNotified = true;
-            }
-            setState(PREPARE);
-          }
-        }
-        
-        break;
-      }
-  
-      /* ===================================================== */
-      case PREPARE: {
-        // Nur Wasser an, noch kein Produkt
-        setOut(Relay,true);
-        setOut(WIn,true);
-        setOut(OOut,false);
-        setOut(OtoS,false);
-  
-        if(millis()-stateStart > settings.prepareTimeSec * 1000) {
-          if(settings.autoFlushEnabled)
-            setState(AUTOFLUSH);
-          else
-            setState(PRODUCTION);
-        }
-        break;
-      }
-
-  
-      /* ===================================================== */
-      /* ===================================================== */
-      case AUTOFLUSH: {
-        // Grundzustand: Spülen zur Drain
-        setOut(Relay,true);
-        setOut(WIn,true);
-        setOut(OtoS,true);
-
-        uint32_t now = millis();
-
-        /* ---------- Produkt-Puls starten ---------- */
-        if(!autoflushPulseActive && now - autoflushLastPulseMs >= AUTOFLUSH_PRODUCT_INTERVAL_MS) {
-          autoflushPulseActive = true;
-          autoflushLastPulseMs = now;
-        }
-
-        /* ---------- Produkt-Puls aktiv ---------- */
-        if(autoflushPulseActive) {
-          setOut(OOut,true);   // kurz Produkt freigeben
-
-          if(now - autoflushLastPulseMs >= AUTOFLUSH_PRODUCT_PULSE_MS) {
-            autoflushPulseActive = false;
-            setOut(OOut,false);  // wieder sperren
-          }
-        } else {
-          setOut(OOut,false);
-        }
-
-        /* ---------- Mindest-Spülzeit ---------- */
-        bool minFlushDone =
-          (millis() - stateStart) >=
-          (uint32_t)(settings.autoFlushMinTimeSec * 1000.0f);
-
-        /* ---------- TDS-Entscheidung nur außerhalb des Pulses ---------- */
-        if(minFlushDone && !autoflushPulseActive && tds < settings.tdsLimit) {
-          // Puls-Status sauber zurücksetzen
-          autoflushPulseActive = false;
-          autoflushLastPulseMs = 0;
-
-          prodStartCnt = cntOut;
-          setState(PRODUCTION);
-          break;
-        }
-
-        /* ---------- Absolute Schutzzeit ---------- */
-        if(millis() - stateStart > settings.maxFlushTimeSec * 1000.0f) {
-          enterError("Flush timeout");
-          break;
-        }
-
-        break;
-      }
-      /* ===================================================== */
-      case PRODUCTION: {
-
-        setOut(Relay,true);
-        setOut(WIn,true);
-        setOut(OOut,true);
-        setOut(OtoS,false);
-      
-        bool autoMode   = inActive(PIN_SAUTO);
-        bool manualMode = inActive(PIN_SMANU);
-      
-        bool lowSwim  = inActive(PIN_WLOW);
-        bool highSwim = inActive(PIN_WHIGH);
-      
-      
-        /* =========================================================
-           AUTO STOP → Tank voll (unverändert)
-           ========================================================= */
-        if(autoMode && !manualMode)
-        {
-          if(lowSwim && highSwim)
-          {
-            enterInfo("Container full");
-            strcpy(lastStopReason, "Container full");
-
-            if(settings.postFlushEnabled)
-              setState(POSTFLUSH);
-            else
-              setState(IDLE);
-      
-            break;
-          }
-        }
-      
-      
-        /* =========================================================
-           TDS Limit
-           ========================================================= */
-        if(state == PRODUCTION &&  millis() - lastActuatorSwitchMs > 500 && tds > settings.tdsMaxAllowed) {
-          enterError("TDS too high");
-        }
-      
-        /* =========================================================
-           Production tracking
-           ========================================================= */
-        bool isManualMode = manualMode;
-            
-        /* =========================================================
-           ⭐ LITER LIMIT
-           MANUAL → normal fertig
-           AUTO   → ERROR
-           ========================================================= */
-        float maxProd = isManualMode ?
-            settings.maxProductionManualLiters :
-            settings.maxProductionAutoLiters;
-      
-        if(maxProd > 0 && producedLitersSafe() > maxProd)
-        {
-          if (isManualMode) {
-            strcpy(lastStopReason, "Volume limit");
-            // normaler Abschluss
-            if(settings.postFlushEnabled)
-              setState(POSTFLUSH);
-            else
-              setState(IDLE);
-          } else {
-            autoBlocked = true;
-            enterError("Volume limit");
-          }
-          break;
-        }
-           
-        /* =========================================================
-           ⭐ RUNTIME LIMIT
-           MANUAL → INFO
-           AUTO   → ERROR
-           ========================================================= */
-        float maxRun = isManualMode ?
-            settings.maxRuntimeManualSec :
-            settings.maxRuntimeAutoSec;
-      
-        if(maxRun > 0 && (millis() - stateStart) > maxRun * 1000) {
-          if(isManualMode) {
-            runtimeTimeoutActive = true;
-            strcpy(lastStopReason, "Max runtime reached");
-     
-            if(settings.postFlushEnabled)
-              setState(POSTFLUSH);
-            else
-              setState(INFO);
-          } else {
-            autoBlocked = true;
-            enterError("Max runtime reached");
-          }
-          break;
-        }
-        break;
-      }
- 
-      /* ===================================================== */
-      case POSTFLUSH: {
-        // Postflush: Rohwasser spült, Osmose hydraulisch gesperrt
-        setOut(Relay,true);   // Anlage aktiv
-        setOut(WIn,true);     // Rohwasser an
-        setOut(OOut,false);   // kein Produkt
-        setOut(OtoS,false);   // Osmose vollständig gesperrt
-        if(millis() - stateStart > settings.postFlushTimeSec * 1000) {
-          if(runtimeTimeoutActive) {
-            runtimeTimeoutActive = false;
-            enterInfo("Max runtime reached");
-          } else {
-            setState(IDLE);
-          }
-        }
-        break;
-      }
-      
-      case SERVICEFLUSH: {
-        /* nur Spülventil */
-        setOut(Relay,true);   // Anlage aktiv
-        setOut(WIn,true);     // Wasser rein
-        setOut(OtoS,true);    // Spülweg
-        setOut(OOut,false);   // KEIN Produktwasser
-     
-        if(millis() - stateStart > settings.serviceFlushTimeSec * 1000) {
-          setOut(OtoS,false);
-          lastServiceFlushMs = millis();
-          /* optional Postflush nach ServiceFlush */
-          if(settings.postFlushEnabled) {
-            setState(POSTFLUSH);
-          } else {
-            if(lastErrorMsg.length())   // wenn Info aktiv war, diese nach dem Flush wiederherstellen
-              setState(INFO);           
-            else
-              setState(IDLE);
-          }
-        }
-      
-        break;
-      }
-
-      /* ===================================================== */
-      case ERROR:
-      case INFO:
-        // Nur hier komplett aus!
-        allOff();
-      break;
-    }
-  }
+/* ---------- Web Status + WS Broadcast ---------- */
+static void taskWeb()
+{
+  bool manualActive = inputActive(IN_SMANU);
+  String status = buildStatusLine(tdsNow);
+  webSetStatus(status.c_str());
+  webLoop(tdsNow, ctlStateName(ctl.state), litersNow(), manualActive, runtimeSecNow(), currentModeStr(), currentFlowLpm, currentFlowInLpm, ESP_VERSION);
+}
 
-  // ===== MQTT =====
-  static uint32_t lastMQTT = 0;
-  uint32_t runtimeSec = 0;
-  if(state == PRODUCTION)
-    runtimeSec = (millis() - productionStartMs) / 1000;
-  
-  
-  /* ---------- Flow-Berechnung (nur PRODUCTION) ---------- */
-  uint32_t now = millis();
-  if(state == PRODUCTION) {
-    uint32_t dt = now - flowLastT;
-    if(dt >= 3000) {
-      // OUT
-      uint32_t pulsesOut = cntOut - flowLastCnt;
-      float dlOut = liters(pulsesOut);
-      currentFlowLpm = (dlOut > 0)
-        ? (dlOut / (dt / 1000.0f)) * 60.0f
-        : 0.0f;
-      flowLastCnt = cntOut;
-      flowLastT   = now;
-      // IN
-      uint32_t pulsesIn = cntIn - flowInLastCnt;
-      float dlIn = litersIn(pulsesIn);
-      currentFlowInLpm = (dlIn > 0)
-        ? (dlIn / (dt / 1000.0f)) * 60.0f
-        : 0.0f;
-      flowInLastCnt = cntIn;
-      flowInLastT   = now;
-    }
-  } else {
-    currentFlowLpm   = 0.0f;
-    currentFlowInLpm = 0.0f;
-  }
+static void schedulerInit()
+{
+  schedEvery("control",   TASK_CONTROL_MS,   taskControl);
+  schedEvery("sense",     TASK_SENSE_MS,     taskSense);
+  schedEvery("net",       TASK_NET_MS,       taskNet);
+  schedEvery("leds",      TASK_LEDS_MS,      taskLeds);
+  schedEvery("flow",      TASK_FLOW_MS,      taskFlow);
+  schedEvery("history",   TASK_HISTORY_MS,   taskHistory);
+  schedEvery("web",       TASK_WEB_MS,       taskWeb);
+  schedEvery("link",      TASK_LINK_MS,      taskLink);
+  schedEvery("telemetry", TASK_TELEMETRY_MS, taskTelemetry);
+  schedEvery("rec",       TASK_REC_MS,       recFlush);
+  rebootTimer = schedTimeout("reboot", taskReboot);
+}
 
-  /* ---------- SEND LOGIK ---------- */
-  bool sendMQTTnow = false;
-  /* State change */
-  if(state != lastState) sendMQTTnow = true;
-  /* Heartbeat */
-  if(millis() - lastMQTT > 10000) sendMQTTnow = true;
-  float litersNow =
-    (state == PRODUCTION) ? producedLitersSafe() : lastProducedLiters;
-
-  /* ---------- Publish ---------- */
-  if(sendMQTTnow) {
-    mqttPublish(sName[state], tds, litersNow, currentFlowLpm, runtimeSec);
-    lastState = state;
-    lastMQTT  = millis();
-  }
-  
-  updateLEDs(state);
 
-  bool manualActive = inActive(PIN_SMANU);
-  String status = buildStatusLine(tds);
-  webSetStatus(status.c_str());   
-  webLoop(tds, sName[state], litersNow, manualActive, runtimeSec, currentModeStr(), currentFlowLpm, currentFlowInLpm, ESP_VERSION);
+// ============================================================
+// Loop
+// ============================================================
+void loop(){
+  uint32_t idleMs = schedRun();
+  outFlush();                   // Schattenbyte -> PCF8574 (nur bei Änderung)
+  if(idleMs) delay(idleMs);     // bis zur nächsten Deadline abgeben
 }
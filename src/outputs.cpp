@@ -0,0 +1,82 @@
+#include "outputs.h"
+#include "hal.h"
+#include "profiler.h"
+
+/* ============================================================
+   STATE
+   ============================================================ */
+
+static bool     ready   = false;
+static uint8_t  invert  = 0;
+static uint8_t  shadow  = 0;          // Logik-Pegel (1 = an)
+static uint8_t  written = 0;          // zuletzt geschriebenes Pin-Byte
+static bool     dirty   = true;       // unbekannter Stand -> schreiben
+static uint32_t lastVerify = 0;
+
+static const ProfStage profI2cOut = profStage("i2cOut");
+
+static inline uint8_t pinByte()
+{
+  return shadow ^ invert;
+}
+
+/* ============================================================
+   API
+   ============================================================ */
+
+void outputsInit(uint8_t invertMask)
+{
+  ready  = true;
+  invert = invertMask;
+  shadow = 0;
+  dirty  = true;
+  lastVerify = halMillis();
+  outFlush();
+}
+
+void outSet(uint8_t ch, bool on)
+{
+  if(ch >= OUT_CHANNELS) return;
+  if(on) shadow |=  (1 << ch);
+  else   shadow &= ~(1 << ch);
+}
+
+void outSetMask(uint8_t mask, uint8_t on)
+{
+  shadow = (shadow & ~mask) | (on & mask);
+}
+
+static void writeByte(uint8_t b)
+{
+  PROF_SCOPE(profI2cOut);
+  if(halExpWrite(b)) {
+    written = b;
+    dirty   = false;
+  } else {
+    Serial.println("[OUT] I2C write failed");
+    dirty = true;                     // nächster Flush versucht erneut
+  }
+}
+
+void outFlush()
+{
+  if(!ready) return;
+
+  uint8_t b = pinByte();
+  if(dirty || b != written) writeByte(b);
+
+  if(halMillis() - lastVerify < OUT_VERIFY_MS) return;
+  lastVerify = halMillis();
+
+  /* Readback: Ausgänge auf LOW lesen LOW, HIGH (quasi-bidirektional)
+     liest HIGH, solange extern nichts zieht */
+  uint8_t rd;
+  {
+    PROF_SCOPE(profI2cOut);
+    rd = halExpRead();
+  }
+  if(!dirty && rd != written) {
+    Serial.printf("[OUT] readback 0x%02X != 0x%02X, rewrite\n", rd, written);
+    writeByte(written);
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   OUTPUTS
+   Schattenbyte für alle 8 Kanäle des PCF8574 (Aktoren + LEDs).
+   outSet() ändert nur den Schatten; outFlush() schreibt einmal
+   pro Scheduler-Durchlauf das ganze Byte, und nur wenn es sich
+   geändert hat (eine I2C-Transaktion statt einer je Kanal).
+
+   Alle OUT_VERIFY_MS wird das Byte zurückgelesen: weicht es ab
+   (Brown-out/Reset des Expanders, Störung), wird neu geschrieben.
+   Logik-Pegel: on/off; die Invertierung je Kanal passiert hier.
+   Der Expander selbst hängt an der HAL (halExpBegin vorher).
+   ============================================================ */
+
+#define OUT_CHANNELS   8
+#define OUT_VERIFY_MS  1000
+
+void outputsInit(uint8_t invertMask);
+
+/* nur Schatten */
+void outSet(uint8_t ch, bool on);
+void outSetMask(uint8_t mask, uint8_t on);   // Kanäle in mask auf Bits aus on
+
+/* Schatten -> Expander (bei Änderung) + zyklische Kontrolle */
+void outFlush();
@@ -0,0 +1,131 @@
+#pragma once
+
+/* ============================================================
+   HOST ARDUINO
+   Minimaler Arduino-Ersatz für env:native und sim/ (Linux): nur
+   was die Module neben hal.h noch brauchen (Typen, Print/String,
+   Serial). Die Zeit läuft über die virtuelle Uhr in hal_posix.cpp.
+   String/Stream reichen für ArduinoJson
+   (ARDUINOJSON_ENABLE_ARDUINO_STRING/STREAM/PRINT).
+   ============================================================ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+#define constrain(v,lo,hi) ((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+#define IRAM_ATTR
+
+/* kritische Abschnitte: einfädig, also leer */
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(m)        ((void)(m))
+#define portEXIT_CRITICAL(m)         ((void)(m))
+#define portENTER_CRITICAL_ISR(m)    ((void)(m))
+#define portEXIT_CRITICAL_ISR(m)     ((void)(m))
+
+#define LOW          0
+#define HIGH         1
+
+typedef uint8_t byte;
+
+/* ---------- Zeit (virtuell) ---------- */
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t ms);
+
+/* ---------- Print / String ---------- */
+class String;
+
+class Print{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* b, size_t n)
+  {
+    size_t k = 0;
+    while(n--) k += write(*b++);
+    return k;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+  size_t print(const char* s)   { return write(s); }
+  size_t print(const String& s);
+  size_t print(char c)          { return write((uint8_t)c); }
+  size_t print(int v)           { return printf("%d", v); }
+  size_t print(unsigned v)      { return printf("%u", v); }
+  size_t print(long v)          { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int d = 2) { return printf("%.*f", d, v); }
+  size_t println()              { return write("\r\n"); }
+  template<class T> size_t println(T v) { return print(v) + println(); }
+
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print{
+public:
+  virtual int available() { return 0; }
+  virtual int read()      { return -1; }
+  virtual int peek()      { return -1; }
+
+  size_t readBytes(char* b, size_t n)
+  {
+    size_t k = 0;
+    for(int c; k < n && (c = read()) >= 0; k++) b[k] = (char)c;
+    return k;
+  }
+  size_t readBytes(uint8_t* b, size_t n) { return readBytes((char*)b, n); }
+};
+
+class String{
+public:
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& x) : s(x) {}
+
+  const char* c_str() const { return s.c_str(); }
+  size_t length() const     { return s.size(); }
+  bool   isEmpty() const    { return s.empty(); }
+
+  bool operator==(const char* o) const   { return s == o; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator!=(const char* o) const   { return s != o; }
+  String& operator+=(const char* o)      { s += o; return *this; }
+  String& operator+=(const String& o)    { s += o.s; return *this; }
+  bool   concat(const char* o)           { s += o; return true; }
+  bool   concat(const char* o, size_t n) { s.append(o, n); return true; }
+  bool   concat(char c)                  { s += c; return true; }
+  bool   reserve(size_t n)               { s.reserve(n); return true; }
+  char operator[](size_t i) const        { return s[i]; }
+
+private:
+  std::string s;
+};
+
+class StringSumHelper : public String{
+public:
+  using String::String;
+};
+
+inline size_t Print::print(const String& s) { return write(s.c_str()); }
+
+/* Serial -> stdout (mit hostSetQuiet stumm) */
+class HardwareSerial : public Stream{
+public:
+  void   begin(unsigned long) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* b, size_t n) override;
+  using Print::write;
+};
+extern HardwareSerial Serial;
@@ -0,0 +1,78 @@
+#pragma once
+#include <Arduino.h>
+#include <dirent.h>
+#include <memory>
+
+/* ============================================================
+   HOST FS
+   SPIFFS-Ersatz auf einem Verzeichnis (hostFsRoot). Pfade wie
+   auf dem ESP ("/hist.bin"), flach, ohne Unterverzeichnisse.
+   ============================================================ */
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream{
+public:
+  File() {}
+
+  size_t write(uint8_t c) override                    { return write(&c, 1); }
+  size_t write(const uint8_t* b, size_t n) override   { return fp ? fwrite(b, 1, n, fp.get()) : 0; }
+  using Print::write;
+
+  size_t read(uint8_t* b, size_t n) { return fp ? fread(b, 1, n, fp.get()) : 0; }
+  int    read() override;
+  int    peek() override;
+  int    available() override       { return fp ? (int)(size() - position()) : 0; }
+
+  bool   seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const           { return fp ? ftell(fp.get()) : 0; }
+  size_t size() const;
+  void   flush()                    { if(fp) fflush(fp.get()); }
+  void   close()                    { fp.reset(); dir.reset(); }
+
+  const char* name() const          { return base.c_str(); }
+  bool isDirectory() const          { return (bool)dir; }
+  File openNextFile();
+
+  operator bool() const             { return fp || dir; }
+
+private:
+  friend class FS;
+  std::shared_ptr<FILE> fp;
+  std::shared_ptr<DIR>  dir;
+  std::string base;                   // Name ohne führenden '/'
+  std::string dirPath;
+};
+
+class FS{
+public:
+  bool begin(bool formatOnFail = false);
+
+  File open(const char* path, const char* mode = "r");
+  File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+
+  size_t totalBytes();                        // Partition laut partitions.csv
+  size_t usedBytes();
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+/* Wurzelverzeichnis (vor begin); Standard "sim_fs" */
+void hostFsRoot(const char* dir);
+
+/* Größe für totalBytes(); Standard die SPIFFS-Partition */
+void hostFsSize(size_t bytes);
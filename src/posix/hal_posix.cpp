@@ -0,0 +1,320 @@
+#include "host.h"
+#include "hal.h"
+#include <SPIFFS.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* ============================================================
+   HAL POSIX
+   Backend für Linux (env:native, sim/): alles läuft über die
+   virtuelle Uhr und die Pins/ADC/Expander-Abbilder hier; sim/
+   und replay treiben sie über host.h.
+   ============================================================ */
+
+/* ============================================================
+   UHR
+   ============================================================ */
+
+static uint64_t nowUs  = 0;
+static uint32_t epoch0 = 0;
+
+uint64_t hostNowUs()               { return nowUs; }
+void     hostSetEpoch(uint32_t e)  { epoch0 = e; }
+
+void hostSetUs(uint64_t us)
+{
+  if(us > nowUs) nowUs = us;
+}
+
+uint32_t halMillis() { return (uint32_t)(nowUs / 1000); }
+uint32_t halMicros() { return (uint32_t)nowUs; }
+uint32_t halEpoch()  { return epoch0 + (uint32_t)(nowUs / 1000000); }
+
+uint32_t millis() { return halMillis(); }
+uint32_t micros() { return halMicros(); }
+
+void delay(uint32_t ms)
+{
+  nowUs += (uint64_t)ms * 1000;
+}
+
+/* virtuell: CPU-Takt x Uhr */
+uint32_t halCpuMHz() { return 160; }
+uint32_t halCycles() { return (uint32_t)(nowUs * halCpuMHz()); }
+
+/* xorshift32 */
+static uint32_t rnd = 0x12345678;
+
+void hostSeed(uint32_t seed) { rnd = seed ? seed : 0x12345678; }
+
+uint32_t halRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 17;
+  rnd ^= rnd << 5;
+  return rnd;
+}
+
+/* ============================================================
+   PINS / INTERRUPTS
+   ============================================================ */
+
+enum IrqMode : uint8_t { IRQ_NONE, IRQ_RISING, IRQ_CHANGE };
+
+struct HostPin{
+  uint8_t  level = HIGH;             // Pull-up
+  IrqMode  mode  = IRQ_NONE;
+  void   (*fn)()         = nullptr;  // halPulseAttach
+  void   (*fnArg)(void*) = nullptr;  // halPinIrq
+  void*    arg   = nullptr;
+  uint16_t adc   = 0;
+};
+
+static HostPin pins[HOST_PINS];
+
+void halPinInput(uint8_t) {}
+
+bool halPinRead(uint8_t pin)
+{
+  return pin < HOST_PINS && pins[pin].level == HIGH;
+}
+
+int hostPinRead(uint8_t pin)
+{
+  return halPinRead(pin) ? HIGH : LOW;
+}
+
+void halPulseAttach(uint8_t pin, void (*fn)())
+{
+  if(pin >= HOST_PINS) return;
+  pins[pin].fn   = fn;
+  pins[pin].mode = IRQ_RISING;
+}
+
+void halPinIrq(uint8_t pin, void (*fn)(void*), void* arg)
+{
+  if(pin >= HOST_PINS) return;
+  pins[pin].fnArg = fn;
+  pins[pin].arg   = arg;
+  pins[pin].mode  = IRQ_CHANGE;
+}
+
+static void fire(HostPin& p)
+{
+  if(p.fn)    p.fn();
+  if(p.fnArg) p.fnArg(p.arg);
+}
+
+void hostPinWrite(uint8_t pin, int level)
+{
+  if(pin >= HOST_PINS) return;
+  HostPin& p = pins[pin];
+  if(p.level == (level ? HIGH : LOW)) return;
+  p.level = level ? HIGH : LOW;
+
+  if(p.mode == IRQ_CHANGE || (p.mode == IRQ_RISING && p.level == HIGH))
+    fire(p);
+}
+
+void hostPinIrq(uint8_t pin, int level)
+{
+  if(pin >= HOST_PINS) return;
+  HostPin& p = pins[pin];
+  p.level = level ? HIGH : LOW;
+  if(p.mode == IRQ_CHANGE) fire(p);
+}
+
+/* ============================================================
+   ADC / EXPANDER
+   ============================================================ */
+
+void halAdcInit() {}
+
+uint16_t halAdcRead(uint8_t pin)
+{
+  return pin < HOST_PINS ? pins[pin].adc : 0;
+}
+
+void hostAdcWrite(uint8_t pin, uint16_t raw)
+{
+  if(pin < HOST_PINS) pins[pin].adc = min<uint16_t>(raw, 4095);
+}
+
+static uint8_t  expPins   = 0xFF;    // Power-on: alle Ausgänge HIGH
+static uint32_t expWrites = 0;
+
+bool    halExpBegin(uint8_t) { return true; }
+bool    halExpWrite(uint8_t b) { expPins = b; expWrites++; return true; }
+uint8_t halExpRead()         { return expPins; }
+
+uint8_t  hostExpPins()   { return expPins; }
+uint32_t hostExpWrites() { return expWrites; }
+
+/* ============================================================
+   SERIAL
+   ============================================================ */
+
+static bool quiet = false;
+
+void hostSetQuiet(bool q) { quiet = q; }
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* b, size_t n)
+{
+  if(!quiet) fwrite(b, 1, n, stdout);
+  return n;
+}
+
+HardwareSerial Serial;
+
+size_t Print::printf(const char* fmt, ...)
+{
+  char buf[512];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if(n <= 0) return 0;
+  return write((const uint8_t*)buf, min((size_t)n, sizeof(buf) - 1));
+}
+
+/* ============================================================
+   FS
+   ============================================================ */
+
+static std::string fsRoot = "sim_fs";
+static size_t      fsSize = 1507328;
+
+void hostFsRoot(const char* dir) { fsRoot = dir; }
+void hostFsSize(size_t bytes)    { fsSize = bytes; }
+
+static std::string fullPath(const char* path)
+{
+  return fsRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+namespace fs {
+
+int File::read()
+{
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek()
+{
+  int c = read();
+  if(c >= 0) fseek(fp.get(), -1, SEEK_CUR);
+  return c;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+  return fp && fseek(fp.get(), pos, whence[mode]) == 0;
+}
+
+size_t File::size() const
+{
+  if(!fp) return 0;
+  struct stat st;
+  fflush(fp.get());
+  return fstat(fileno(fp.get()), &st) == 0 ? st.st_size : 0;
+}
+
+File File::openNextFile()
+{
+  File f;
+  if(!dir) return f;
+
+  while(struct dirent* e = readdir(dir.get())) {
+    if(e->d_name[0] == '.') continue;
+    std::string path = dirPath + "/" + e->d_name;
+    FILE* x = fopen(path.c_str(), "rb");
+    if(!x) continue;
+    f.fp.reset(x, fclose);
+    f.base = e->d_name;
+    break;
+  }
+  return f;
+}
+
+bool FS::begin(bool)
+{
+  mkdir(fsRoot.c_str(), 0755);
+  return true;
+}
+
+File FS::open(const char* path, const char* mode)
+{
+  File f;
+
+  if(strcmp(path, "/") == 0) {
+    DIR* d = opendir(fsRoot.c_str());
+    if(d) f.dir.reset(d, closedir);
+    f.dirPath = fsRoot;
+    return f;
+  }
+
+  /* wie SPIFFS: "w" neu, "a" anhängen, "r+" lesen/schreiben */
+  const char* m = strcmp(mode, "w")  == 0 ? "wb"  :
+                  strcmp(mode, "a")  == 0 ? "ab"  :
+                  strcmp(mode, "r+") == 0 ? "r+b" : "rb";
+  FILE* x = fopen(fullPath(path).c_str(), m);
+  if(x) f.fp.reset(x, fclose);
+  f.base = path[0] == '/' ? path + 1 : path;
+  return f;
+}
+
+bool FS::exists(const char* path)
+{
+  struct stat st;
+  return stat(fullPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path)
+{
+  return ::remove(fullPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to)
+{
+  return ::rename(fullPath(from).c_str(), fullPath(to).c_str()) == 0;
+}
+
+size_t FS::totalBytes()
+{
+  return fsSize;
+}
+
+size_t FS::usedBytes()
+{
+  size_t used = 0;
+  DIR* d = opendir(fsRoot.c_str());
+  if(!d) return 0;
+  while(struct dirent* e = readdir(d)) {
+    struct stat st;
+    if(e->d_name[0] != '.' && stat((fsRoot + "/" + e->d_name).c_str(), &st) == 0)
+      used += st.st_size;
+  }
+  closedir(d);
+  return used;
+}
+
+}  // namespace fs
+
+fs::FS SPIFFS;
+
+bool    halFsBegin() { return SPIFFS.begin(true); }
+fs::FS& halFs()      { return SPIFFS; }
+
+uint32_t halFsFree()
+{
+  size_t used = SPIFFS.usedBytes();
+  return used < SPIFFS.totalBytes() ? SPIFFS.totalBytes() - used : 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   HOST
+   Steuerseite des POSIX-Backends (hal_posix.cpp) für sim/ und
+   env:native. Virtuelle Uhr: halMillis/halMicros/halEpoch lesen
+   nur diese Uhr -> Läufe sind reproduzierbar und beliebig
+   schneller als Echtzeit.
+
+   Pinwechsel über hostPinWrite() lösen die mit halPinIrq (CHANGE)
+   bzw. halPulseAttach (RISING) angemeldeten Handler aus wie die
+   ISR auf dem ESP, mit der Uhr auf dem Zeitpunkt der Flanke.
+   ============================================================ */
+
+#define HOST_PINS 32
+
+/* Uhr in µs; läuft nur vorwärts (Rücksprünge werden ignoriert) */
+uint64_t hostNowUs();
+void     hostSetUs(uint64_t us);
+
+/* Unix-Zeit bei Uhr 0 (halEpoch() = epoch0 + Uhr) */
+void     hostSetEpoch(uint32_t epoch0);
+
+/* Pegel setzen (Eingänge, Pull-up = HIGH bis gesetzt) */
+void     hostPinWrite(uint8_t pin, int level);
+int      hostPinRead(uint8_t pin);
+
+/* Pegel setzen und CHANGE-Handler immer auslösen, auch ohne
+   Pegelwechsel (Wiedergabe: Prellen schneller als die ISR) */
+void     hostPinIrq(uint8_t pin, int level);
+
+/* ADC-Rohwert für halAdcRead */
+void     hostAdcWrite(uint8_t pin, uint16_t raw);
+
+/* Expander: zuletzt geschriebenes Pin-Byte (Power-on 0xFF) und
+   Anzahl der Schreibzugriffe */
+uint8_t  hostExpPins();
+uint32_t hostExpWrites();
+
+/* Serial-Ausgabe der Firmware unterdrücken */
+void     hostSetQuiet(bool quiet);
+
+/* halRandom(): deterministische Folge ab seed */
+void     hostSeed(uint32_t seed);
@@ -0,0 +1,179 @@
+#include "profiler.h"
+#include "hal.h"
+#include "json_writer.h"
+#include "scheduler.h"
+
+/* ============================================================
+   STAGES
+   ============================================================ */
+
+struct ProfData{
+  const char* name;
+  uint32_t count;
+  uint64_t sumUs;
+  uint32_t maxUs;
+  uint32_t hist[PROF_BUCKETS];
+};
+
+static ProfData stages[PROF_MAX_STAGES];
+static uint8_t  stageCount = 0;
+static uint32_t cyclesPerUs = 0;
+static uint32_t sinceMs = 0;          // letzter Reset
+static volatile bool resetPending = false;
+
+ProfStage profStage(const char* name)
+{
+  for(uint8_t i = 0; i < stageCount; i++)
+    if(strcmp(stages[i].name, name) == 0) return i;
+
+  if(stageCount >= PROF_MAX_STAGES) return PROF_NONE;
+
+  stages[stageCount].name = name;
+  return stageCount++;
+}
+
+static void doReset()
+{
+  for(uint8_t i = 0; i < stageCount; i++) {
+    const char* n = stages[i].name;
+    stages[i] = {};
+    stages[i].name = n;
+  }
+  schedResetStats();
+  sinceMs = halMillis();
+  resetPending = false;
+}
+
+void profRequestReset()
+{
+  resetPending = true;
+}
+
+static inline uint8_t bucketOf(uint32_t us)
+{
+  uint8_t b = us ? 32 - __builtin_clz(us) : 0;
+  return min<uint8_t>(b, PROF_BUCKETS - 1);
+}
+
+void profRecord(ProfStage s, uint32_t cycles)
+{
+  if(resetPending) doReset();
+  if(s >= stageCount) return;
+
+  if(!cyclesPerUs) cyclesPerUs = max<uint32_t>(halCpuMHz(), 1);
+
+  uint32_t us = cycles / cyclesPerUs;
+  ProfData& d = stages[s];
+
+  d.count++;
+  d.sumUs += us;
+  if(us > d.maxUs) d.maxUs = us;
+  d.hist[bucketOf(us)]++;
+}
+
+/* Obergrenze des Buckets, unter dem 99 % der Messungen liegen */
+static uint32_t p99Us(const ProfData& d)
+{
+  uint32_t over  = d.count / 100;     // erlaubt darüber
+  uint32_t above = 0;
+
+  for(uint8_t b = PROF_BUCKETS - 1; b > 0; b--) {
+    above += d.hist[b];
+    if(above > over)
+      return (b == PROF_BUCKETS - 1) ? d.maxUs : min<uint32_t>(1u << b, d.maxUs);
+  }
+  return min<uint32_t>(1, d.maxUs);
+}
+
+/* ============================================================
+   JSON (gestreamt, ein Fragment pro Aufruf)
+   {"sinceMs":..,"cpuMHz":..,
+    "stages":[{"name","count","meanUs","maxUs","p99Us","hist":[...]},..],
+    "tasks":[{"name","periodMs","runs","overruns","maxLateMs"},..]}
+   hist endet beim letzten belegten Bucket.
+   ============================================================ */
+
+#define PROF_FRAGS_PER_STAGE 3    // Felder, hist erste / zweite Hälfte
+
+static void writeHist(Print& out, const ProfData& d, uint8_t from, uint8_t to)
+{
+  int8_t last = PROF_BUCKETS - 1;
+  while(last > 0 && !d.hist[last]) last--;
+
+  for(int8_t b = from; b < to && b <= last; b++) {
+    if(b) out.write(',');
+    jsonWriteUInt(out, d.hist[b]);
+  }
+}
+
+bool profJsonNext(uint16_t& pos, Print& out)
+{
+  uint16_t stageFrags = stageCount * PROF_FRAGS_PER_STAGE;
+
+  if(pos == 0) {
+    out.write('{');
+    jsonWriteKey(out, "sinceMs", true); jsonWriteUInt(out, halMillis() - sinceMs);
+    jsonWriteKey(out, "cpuMHz");        jsonWriteUInt(out, halCpuMHz());
+    jsonWriteKey(out, "stages");
+    out.write('[');
+    pos++;
+    return true;
+  }
+
+  if(pos <= stageFrags) {
+    uint8_t i = (pos - 1) / PROF_FRAGS_PER_STAGE;
+    const ProfData& d = stages[i];
+
+    switch((pos - 1) % PROF_FRAGS_PER_STAGE) {
+      case 0:
+        if(i) out.write(',');
+        out.write('{');
+        jsonWriteKey(out, "name", true); jsonWriteString(out, d.name);
+        jsonWriteKey(out, "count");      jsonWriteUInt(out, d.count);
+        jsonWriteKey(out, "meanUs");     jsonWriteUInt(out, d.count ? (uint32_t)(d.sumUs / d.count) : 0);
+        jsonWriteKey(out, "maxUs");      jsonWriteUInt(out, d.maxUs);
+        jsonWriteKey(out, "p99Us");      jsonWriteUInt(out, p99Us(d));
+        jsonWriteKey(out, "hist");
+        out.write('[');
+        break;
+      case 1:
+        writeHist(out, d, 0, PROF_BUCKETS / 2);
+        break;
+      default:
+        writeHist(out, d, PROF_BUCKETS / 2, PROF_BUCKETS);
+        out.write(']');
+        out.write('}');
+        break;
+    }
+    pos++;
+    return true;
+  }
+
+  uint16_t t = pos - 1 - stageFrags;
+
+  if(t == 0) {
+    out.write(']');
+    jsonWriteKey(out, "tasks");
+    out.write('[');
+  }
+
+  if(t < schedCount()) {
+    SchedStats s;
+    schedGetStats(t, s);
+
+    if(t) out.write(',');
+    out.write('{');
+    jsonWriteKey(out, "name", true); jsonWriteString(out, s.name);
+    jsonWriteKey(out, "periodMs");   jsonWriteUInt(out, s.periodMs);
+    jsonWriteKey(out, "runs");       jsonWriteUInt(out, s.runs);
+    jsonWriteKey(out, "overruns");   jsonWriteUInt(out, s.overruns);
+    jsonWriteKey(out, "maxLateMs");  jsonWriteUInt(out, s.maxLateMs);
+    out.write('}');
+    pos++;
+    return true;
+  }
+
+  out.write(']');
+  out.write('}');
+  return false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <Arduino.h>
+#include "hal.h"
+
+/* ============================================================
+   PROFILER
+   Laufzeit benannter Abschnitte im loop-Task per Zyklenzähler
+   (halCycles) in log2-Histogramme über Mikrosekunden:
+   Bucket 0 = < 1 µs, Bucket k = [2^(k-1), 2^k) µs, der letzte
+   sammelt alles darüber. Je Abschnitt: Anzahl, Summe, Maximum.
+   Kosten je Messung: zwei Zählerlesungen + ein clz -> bleibt an.
+
+   Nur aus dem loop-Task messen; Reset aus anderen Tasks wird
+   vorgemerkt und bei der nächsten Messung ausgeführt.
+   ============================================================ */
+
+#define PROF_MAX_STAGES 24
+#define PROF_BUCKETS    24     // bis 2^22 µs (~4 s), darüber letzter Bucket
+
+typedef uint8_t ProfStage;
+#define PROF_NONE 0xFF
+
+/* Abschnitt anlegen (auch aus statischer Initialisierung) */
+ProfStage profStage(const char* name);
+
+static inline uint32_t profCycles()
+{
+  return halCycles();
+}
+
+void profRecord(ProfStage s, uint32_t cycles);
+
+/* Reset vormerken (threadsicher) */
+void profRequestReset();
+
+/* gestreamtes JSON für /api/profile; false = letztes Fragment */
+bool profJsonNext(uint16_t& pos, Print& out);
+
+/* misst den umschließenden Block */
+class ProfScope
+{
+public:
+  explicit ProfScope(ProfStage s) : stage(s), t0(profCycles()) {}
+  ~ProfScope() { profRecord(stage, profCycles() - t0); }
+
+private:
+  ProfStage stage;
+  uint32_t  t0;
+};
+
+#define PROF_CAT2(a, b) a##b
+#define PROF_CAT(a, b)  PROF_CAT2(a, b)
+#define PROF_SCOPE(stage) ProfScope PROF_CAT(profScope, __LINE__)(stage)
@@ -0,0 +1,444 @@
+#include "recorder.h"
+#include "flow_meter.h"
+#include "hal.h"
+
+static_assert((REC_RING & (REC_RING - 1)) == 0, "REC_RING muss 2^n sein");
+static_assert(sizeof(RecSettings) < REC_SETTINGS_MAX, "RecSettings zu groß");
+static_assert(1 + 1 + REC_SETTINGS_MAX <= UINT8_MAX, "SETTINGS-Marke passt nicht in emit()");
+
+/* ============================================================
+   STATE
+   Schreiber: ISRs + Tasks unter recMux, Leser: recFlush
+   ============================================================ */
+
+static portMUX_TYPE recMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t           ring[REC_RING];
+static volatile uint16_t rHead = 0, rTail = 0;
+
+static volatile bool recording = false;
+static volatile bool stopRequest = false;
+static uint32_t maxBytes = 0;
+static uint32_t fileBytes = 0;
+static uint32_t lost = 0;          // verworfen, noch nicht als Marke geschrieben
+
+/* Bezugszeit der Delta-Kodierung */
+static uint16_t tickMs  = 10;
+static uint32_t refMs   = 0;
+static uint32_t refUs   = 0;
+static uint32_t tickRun = 0;       // Nenn-Ticks, noch nicht im Ring
+static uint16_t lastCode = 0;
+static bool     flowActive = false;
+
+/* ============================================================
+   KODIERUNG
+   ============================================================ */
+
+static uint8_t IRAM_ATTR putVarint(uint8_t* b, uint32_t v)
+{
+  uint8_t n = 0;
+  while(v >= 0x80) {
+    b[n++] = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  b[n++] = (uint8_t)v;
+  return n;
+}
+
+static uint32_t zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static uint16_t IRAM_ATTR ringFree()
+{
+  return REC_RING - 1 - ((rHead - rTail) & (REC_RING - 1));
+}
+
+static void IRAM_ATTR ringPut(const uint8_t* b, uint8_t n)
+{
+  uint16_t h = rHead;
+  for(uint8_t i = 0; i < n; i++) {
+    ring[h] = b[i];
+    h = (h + 1) & (REC_RING - 1);
+  }
+  rHead = h;
+}
+
+/* ein Ereignis (unter recMux); bei vollem Ring verwerfen und
+   vor dem nächsten passenden eine LOST-Marke setzen */
+static void IRAM_ATTR emitRaw(const uint8_t* b, uint8_t n)
+{
+  if(lost) {
+    uint8_t m[6];
+    m[0] = REC_MARK | (REC_MARK_LOST << 3);
+    uint8_t k = 1 + putVarint(m + 1, lost);
+    if(ringFree() < k + n) {
+      lost++;
+      return;
+    }
+    ringPut(m, k);
+    lost = 0;
+  }
+
+  if(ringFree() < n) {
+    lost++;
+    return;
+  }
+  ringPut(b, n);
+}
+
+/* offene Nenn-Ticks als ein REC_TICK (in Ruhe viele Sekunden lang) */
+static void IRAM_ATTR flushRun()
+{
+  if(!tickRun) return;
+
+  uint8_t b[6];
+  uint8_t n = 1;
+  if(tickRun <= 31) b[0] = REC_TICK | ((tickRun - 1) << 3);
+  else {
+    b[0] = REC_TICK | (31 << 3);
+    n += putVarint(b + 1, tickRun);
+  }
+  tickRun = 0;
+  emitRaw(b, n);
+}
+
+static void IRAM_ATTR emit(const uint8_t* b, uint8_t n)
+{
+  flushRun();
+  emitRaw(b, n);
+}
+
+static void emitMark(RecMark m, const uint8_t* payload = nullptr, uint8_t n = 0)
+{
+  uint8_t b[1 + 1 + REC_SETTINGS_MAX];
+  b[0] = REC_MARK | (m << 3);
+  if(n) memcpy(b + 1, payload, n);
+  emit(b, 1 + n);
+}
+
+/* ============================================================
+   SETTINGS-BLOB
+   ============================================================ */
+
+uint8_t recPackSettings(const Settings& s, uint8_t* out)
+{
+  RecSettings r;
+  r.pulsesPerLiterIn          = s.pulsesPerLiterIn;
+  r.pulsesPerLiterOut         = s.pulsesPerLiterOut;
+  r.tdsLimit                  = s.tdsLimit;
+  r.maxFlushTimeSec           = s.maxFlushTimeSec;
+  r.tdsMaxAllowed             = s.tdsMaxAllowed;
+  r.maxRuntimeAutoSec         = s.maxRuntimeAutoSec;
+  r.maxRuntimeManualSec       = s.maxRuntimeManualSec;
+  r.maxProductionAutoLiters   = s.maxProductionAutoLiters;
+  r.maxProductionManualLiters = s.maxProductionManualLiters;
+  r.prepareTimeSec            = s.prepareTimeSec;
+  r.postFlushTimeSec          = s.postFlushTimeSec;
+  r.autoFlushMinTimeSec       = s.autoFlushMinTimeSec;
+  r.serviceFlushIntervalSec   = s.serviceFlushIntervalSec;
+  r.serviceFlushTimeSec       = s.serviceFlushTimeSec;
+  r.flags = (s.autoFlushEnabled    ? 1 : 0) |
+            (s.postFlushEnabled    ? 2 : 0) |
+            (s.serviceFlushEnabled ? 4 : 0);
+
+  memcpy(out, &r, sizeof(r));
+
+  /* Kalibrier-String, was nicht passt, fällt weg (max. 8 Punkte = kurz) */
+  size_t cal = min(s.tdsCal.length(), (size_t)(REC_SETTINGS_MAX - sizeof(r)));
+  memcpy(out + sizeof(r), s.tdsCal.c_str(), cal);
+  return (uint8_t)(sizeof(r) + cal);
+}
+
+bool recUnpackSettings(const uint8_t* b, uint8_t n, Settings& s)
+{
+  if(n < sizeof(RecSettings)) return false;
+
+  RecSettings r;
+  memcpy(&r, b, sizeof(r));
+  s.pulsesPerLiterIn          = r.pulsesPerLiterIn;
+  s.pulsesPerLiterOut         = r.pulsesPerLiterOut;
+  s.tdsLimit                  = r.tdsLimit;
+  s.maxFlushTimeSec           = r.maxFlushTimeSec;
+  s.tdsMaxAllowed             = r.tdsMaxAllowed;
+  s.maxRuntimeAutoSec         = r.maxRuntimeAutoSec;
+  s.maxRuntimeManualSec       = r.maxRuntimeManualSec;
+  s.maxProductionAutoLiters   = r.maxProductionAutoLiters;
+  s.maxProductionManualLiters = r.maxProductionManualLiters;
+  s.prepareTimeSec            = r.prepareTimeSec;
+  s.postFlushTimeSec          = r.postFlushTimeSec;
+  s.autoFlushMinTimeSec       = r.autoFlushMinTimeSec;
+  s.serviceFlushIntervalSec   = r.serviceFlushIntervalSec;
+  s.serviceFlushTimeSec       = r.serviceFlushTimeSec;
+  s.autoFlushEnabled    = r.flags & 1;
+  s.postFlushEnabled    = r.flags & 2;
+  s.serviceFlushEnabled = r.flags & 4;
+
+  char cal[REC_SETTINGS_MAX + 1];
+  uint8_t k = n - sizeof(r);
+  memcpy(cal, b + sizeof(r), k);
+  cal[k] = 0;
+  s.tdsCal = cal;
+  return true;
+}
+
+/* ============================================================
+   START / STOP
+   ============================================================ */
+
+bool recBegin(uint16_t tick, uint32_t maxB)
+{
+  if(halFs().exists(REC_PATH)) {
+    halFs().remove(REC_PREV_PATH);
+    halFs().rename(REC_PATH, REC_PREV_PATH);
+  }
+
+  /* Platz für die Datei + einen Ring, ohne FS_FREE_MIN_BYTES anzubrechen */
+  uint32_t fsFree = halFsFree();
+  uint32_t room = fsFree > FS_FREE_MIN_BYTES + REC_RING ? fsFree - FS_FREE_MIN_BYTES - REC_RING : 0;
+  if(room < REC_MIN_BYTES) {
+    Serial.printf("[REC] %lu bytes free, not recording\n", (unsigned long)fsFree);
+    return false;
+  }
+  if(maxB > room) maxB = room;
+
+  File f = halFs().open(REC_PATH, "w");
+  if(!f) return false;
+
+  RecHeader h;
+  h.magic   = REC_MAGIC;
+  h.version = REC_VERSION;
+  h.tickMs  = tick;
+  h.epoch   = halEpoch();
+  f.write((const uint8_t*)&h, sizeof(h));
+  f.close();
+
+  tickMs    = tick;
+  maxBytes  = maxB;
+  fileBytes = sizeof(h);
+  rHead = rTail = 0;
+  lost = 0;
+  tickRun = 0;
+  lastCode = 0;
+  flowActive = false;
+  refUs = halMicros();
+  refMs = refUs / 1000;       // beim Booten (< 71 min) == halMillis()
+  recording = true;
+
+  recSettings();
+  return true;
+}
+
+void recRequestStop()
+{
+  stopRequest = true;
+}
+
+bool recActive()
+{
+  return recording;
+}
+
+void recStop()
+{
+  if(!recording) return;
+
+  recLock();
+  emitMark(REC_MARK_END);
+  recording = false;
+  recUnlock();
+
+  recFlush();
+}
+
+/* ============================================================
+   SETUP-MARKEN
+   ============================================================ */
+
+void recInputsInit(const InputDef* defs, uint8_t n, uint8_t activeMask)
+{
+  if(!recording) return;
+
+  uint8_t b[8 + INPUTS_MAX * 3];
+  uint32_t us = halMicros();
+  uint8_t k = putVarint(b, us);
+  n = min(n, (uint8_t)INPUTS_MAX);
+  b[k++] = n;
+  for(uint8_t i = 0; i < n; i++) {
+    b[k++] = defs[i].pin;
+    b[k++] = defs[i].debounceMs & 0xFF;
+    b[k++] = defs[i].debounceMs >> 8;
+  }
+  b[k++] = activeMask;
+
+  recLock();
+  refUs = us;
+  refMs = us / 1000;
+  emitMark(REC_MARK_INPUTS, b, k);
+  recUnlock();
+}
+
+void recCtlInit(uint32_t ms)
+{
+  if(!recording) return;
+
+  uint8_t b[5];
+  recLock();
+  uint8_t k = putVarint(b, ms - refMs);
+  refMs = ms;
+  refUs = ms * 1000;
+  emitMark(REC_MARK_CTL, b, k);
+  recUnlock();
+}
+
+void recSettings()
+{
+  if(!recording) return;
+
+  uint8_t b[1 + REC_SETTINGS_MAX];
+  b[0] = recPackSettings(settings, b + 1);
+
+  recLock();
+  emitMark(REC_MARK_SETTINGS, b, 1 + b[0]);
+  recUnlock();
+}
+
+/* ============================================================
+   CONTROL (unter recLock) / FLOW
+   ============================================================ */
+
+void recLock()   { portENTER_CRITICAL(&recMux); }
+void recUnlock() { portEXIT_CRITICAL(&recMux); }
+
+void recCmd(bool start, bool stop)
+{
+  if(!recording) return;
+
+  uint8_t b;
+  if(start) { b = REC_CMD | (REC_CMD_START << 3); emit(&b, 1); }
+  if(stop)  { b = REC_CMD | (REC_CMD_STOP  << 3); emit(&b, 1); }
+}
+
+void recTick(uint32_t ms)
+{
+  if(!recording) return;
+
+  uint32_t d = ms - refMs;
+  refMs = ms;
+  refUs = ms * 1000;
+
+  if(d == tickMs) {
+    tickRun++;
+    return;
+  }
+
+  uint8_t b[6];
+  b[0] = REC_TICKAT;
+  emit(b, 1 + putVarint(b + 1, d));
+}
+
+void recFlow(uint32_t us)
+{
+  if(!recording) return;
+
+  bool active = flowHz(FLOW_IN) > 0 || flowHz(FLOW_OUT) > 0;
+  if(!active && !flowActive) return;
+  flowActive = active;
+
+  uint8_t b[6];
+  recLock();
+  b[0] = REC_FLOW;
+  emit(b, 1 + putVarint(b + 1, us - refUs));
+  recUnlock();
+}
+
+/* ============================================================
+   ISR
+   ============================================================ */
+
+void IRAM_ATTR recPulse(uint8_t ch, uint32_t us)
+{
+  if(!recording) return;
+
+  uint8_t b[6];
+  portENTER_CRITICAL_ISR(&recMux);
+  b[0] = REC_PULSE | (ch << 3);
+  emit(b, 1 + putVarint(b + 1, us - refUs));
+  portEXIT_CRITICAL_ISR(&recMux);
+}
+
+void IRAM_ATTR recEdge(uint8_t id, bool active, uint32_t ms)
+{
+  if(!recording) return;
+
+  uint8_t b[6];
+  portENTER_CRITICAL_ISR(&recMux);
+  b[0] = REC_EDGE | ((id | (active ? 8 : 0)) << 3);
+  emit(b, 1 + putVarint(b + 1, ms - refMs));
+  portEXIT_CRITICAL_ISR(&recMux);
+}
+
+/* ============================================================
+   TASKS
+   ============================================================ */
+
+void recAdc(uint16_t code)
+{
+  if(!recording || code == lastCode) return;
+
+  uint8_t b[6];
+  b[0] = REC_ADC;
+  uint8_t k = 1 + putVarint(b + 1, zigzag((int32_t)code - lastCode));
+  lastCode = code;
+
+  recLock();
+  emit(b, k);
+  recUnlock();
+}
+
+void recState(uint8_t state, uint8_t act)
+{
+  if(!recording) return;
+
+  uint8_t b[2] = { state, act };
+  recLock();
+  emitMark(REC_MARK_STATE, b, 2);
+  recUnlock();
+}
+
+/* ============================================================
+   FLUSH
+   ============================================================ */
+
+void recFlush()
+{
+  if(stopRequest) {
+    stopRequest = false;
+    recStop();
+    return;
+  }
+  if(!recording && rHead == rTail) return;
+
+  /* offene Tick-Folge bleibt im RAM, sonst zerfiele sie je Flush */
+  recLock();
+  uint16_t head = rHead;
+  recUnlock();
+
+  uint16_t tail = rTail;
+  if(head == tail) return;
+
+  File f = halFs().open(REC_PATH, "a");
+  if(!f) return;
+
+  /* bis zu zwei Stücke (Umlauf) */
+  if(head < tail) {
+    fileBytes += f.write(ring + tail, REC_RING - tail);
+    tail = 0;
+  }
+  fileBytes += f.write(ring + tail, head - tail);
+  f.close();
+  rTail = head;
+
+  if(recording && fileBytes >= maxBytes) recStop();
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <Arduino.h>
+#include "inputs.h"
+#include "settings.h"
+#include "fs_budget.h"
+
+/* ============================================================
+   RECORDER
+   Aufzeichnung der Roh-Eingänge für die Wiedergabe auf dem PC
+   (sim/replay.cpp): Flowmeter-Pulse, Schalter-/Schwimmerflanken,
+   ADC-Codes, Web-Start/Stop sowie die Takte von Control- und
+   Flow-Task – in genau der Reihenfolge, in der die Firmware sie
+   gesehen hat. tdsLookup, flow_meter, inputs und ctlStep laufen
+   damit auf dem PC bitgleich nach.
+
+   - ISRs und Tasks schreiben varint-kodierte Ereignisse in einen
+     RAM-Ring (unter recMux), recFlush hängt ihn an REC_PATH an
+   - Start nur beim Booten (settings.recordInputs), damit alle
+     Module im Init-Zustand beginnen; eine vorhandene Aufzeichnung
+     wird nach REC_PREV_PATH verschoben
+   - Ende bei REC_MAX_BYTES (+ höchstens ein Ring) oder recStop;
+     bei wenig freiem Flash kürzer, unter REC_MIN_BYTES kein Start
+
+   Format (little endian):
+     RecHeader
+     Ereignisse: Tag-Byte (Typ Bit 0..2, Argument Bit 3..7)
+                 + Nutzdaten (varint = LEB128, zz = zigzag)
+   Zeiten sind Abstände zur Bezugszeit ref (letzter Control-Tick
+   bzw. letzte INPUTS/CTL-Marke): ref.ms, ref.us = ref.ms x 1000.
+   ============================================================ */
+
+#define REC_PATH       "/rec.bin"
+#define REC_PREV_PATH  "/rec_prev.bin"
+#define REC_MAGIC      0x4345524F   // "OREC"
+#define REC_VERSION    1
+#define REC_RING       2048         // RAM-Puffer (2^n), reicht für > 5 s Produktion
+#define REC_MAX_BYTES  (FS_REC_BYTES / 2 - REC_RING)
+#define REC_MIN_BYTES  (16UL * 1024)
+#define REC_FLUSH_MS   500
+
+enum RecType : uint8_t {
+  REC_TICK   = 0,   // Control-Ticks je tickMs nach dem vorigen: arg+1, arg 31 = varint Anzahl
+  REC_TICKAT = 1,   // ein Control-Tick: varint ms - ref.ms
+  REC_PULSE  = 2,   // arg = Kanal: varint us - ref.us (auch Glitches)
+  REC_EDGE   = 3,   // arg = id | aktiv<<3: varint ms - ref.ms
+  REC_ADC    = 4,   // varint zz(Code - voriger Code), Sense-Task
+  REC_FLOW   = 5,   // Flow-Task (flowUpdate): varint us - ref.us, nur solange Hz > 0
+  REC_CMD    = 6,   // arg = RecCmd, gilt für den folgenden Tick
+  REC_MARK   = 7,   // arg = RecMark
+};
+
+enum RecCmd : uint8_t { REC_CMD_START = 1, REC_CMD_STOP = 2 };
+
+enum RecMark : uint8_t {
+  REC_MARK_INPUTS   = 0,   // inputsInit: varint us (absolut), u8 n, n x (u8 pin, u16 debounceMs), u8 aktiv-Maske
+  REC_MARK_CTL      = 1,   // ctlInit: varint ms - ref.ms
+  REC_MARK_SETTINGS = 2,   // u8 Länge + RecSettings + tdsCal (ohne 0)
+  REC_MARK_STATE    = 3,   // u8 State, u8 Aktoren: Prüfwert nach Statewechsel
+  REC_MARK_LOST     = 4,   // varint verworfene Ereignisse (Ring voll)
+  REC_MARK_END      = 5,
+};
+
+struct __attribute__((packed)) RecHeader{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t tickMs;           // Nennabstand Control-Tick
+  uint32_t epoch;            // time() beim Start, nur Info (0 = ohne NTP)
+};
+
+/* Controller-relevante Settings (Web-Änderungen mitschreiben) */
+struct __attribute__((packed)) RecSettings{
+  float    pulsesPerLiterIn, pulsesPerLiterOut;
+  float    tdsLimit, maxFlushTimeSec, tdsMaxAllowed;
+  float    maxRuntimeAutoSec, maxRuntimeManualSec;
+  float    maxProductionAutoLiters, maxProductionManualLiters;
+  float    prepareTimeSec, postFlushTimeSec, autoFlushMinTimeSec;
+  uint32_t serviceFlushIntervalSec, serviceFlushTimeSec;
+  uint8_t  flags;            // Bit 0 autoFlush, 1 postFlush, 2 serviceFlush
+};
+
+/* Blob-Länge; Marke + Längenbyte + Blob müssen in einen emit()
+   (uint8_t Länge) passen -> 255 - 2 */
+#define REC_SETTINGS_MAX 253
+
+/* Settings <-> Blob der SETTINGS-Marke; Rückgabe Länge bzw. false */
+uint8_t recPackSettings(const Settings& s, uint8_t* out);
+bool    recUnpackSettings(const uint8_t* b, uint8_t n, Settings& s);
+
+/* setup(), nach settingsLoad: Datei anlegen + Kopf; false = Fehler
+   oder zu wenig Platz (FS_FREE_MIN_BYTES bleibt frei) */
+bool recBegin(uint16_t tickMs, uint32_t maxBytes = REC_MAX_BYTES);
+void recStop();
+void recRequestStop();                 // aus anderen Tasks (Web): Stop beim nächsten recFlush
+bool recActive();
+
+/* Setup-Marken */
+void recInputsInit(const InputDef* defs, uint8_t n, uint8_t activeMask);
+void recCtlInit(uint32_t ms);
+void recSettings();                    // aus settingsLoad
+
+/* Control-Task: Eingänge + Zähler lesen und recCmd/recTick unter
+   einer Sperre, damit die ISR-Ereignisse eindeutig davor oder
+   danach liegen */
+void recLock();
+void recUnlock();
+void recCmd(bool start, bool stop);    // vor recTick
+void recTick(uint32_t ms);
+
+/* Flow-Task, nach flowUpdate(us): wertet nur Pulse bis us aus -> ohne
+   Sperre. Ist die Frequenz vorher und nachher 0, entfällt der Eintrag
+   (die Wiedergabe käme auch auf 0) */
+void recFlow(uint32_t us);
+
+/* ISR */
+void recPulse(uint8_t ch, uint32_t us);
+void recEdge(uint8_t id, bool active, uint32_t ms);
+
+/* Tasks */
+void recAdc(uint16_t code);
+void recState(uint8_t state, uint8_t act);
+
+/* Ring -> Datei (eigener Task, REC_FLUSH_MS) */
+void recFlush();
@@ -0,0 +1,149 @@
+#include "scheduler.h"
+#include "hal.h"
+#include "profiler.h"
+
+/* ============================================================
+   TASK TABLE
+   ============================================================ */
+
+struct SchedTask{
+  SchedFn  fn;
+  uint32_t due;              // nächste Deadline (millis)
+  bool     armed;            // periodisch immer, one-shot bis Auslösung
+  ProfStage prof;
+  SchedStats st;
+};
+
+static SchedTask tasks[SCHED_MAX_TASKS];
+static uint8_t   taskCount = 0;
+
+/* a vor b? (überlaufsicher) */
+static inline bool before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+static SchedId addTask(const char* name, uint32_t periodMs, SchedFn fn)
+{
+  if(taskCount >= SCHED_MAX_TASKS) {
+    Serial.printf("[SCHED] table full, %s dropped\n", name);
+    return -1;
+  }
+
+  SchedTask& t = tasks[taskCount];
+  t = {};
+  t.fn = fn;
+  t.prof = profStage(name);
+  t.st.name     = name;
+  t.st.periodMs = periodMs;
+  return taskCount++;
+}
+
+SchedId schedEvery(const char* name, uint32_t periodMs, SchedFn fn, uint32_t offsetMs)
+{
+  if(periodMs == 0) return -1;
+
+  SchedId id = addTask(name, periodMs, fn);
+  if(id >= 0) {
+    tasks[id].due   = halMillis() + offsetMs;
+    tasks[id].armed = true;
+  }
+  return id;
+}
+
+SchedId schedTimeout(const char* name, SchedFn fn)
+{
+  return addTask(name, 0, fn);
+}
+
+void schedArm(SchedId id, uint32_t delayMs)
+{
+  if(id < 0 || id >= taskCount) return;
+  tasks[id].due   = halMillis() + delayMs;
+  tasks[id].armed = true;
+}
+
+void schedCancel(SchedId id)
+{
+  if(id < 0 || id >= taskCount || tasks[id].st.periodMs) return;
+  tasks[id].armed = false;
+}
+
+bool schedArmed(SchedId id)
+{
+  return id >= 0 && id < taskCount && tasks[id].armed;
+}
+
+void schedRestart(SchedId id)
+{
+  if(id < 0 || id >= taskCount || !tasks[id].st.periodMs) return;
+  tasks[id].due = halMillis() + tasks[id].st.periodMs;
+}
+
+/* ============================================================
+   RUN
+   ============================================================ */
+
+uint32_t schedRun()
+{
+  for(uint8_t i = 0; i < taskCount; i++) {
+    SchedTask& t = tasks[i];
+    uint32_t now = halMillis();
+    if(!t.armed || before(now, t.due)) continue;
+
+    uint32_t late = now - t.due;
+    if(late > t.st.maxLateMs) t.st.maxLateMs = late;
+
+    if(t.st.periodMs) {
+      /* feste Deadlines; ganze verpasste Perioden überspringen */
+      uint32_t missed = late / t.st.periodMs;
+      if(missed) {
+        t.st.overruns += missed;
+        Serial.printf("[SCHED] %s overrun, %lu ms late\n", t.st.name, (unsigned long)late);
+      }
+      t.due += (missed + 1) * t.st.periodMs;
+    } else {
+      t.armed = false;       // vor fn(): darf sich neu scharf schalten
+    }
+
+    uint32_t c0 = profCycles();
+    t.fn();
+    profRecord(t.prof, profCycles() - c0);
+    t.st.runs++;
+  }
+
+  /* Zeit bis zur nächsten Deadline (0 = sofort wieder) */
+  uint32_t now  = halMillis();
+  uint32_t wait = UINT32_MAX;
+
+  for(uint8_t i = 0; i < taskCount; i++) {
+    if(!tasks[i].armed) continue;
+    if(!before(now, tasks[i].due)) return 0;
+    wait = min(wait, tasks[i].due - now);
+  }
+  return wait == UINT32_MAX ? 0 : wait;
+}
+
+/* ============================================================
+   STATS
+   ============================================================ */
+
+uint8_t schedCount()
+{
+  return taskCount;
+}
+
+bool schedGetStats(uint8_t i, SchedStats& out)
+{
+  if(i >= taskCount) return false;
+  out = tasks[i].st;
+  return true;
+}
+
+void schedResetStats()
+{
+  for(uint8_t i = 0; i < taskCount; i++) {
+    SchedStats& s = tasks[i].st;
+    s.runs = s.overruns = s.maxLateMs = 0;
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   SCHEDULER
+   Kooperativ, aus loop(): feste Tabelle von Tasks.
+
+   - periodisch: Deadline läuft fest weiter (due += period), d.h.
+     keine Drift durch Laufzeit oder späten Start.
+   - Overrun: Task startet erst nach Ablauf einer ganzen weiteren
+     Periode -> verpasste Takte werden übersprungen und gezählt.
+   - one-shot: Slot wird einmal angelegt, danach beliebig oft
+     scharf geschaltet / abgebrochen (Timeouts, Entprellung).
+   - Bei gleichzeitig fälligen Tasks gilt die Anlegereihenfolge.
+   - Laufzeit je Task landet im Profiler (Abschnitt = Taskname).
+   ============================================================ */
+
+#define SCHED_MAX_TASKS 16
+
+typedef void (*SchedFn)();
+typedef int8_t SchedId;      // -1 = Tabelle voll
+
+/* periodischer Task, erster Lauf nach offsetMs */
+SchedId schedEvery(const char* name, uint32_t periodMs, SchedFn fn, uint32_t offsetMs = 0);
+
+/* one-shot Slot (nicht scharf) */
+SchedId schedTimeout(const char* name, SchedFn fn);
+
+/* one-shot in delayMs auslösen (erneut: Frist neu) */
+void schedArm(SchedId id, uint32_t delayMs);
+void schedCancel(SchedId id);
+bool schedArmed(SchedId id);
+
+/* periodischen Task neu ausrichten: nächster Lauf in einer Periode */
+void schedRestart(SchedId id);
+
+/* fällige Tasks ausführen; Rückgabe = ms bis zur nächsten Deadline */
+uint32_t schedRun();
+
+struct SchedStats{
+  const char* name;
+  uint32_t periodMs;         // 0 = one-shot
+  uint32_t runs;
+  uint32_t overruns;         // übersprungene Takte
+  uint32_t maxLateMs;        // größte Verspätung gegenüber der Deadline
+};
+
+uint8_t schedCount();
+bool schedGetStats(uint8_t i, SchedStats& out);
+void schedResetStats();
@@ -1,5 +1,8 @@
 #include "settings.h"
 #include "config_settings.h"
+#include "json_writer.h"
+#include "recorder.h"
+#include "tds_cal.h"
 
 Settings settings;
 
@@ -37,6 +40,7 @@ void settingsLoad()
   loadIfExists("tdsLimit",        settings.tdsLimit);
   loadIfExists("maxFlushTimeSec", settings.maxFlushTimeSec);
   loadIfExists("tdsMaxAllowed", settings.tdsMaxAllowed);
+  loadIfExists("tdsCal",        settings.tdsCal);
 
 
   loadIfExists("maxRuntimeAutoSec",   settings.maxRuntimeAutoSec);
@@ -56,6 +60,8 @@ void settingsLoad()
   loadIfExists("serviceFlushIntervalSec", settings.serviceFlushIntervalSec);
   loadIfExists("serviceFlushTimeSec",     settings.serviceFlushTimeSec);
 
+  loadIfExists("recordInputs", settings.recordInputs);
+
   /* System */
   
   loadIfExists("mqttHost", settings.mqttHost);
@@ -65,6 +71,9 @@ void settingsLoad()
 
   loadIfExists("wifiSSID",     settings.wifiSSID);
   loadIfExists("wifiPassword", settings.wifiPassword);
+
+  tdsCalApply(settings.tdsCal.c_str());
+  recSettings();    // laufende Aufzeichnung: neue Grenzwerte mitschreiben
 }
 
 
@@ -82,6 +91,7 @@ void settingsSave()
   configDoc["tdsLimit"]        = settings.tdsLimit;
   configDoc["maxFlushTimeSec"] = settings.maxFlushTimeSec;
   configDoc["tdsMaxAllowed"] = settings.tdsMaxAllowed;
+  configDoc["tdsCal"]        = settings.tdsCal;
 
   configDoc["maxRuntimeAutoSec"]   = settings.maxRuntimeAutoSec;
   configDoc["maxRuntimeManualSec"] = settings.maxRuntimeManualSec;
@@ -98,6 +108,8 @@ void settingsSave()
   configDoc["serviceFlushIntervalSec"] = settings.serviceFlushIntervalSec;
   configDoc["serviceFlushTimeSec"]     = settings.serviceFlushTimeSec;
 
+  configDoc["recordInputs"] = settings.recordInputs;
+
   /* System */
   configDoc["mqttHost"] = settings.mqttHost;
   configDoc["mqttPort"] = settings.mqttPort;
@@ -109,3 +121,92 @@ void settingsSave()
 
   configSave();
 }
+
+
+/* ============================================================
+   JSON (gestreamt für GET /api/settings, ein Feld pro Aufruf)
+   ============================================================ */
+
+enum SettingType : uint8_t { ST_FLOAT, ST_BOOL, ST_U32, ST_U16, ST_STRING };
+
+struct SettingField
+{
+  const char* key;
+  SettingType type;
+  void*       ptr;
+};
+
+static const SettingField settingFields[] = {
+  { "pulsesPerLiterIn",  ST_FLOAT, &settings.pulsesPerLiterIn },
+  { "pulsesPerLiterOut", ST_FLOAT, &settings.pulsesPerLiterOut },
+
+  { "tdsLimit",        ST_FLOAT, &settings.tdsLimit },
+  { "maxFlushTimeSec", ST_FLOAT, &settings.maxFlushTimeSec },
+  { "tdsMaxAllowed",   ST_FLOAT, &settings.tdsMaxAllowed },
+  { "tdsCal",          ST_STRING, &settings.tdsCal },
+
+  { "maxRuntimeAutoSec",   ST_FLOAT, &settings.maxRuntimeAutoSec },
+  { "maxRuntimeManualSec", ST_FLOAT, &settings.maxRuntimeManualSec },
+
+  { "maxProductionAutoLiters",   ST_FLOAT, &settings.maxProductionAutoLiters },
+  { "maxProductionManualLiters", ST_FLOAT, &settings.maxProductionManualLiters },
+
+  { "prepareTimeSec",      ST_FLOAT, &settings.prepareTimeSec },
+  { "autoFlushEnabled",    ST_BOOL,  &settings.autoFlushEnabled },
+  { "postFlushEnabled",    ST_BOOL,  &settings.postFlushEnabled },
+  { "postFlushTimeSec",    ST_FLOAT, &settings.postFlushTimeSec },
+  { "autoFlushMinTimeSec", ST_FLOAT, &settings.autoFlushMinTimeSec },
+
+  { "serviceFlushEnabled",     ST_BOOL, &settings.serviceFlushEnabled },
+  { "serviceFlushIntervalSec", ST_U32,  &settings.serviceFlushIntervalSec },
+  { "serviceFlushTimeSec",     ST_U32,  &settings.serviceFlushTimeSec },
+
+  { "recordInputs", ST_BOOL, &settings.recordInputs },
+
+  { "mqttHost",     ST_STRING, &settings.mqttHost },
+  { "mqttPort",     ST_U16,    &settings.mqttPort },
+  { "mDNSName",     ST_STRING, &settings.mDNSName },
+  { "APPassWord",   ST_STRING, &settings.apPassword },
+  { "wifiSSID",     ST_STRING, &settings.wifiSSID },
+  { "wifiPassword", ST_STRING, &settings.wifiPassword },
+};
+
+#define SETTING_FIELD_COUNT (sizeof(settingFields) / sizeof(settingFields[0]))
+
+bool settingsJsonNext(uint16_t& pos, uint16_t& sub, Print& out)
+{
+  if(pos >= SETTING_FIELD_COUNT) {
+    out.write('}');
+    return false;
+  }
+
+  const SettingField &f = settingFields[pos];
+
+  /* lange Strings (tdsCal, Passwörter) über mehrere Fragmente */
+  if(sub) {
+    if(jsonWriteStringPart(out, ((String*)f.ptr)->c_str(), sub, STREAM_FRAG_MAX)) {
+      sub = 0;
+      pos++;
+    }
+    return true;
+  }
+
+  if(pos == 0) out.write('{');
+  jsonWriteKey(out, f.key, pos == 0);
+
+  switch(f.type) {
+    case ST_FLOAT:  jsonWriteFloat(out, *(float*)f.ptr);              break;
+    case ST_BOOL:   jsonWriteBool(out, *(bool*)f.ptr);                break;
+    case ST_U32:    jsonWriteUInt(out, *(uint32_t*)f.ptr);            break;
+    case ST_U16:    jsonWriteUInt(out, *(uint16_t*)f.ptr);            break;
+    case ST_STRING: {
+      size_t head = (pos == 0) + strlen(f.key) + 4;     // { , "key":
+      if(!jsonWriteStringPart(out, ((String*)f.ptr)->c_str(), sub, STREAM_FRAG_MAX - head))
+        return true;
+      break;
+    }
+  }
+
+  pos++;
+  return true;
+}
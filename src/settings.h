@@ -11,6 +11,7 @@ struct Settings
   float tdsLimit        = DEF_TDS_LIMIT;
   float maxFlushTimeSec = DEF_MAX_FLUSH_TIME_SEC;
   float tdsMaxAllowed   = DEF_TDS_MAX_ALLOWED;
+  String tdsCal         = DEF_TDS_CAL;   // "raw:ppm, ..." (tds_cal.h)
 
   float maxRuntimeAutoSec   = DEF_MAX_RUNTIME_AUTO_SEC;
   float maxRuntimeManualSec = DEF_MAX_RUNTIME_MANUAL_SEC;
@@ -28,6 +29,8 @@ struct Settings
   uint32_t serviceFlushIntervalSec = DEF_SERVICE_FLUSH_INTERVAL_S;
   uint32_t serviceFlushTimeSec     = DEF_SERVICE_FLUSH_TIME_S;
 
+  bool  recordInputs = DEF_RECORD_INPUTS;   // wirkt ab dem nächsten Start
+
   String mqttHost     = DEF_MQTT_HOST;
   uint16_t mqttPort   = DEF_MQTT_PORT;
   String mDNSName     = DEF_MDNS_NAME;
@@ -38,8 +41,13 @@ struct Settings
 
 extern Settings settings;
 
-/* lädt aus configDoc → settings */
+/* lädt aus configDoc → settings (+ TDS-Tabelle neu) */
 void settingsLoad();
 
 /* schreibt settings → configDoc + speichert */
 void settingsSave();
+
+/* GET /api/settings gestreamt: nächstes Feld nach out (höchstens
+   STREAM_FRAG_MAX Bytes, sub = Teil eines langen Strings; beide
+   anfangs 0), false = fertig */
+bool settingsJsonNext(uint16_t& pos, uint16_t& sub, Print& out);
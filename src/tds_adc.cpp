@@ -0,0 +1,171 @@
+#include "tds_adc.h"
+#include <math.h>
+#include <driver/adc.h>
+#include "hal.h"
+
+/* ============================================================
+   STATE
+   ============================================================ */
+
+#define TDS_ADC_DMA_BYTES   1024   // Ringpuffer im Treiber (~128 ms)
+#define TDS_ADC_FRAME_BYTES 128    // je DMA-Interrupt (32 Samples)
+#define TDS_ADC_FALLBACK_N  8      // analogRead je Abholung ohne DMA
+
+static uint8_t  adcPin  = 0;
+static int8_t   adcChan = -1;
+static bool     dmaOn   = false;
+
+static uint16_t group[TDS_ADC_MEDIAN];   // läuft über Abholungen hinweg
+static uint8_t  groupN = 0;
+
+static float    filtered = -1.0f;
+static uint32_t samples = 0, overflows = 0;
+
+/* ============================================================
+   INIT
+   ============================================================ */
+
+static bool dmaInit()
+{
+  if(adcChan < 0) return false;
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = TDS_ADC_DMA_BYTES;
+  init.conv_num_each_intr = TDS_ADC_FRAME_BYTES;
+  init.adc1_chan_mask     = BIT(adcChan);
+  init.adc2_chan_mask     = 0;
+  if(adc_digi_initialize(&init) != ESP_OK) return false;
+
+  static adc_digi_pattern_config_t pattern = {};
+  pattern.atten     = ADC_ATTEN_DB_11;
+  pattern.channel   = adcChan;
+  pattern.unit      = 0;                        // ADC1
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+  adc_digi_configuration_t cfg = {};
+  cfg.conv_limit_en  = false;
+  cfg.conv_limit_num = 250;
+  cfg.pattern_num    = 1;
+  cfg.adc_pattern    = &pattern;
+  cfg.sample_freq_hz = TDS_ADC_RATE_HZ;
+  cfg.conv_mode      = ADC_CONV_SINGLE_UNIT_1;
+  cfg.format         = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+
+  if(adc_digi_controller_configure(&cfg) != ESP_OK || adc_digi_start() != ESP_OK) {
+    adc_digi_deinitialize();
+    return false;
+  }
+  return true;
+}
+
+void tdsAdcInit(uint8_t pin)
+{
+  adcPin  = pin;
+  adcChan = digitalPinToAnalogChannel(pin);
+  groupN  = 0;
+  filtered = -1.0f;
+  samples = overflows = 0;
+
+  dmaOn = dmaInit();
+  Serial.printf("[TDS] ADC %s, ch %d\n", dmaOn ? "DMA" : "analogRead", adcChan);
+}
+
+/* ============================================================
+   FILTER
+   ============================================================ */
+
+static uint16_t median(uint16_t* v, uint8_t n)
+{
+  for(uint8_t i = 1; i < n; i++) {
+    uint16_t x = v[i];
+    int8_t j = i - 1;
+    while(j >= 0 && v[j] > x) { v[j + 1] = v[j]; j--; }
+    v[j + 1] = x;
+  }
+  return v[n / 2];
+}
+
+/* Abholung: Summe der Mediane */
+struct Batch{
+  uint32_t sum;
+  uint16_t medians;
+  uint16_t samples;
+};
+
+static void addSample(Batch& b, uint16_t v)
+{
+  b.samples++;
+  group[groupN++] = v;
+  if(groupN < TDS_ADC_MEDIAN) return;
+
+  b.sum += median(group, TDS_ADC_MEDIAN);
+  b.medians++;
+  groupN = 0;
+}
+
+static void applyBatch(const Batch& b, float rateHz)
+{
+  if(!b.medians) return;
+
+  float mean = (float)b.sum / b.medians;
+
+  if(filtered < 0) {
+    filtered = mean;
+    return;
+  }
+
+  /* exakte Diskretisierung für dt = Samples / Rate */
+  float dt    = b.samples * 1000.0f / rateHz;
+  float alpha = 1.0f - expf(-dt / TDS_ADC_TAU_MS);
+  filtered += alpha * (mean - filtered);
+}
+
+/* ============================================================
+   POLL
+   ============================================================ */
+
+void tdsAdcPoll()
+{
+  Batch b = {};
+
+  if(!dmaOn) {
+    /* Fallback: feste Anzahl Wandlungen je Abholung; dt ist hier
+       nur näherungsweise (Sense-Takt statt Abtastrate) */
+    for(uint8_t i = 0; i < TDS_ADC_FALLBACK_N; i++)
+      addSample(b, halAdcRead(adcPin));
+    samples += b.samples;
+    applyBatch(b, TDS_ADC_FALLBACK_N * 1000.0f / TDS_ADC_POLL_MS);
+    return;
+  }
+
+  uint8_t  buf[TDS_ADC_FRAME_BYTES * 2];
+  uint32_t len = 0;
+
+  for(;;) {
+    esp_err_t r = adc_digi_read_bytes(buf, sizeof(buf), &len, 0);
+    if(r == ESP_ERR_INVALID_STATE) overflows++;      // Daten trotzdem gültig
+    else if(r != ESP_OK) break;
+    if(len == 0) break;
+
+    for(uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t* d = (const adc_digi_output_data_t*)&buf[i];
+      if(d->type2.unit != 0 || d->type2.channel != (uint32_t)adcChan) continue;
+      addSample(b, d->type2.data);
+    }
+  }
+
+  samples += b.samples;
+  applyBatch(b, TDS_ADC_RATE_HZ);
+}
+
+float tdsAdcValue()
+{
+  return filtered;
+}
+
+void tdsAdcGetStats(TdsAdcStats& out)
+{
+  out.dma       = dmaOn;
+  out.samples   = samples;
+  out.overflows = overflows;
+}
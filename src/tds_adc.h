@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   TDS ADC
+   ADC1 im Continuous-/DMA-Modus mit fester Abtastrate; der
+   Sense-Task holt die Samples blockweise ab (nicht blockierend):
+
+     Samples -> Median je TDS_ADC_MEDIAN -> Mittel je Abholung
+             -> IIR 1. Ordnung, Zeitkonstante TDS_ADC_TAU_MS
+
+   Die IIR-Schrittweite kommt aus der Sample-Anzahl, nicht aus der
+   Loop-Zeit -> gleiche Glättung unabhängig von der Last.
+   Schlägt das DMA-Setup fehl, wird per analogRead überabgetastet.
+   ============================================================ */
+
+#define TDS_ADC_RATE_HZ  2000    // Abtastrate (C3: >= 611 Hz)
+#define TDS_ADC_MEDIAN   5       // Samples je Median
+#define TDS_ADC_TAU_MS   1000    // Zeitkonstante des IIR
+#define TDS_ADC_POLL_MS  20      // Abholtakt (Sense-Task in main.cpp)
+
+void tdsAdcInit(uint8_t pin);
+
+/* DMA-Puffer leeren und Filter fortschreiben (aus dem Sense-Task) */
+void tdsAdcPoll();
+
+/* gefilterter Rohwert (ADC-Counts, 12 Bit); < 0 = noch kein Wert */
+float tdsAdcValue();
+
+struct TdsAdcStats{
+  bool     dma;              // false = analogRead-Fallback
+  uint32_t samples;
+  uint32_t overflows;        // DMA-Puffer übergelaufen
+};
+
+void tdsAdcGetStats(TdsAdcStats& out);
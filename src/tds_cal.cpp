@@ -0,0 +1,167 @@
+#include "tds_cal.h"
+#include <array>
+#include <new>
+#include <stdlib.h>
+
+/* ============================================================
+   EINGEBAUTE KENNLINIE (Compile-Zeit)
+   ============================================================ */
+
+typedef std::array<uint16_t, TDS_LUT_SIZE> TdsLut;
+
+static constexpr uint16_t toEntry(float ppm)
+{
+  float e = ppm * TDS_LUT_SCALE + 0.5f;
+  if(e < 0.0f)     return 0;
+  if(e > 65535.0f) return 65535;
+  return (uint16_t)e;
+}
+
+/* Rohwert -> Spannung -> TDS (Sondenkennlinie) */
+static constexpr float builtinPpm(float raw)
+{
+  float v = raw * 3.3f / 4095.0f;
+  return (133.42f*v*v*v - 255.86f*v*v + 857.39f*v) * 0.5f;
+}
+
+static constexpr TdsLut buildBuiltin()
+{
+  TdsLut t = {};
+  for(uint16_t i = 0; i < TDS_LUT_SIZE; i++)
+    t[i] = toEntry(builtinPpm(i));
+  return t;
+}
+
+static constexpr TdsLut builtinLut = buildBuiltin();
+
+static_assert(builtinLut[0] == 0, "TDS LUT: 0 counts -> 0 ppm");
+static_assert(builtinLut[TDS_LUT_SIZE - 1] > builtinLut[TDS_LUT_SIZE / 2], "TDS LUT: Kennlinie steigend");
+
+/* ============================================================
+   STATE
+   Der Web-Handler baut um, der Sense-Task liest: während des
+   Neuaufbaus zeigt lut auf die Flash-Tabelle, der RAM-Puffer
+   wird nie freigegeben.
+   ============================================================ */
+
+static const uint16_t* volatile lut = builtinLut.data();
+static uint16_t* userLut = nullptr;
+
+/* ============================================================
+   PARSER
+   ============================================================ */
+
+struct CalPoint{
+  float raw;
+  float ppm;
+};
+
+/* "raw:ppm" Paare, getrennt durch ',' ';' oder Leerzeichen */
+static int8_t parseSpec(const char* s, CalPoint* pts)
+{
+  uint8_t n = 0;
+
+  for(;;) {
+    while(*s == ' ' || *s == ',' || *s == ';') s++;
+    if(!*s) break;
+    if(n >= TDS_CAL_MAX_POINTS) return -1;
+
+    char* end;
+    float raw = strtof(s, &end);
+    if(end == s || *end != ':') return -1;
+    s = end + 1;
+
+    float ppm = strtof(s, &end);
+    if(end == s) return -1;
+    s = end;
+
+    if(!(raw >= 0.0f && raw < TDS_LUT_SIZE) || !(ppm >= 0.0f)) return -1;
+    pts[n++] = { raw, ppm };
+  }
+
+  /* nach Rohwert sortieren (wenige Punkte -> Insertion Sort) */
+  for(uint8_t i = 1; i < n; i++) {
+    CalPoint p = pts[i];
+    int8_t j = i - 1;
+    while(j >= 0 && pts[j].raw > p.raw) { pts[j + 1] = pts[j]; j--; }
+    pts[j + 1] = p;
+  }
+
+  for(uint8_t i = 1; i < n; i++)
+    if(pts[i].raw - pts[i - 1].raw < 1.0f) return -1;   // doppelte Stützstelle
+
+  return n;
+}
+
+/* ============================================================
+   AUFBAU
+   ============================================================ */
+
+static void buildUser(uint16_t* t, const CalPoint* pts, uint8_t n)
+{
+  if(n == 1) {
+    /* Einpunkt: eingebaute Kennlinie skalieren */
+    float ref  = builtinPpm(pts[0].raw);
+    float gain = ref > 0.0f ? pts[0].ppm / ref : 1.0f;
+    for(uint16_t i = 0; i < TDS_LUT_SIZE; i++)
+      t[i] = toEntry(builtinPpm(i) * gain);
+    return;
+  }
+
+  /* stückweise linear; vor dem ersten / nach dem letzten Punkt
+     mit der Steigung des Randsegments weiter */
+  uint8_t seg = 0;
+  for(uint16_t i = 0; i < TDS_LUT_SIZE; i++) {
+    while(seg + 2 < n && i > pts[seg + 1].raw) seg++;
+
+    const CalPoint& a = pts[seg];
+    const CalPoint& b = pts[seg + 1];
+    float ppm = a.ppm + (i - a.raw) * (b.ppm - a.ppm) / (b.raw - a.raw);
+    t[i] = toEntry(ppm);
+  }
+}
+
+uint8_t tdsCalApply(const char* spec)
+{
+  CalPoint pts[TDS_CAL_MAX_POINTS];
+  int8_t n = parseSpec(spec ? spec : "", pts);
+
+  if(n < 0)
+    Serial.printf("[TDS] calibration '%s' invalid, using built-in curve\n", spec);
+
+  if(n <= 0) {
+    lut = builtinLut.data();
+    return 0;
+  }
+
+  if(!userLut) userLut = new (std::nothrow) uint16_t[TDS_LUT_SIZE];
+  if(!userLut) {
+    Serial.println("[TDS] no memory for calibration table");
+    lut = builtinLut.data();
+    return 0;
+  }
+
+  lut = builtinLut.data();
+  buildUser(userLut, pts, n);
+  lut = userLut;
+
+  Serial.printf("[TDS] calibration: %d point(s)\n", n);
+  return n;
+}
+
+/* ============================================================
+   LOOKUP
+   ============================================================ */
+
+uint16_t tdsCode(float raw)
+{
+  int32_t i = (int32_t)(raw + 0.5f);
+  if(i < 0) i = 0;
+  if(i >= TDS_LUT_SIZE) i = TDS_LUT_SIZE - 1;
+  return (uint16_t)i;
+}
+
+float tdsLookup(float raw)
+{
+  return lut[tdsCode(raw)] / TDS_LUT_SCALE;
+}
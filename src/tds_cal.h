@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   TDS KALIBRIERUNG
+   ADC-Count (12 Bit) -> TDS über eine Tabelle mit 4096 Einträgen
+   (ppm x 10, uint16). Umrechnung = ein Tabellenzugriff.
+
+   - eingebaute Kennlinie (Kubik über die Spannung) wird zur
+     Compile-Zeit erzeugt und liegt im Flash
+   - Kalibrierung aus settings.tdsCal: "raw:ppm, raw:ppm, ..."
+     (2..TDS_CAL_MAX_POINTS Stützpunkte, stückweise linear, an den
+     Enden linear verlängert). Ein einzelner Punkt skaliert die
+     eingebaute Kennlinie. Leer = eingebaute Kennlinie.
+   ============================================================ */
+
+#define TDS_LUT_SIZE        4096
+#define TDS_LUT_SCALE       10.0f    // Tabelleneintrag = ppm x 10
+#define TDS_CAL_MAX_POINTS  8
+
+/* Tabelle aus dem Kalibrier-String neu aufbauen (bei Settings-Änderung);
+   Rückgabe = Anzahl verwendeter Stützpunkte, 0 = eingebaute Kennlinie */
+uint8_t tdsCalApply(const char* spec);
+
+/* gefilterter Rohwert -> Tabellenindex (gerundet, begrenzt);
+   tdsLookup(tdsCode(raw)) == tdsLookup(raw) */
+uint16_t tdsCode(float raw);
+
+/* gefilterter Rohwert (ADC-Counts) -> TDS in ppm */
+float tdsLookup(float raw);
@@ -0,0 +1,556 @@
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+#include "gorilla_codec.h"
+
+/* ============================================================
+   TIERED SERIES ENGINE
+   Mehrkanalige Ringpuffer in mehreren Zeitstufen. Kanäle und
+   Stufen werden zur Compile-Zeit festgelegt:
+
+     struct Channels {
+       static constexpr uint8_t    count = 2;
+       static constexpr ChannelAgg agg[] = { AGG_STATS, AGG_LAST };
+       static constexpr float      scale[] = { 0.1f, 0.01f };
+     };
+     TieredSeries<Channels, TierDef<2,150>, TierDef<30,150>> s;
+
+   - Stufe 0 bekommt jeden Sample als eigenen Bucket.
+   - Jeder geschlossene Bucket wird in die nächste Stufe kaskadiert
+     (secs[t] / secs[t-1] Kind-Buckets ergeben einen Eltern-Bucket),
+     d.h. kein Akku summiert mehr als eine Handvoll Werte.
+   - Summen laufen in double.
+   - Jeder Bucket trägt eine Sequenznummer (1, 2, 3 … je Stufe seit
+     Start) und den Zeitstempel seines Abschlusses (Epoch-Sekunden,
+     0 = Uhr noch nicht gestellt).
+
+   Bucket-Layout: AGG_STATS -> mean, min, max, last (4 floats)
+                  AGG_LAST  -> last (1 float)
+
+   Speicher je Stufe:
+     TierDef<Sec, Count>        Ring mit Count Buckets (roh); Stufe 0
+                                hält nur das Sample (CHANNELS floats),
+                                alle Statistiken eines 1-Sample-Buckets
+                                sind gleich
+     TierDef<Sec, Count, Pool>  Pool Bytes in SERIES_BLOCK-Blöcken,
+                                Gorilla-codiert (gorilla_codec.h).
+                                AGG_LAST-Felder (Zählerstände) werden
+                                verlustfrei gespeichert, die übrigen
+                                auf GORILLA_MANTISSA Bit gerundet.
+                                Ist der Pool voll, wandert der älteste
+                                Block ins Archiv: ein fester Ring mit
+                                Count Einträgen (Zeitstempel, Mittel
+                                je AGG_STATS-Kanal als int16 in
+                                Channels::scale, AGG_LAST als float).
+                                Archiv + Pool halten damit immer
+                                mindestens Count Buckets (untere
+                                Grenze, unabhängig von den Daten);
+                                was der Pool darüber hinaus fasst,
+                                hängt von der Komprimierbarkeit ab.
+                                Archiv-Buckets haben min = max =
+                                last = Mittel.
+   Gelesen wird über scan(): ein Decodierlauf über einen Bereich,
+   ab dem Block des ersten Buckets; read() holt so einen einzelnen
+   Bucket. Lesen ändert keinen Zustand (kein gemeinsamer Cursor).
+   ============================================================ */
+
+#define SERIES_BLOCK 256          // Bytes je komprimiertem Block
+
+enum ChannelAgg : uint8_t {
+  AGG_STATS,      // Mittel / Min / Max / Letzter
+  AGG_LAST        // nur letzter Wert (Zählerstände, Zustände)
+};
+
+enum ChannelStat : uint8_t {
+  STAT_MEAN = 0,  // bei AGG_LAST = letzter Wert
+  STAT_MIN,
+  STAT_MAX,
+  STAT_LAST
+};
+
+template<uint32_t Sec, uint16_t Count, uint16_t Pool = 0>
+struct TierDef{
+  static constexpr uint32_t sec   = Sec;
+  static constexpr uint16_t count = Count;
+  static constexpr uint16_t pool  = Pool;
+};
+
+template<typename Channels, typename... Tiers>
+class TieredSeries
+{
+public:
+  static constexpr uint8_t  CHANNELS = Channels::count;
+  static constexpr uint8_t  TIERS    = sizeof...(Tiers);
+
+  static constexpr uint32_t tierSec[TIERS]   = { Tiers::sec... };
+  static constexpr uint16_t tierCount[TIERS] = { Tiers::count... };
+  static constexpr uint16_t tierPool[TIERS]  = { Tiers::pool... };
+
+  static constexpr uint8_t fieldsOf(uint8_t ch)
+  {
+    return Channels::agg[ch] == AGG_STATS ? 4 : 1;
+  }
+
+  static constexpr uint8_t fieldOffset(uint8_t ch)
+  {
+    uint8_t o = 0;
+    for(uint8_t i = 0; i < ch; i++) o += fieldsOf(i);
+    return o;
+  }
+
+  static constexpr uint8_t FIELDS = fieldOffset(CHANNELS);
+
+  /* Bit k = Feld k verlustfrei (AGG_LAST) */
+  static constexpr uint32_t exactMask()
+  {
+    uint32_t m = 0;
+    for(uint8_t ch = 0; ch < CHANNELS; ch++)
+      if(Channels::agg[ch] == AGG_LAST) m |= 1UL << fieldOffset(ch);
+    return m;
+  }
+
+  static constexpr bool packed(uint8_t t) { return tierPool[t] != 0; }
+
+  static constexpr uint16_t blocksOf(uint8_t t) { return tierPool[t] / SERIES_BLOCK; }
+
+  /* floats je Bucket im rohen Ring */
+  static constexpr uint8_t widthOf(uint8_t t) { return t == 0 ? CHANNELS : FIELDS; }
+
+  /* erster Platz der Stufe in stamp[] */
+  static constexpr uint32_t ringOffset(uint8_t t)
+  {
+    uint32_t o = 0;
+    for(uint8_t i = 0; i < t; i++) o += packed(i) ? 0 : tierCount[i];
+    return o;
+  }
+
+  /* erster float der Stufe in ring[] */
+  static constexpr uint32_t floatOffset(uint8_t t)
+  {
+    uint32_t o = 0;
+    for(uint8_t i = 0; i < t; i++) o += packed(i) ? 0 : (uint32_t)tierCount[i] * widthOf(i);
+    return o;
+  }
+
+  static constexpr uint32_t blockOffset(uint8_t t)
+  {
+    uint32_t o = 0;
+    for(uint8_t i = 0; i < t; i++) o += blocksOf(i);
+    return o;
+  }
+
+  /* erster Eintrag der Stufe in arch[] */
+  static constexpr uint32_t archOffset(uint8_t t)
+  {
+    uint32_t o = 0;
+    for(uint8_t i = 0; i < t; i++) o += packed(i) ? tierCount[i] : 0;
+    return o;
+  }
+
+  /* Archiv-Eintrag: Zeitstempel + int16 je AGG_STATS, float je AGG_LAST */
+  static constexpr uint8_t archBytes()
+  {
+    uint8_t n = 4;
+    for(uint8_t ch = 0; ch < CHANNELS; ch++) n += Channels::agg[ch] == AGG_STATS ? 2 : 4;
+    return n;
+  }
+
+  static constexpr uint32_t TOTAL      = ringOffset(TIERS);
+  static constexpr uint32_t FLOATS     = floatOffset(TIERS);
+  static constexpr uint32_t BLOCKS     = blockOffset(TIERS);
+  static constexpr uint32_t ARCHIVE    = archOffset(TIERS);
+  static constexpr uint8_t  ARCH_BYTES = archBytes();
+
+  static constexpr bool cascades()
+  {
+    for(uint8_t t = 1; t < TIERS; t++)
+      if(tierSec[t] % tierSec[t - 1]) return false;
+    return true;
+  }
+
+  static constexpr bool poolsValid()
+  {
+    for(uint8_t t = 0; t < TIERS; t++) {
+      if(!packed(t)) continue;
+      if(tierPool[t] % SERIES_BLOCK || blocksOf(t) < 2) return false;
+      /* kleinster Bucket: 1 Bit Zeit + 1 Bit je Feld; Länge muss in u16 passen */
+      if((uint32_t)tierPool[t] * 8 / (1 + FIELDS) > 0xFFFF) return false;
+    }
+    return true;
+  }
+
+  static_assert(cascades(), "tier seconds must be multiples of the previous tier");
+  static_assert(poolsValid(), "pool must be >= 2 blocks of SERIES_BLOCK bytes");
+  static_assert(4 + 4 * FIELDS <= SERIES_BLOCK, "first bucket must fit a block");
+  static_assert(FIELDS <= 32, "exact mask holds 32 fields");
+
+  /* Feldindex eines Kanal-Werts im Bucket */
+  static constexpr uint8_t field(uint8_t ch, ChannelStat st)
+  {
+    return fieldOffset(ch) + (Channels::agg[ch] == AGG_STATS ? st : 0);
+  }
+
+  typedef void (*CloseFn)(uint8_t tier, const float* bucket, uint32_t ts);
+
+  /* ------------------------------------------------------------ */
+
+  void clear()
+  {
+    memset(ring, 0, sizeof(ring));
+    memset(head, 0, sizeof(head));
+    memset(stamp, 0, sizeof(stamp));
+    memset(closed, 0, sizeof(closed));
+    memset(acc, 0, sizeof(acc));
+    memset(blk, 0, sizeof(blk));
+    memset(blkN, 0, sizeof(blkN));
+    memset(blkBits, 0, sizeof(blkBits));
+    memset(enc, 0, sizeof(enc));
+    memset(arch, 0, sizeof(arch));
+    memset(archHead, 0, sizeof(archHead));
+    memset(archHeld, 0, sizeof(archHeld));
+  }
+
+  void onClose(CloseFn fn) { closeFn = fn; }
+
+  /* ein Sample pro Kanal (Stufe-0-Takt), ts = Zeitstempel */
+  void add(const float* sample, uint32_t ts)
+  {
+    float b[FIELDS];
+    expand(sample, b);
+    close(0, b, ts);
+  }
+
+  /* Bucket direkt einspielen (Wiederherstellung, ohne Kaskade) */
+  void restore(uint8_t t, const float* b, uint32_t ts)
+  {
+    push(t, b, ts);
+  }
+
+  /* Zugriff: i = 0 ist der älteste Bucket. Rohe Ringe haben immer
+     count = Ringlänge (unbelegte Plätze = 0), komprimierte Stufen
+     nur die vorhandenen Buckets (erst Archiv, dann Pool). */
+  uint16_t count(uint8_t t) const
+  {
+    return packed(t) ? archHeld[t] + blk[t].held : tierCount[t];
+  }
+  uint32_t bucketSec(uint8_t t) const  { return tierSec[t]; }
+
+  /* Sequenznummer des neuesten Buckets (0 = noch keiner) */
+  uint32_t lastSeq(uint8_t t) const    { return closed[t]; }
+
+  /* tatsächlich belegte Plätze */
+  uint16_t filled(uint8_t t) const     { return min<uint32_t>(closed[t], count(t)); }
+
+  /* Sequenznummer von Platz i (nur gültig für belegte Plätze) */
+  uint32_t seqAt(uint8_t t, uint16_t i) const
+  {
+    return closed[t] - count(t) + 1 + i;
+  }
+
+  /* Buckets i0 .. i0+n-1 nacheinander an fn(i, b, ts); b = FIELDS floats */
+  template<typename Fn>
+  void scan(uint8_t t, uint16_t i0, uint16_t n, Fn fn) const
+  {
+    float    b[FIELDS];
+    uint32_t ts;
+    uint16_t end = min<uint32_t>((uint32_t)i0 + n, count(t));
+
+    if(!packed(t)) {
+      for(uint16_t i = i0; i < end; i++) {
+        uint16_t k = (head[t] + i) % tierCount[t];
+        const float* f = ring + floatOffset(t) + (uint32_t)k * widthOf(t);
+        if(t == 0) expand(f, b);
+        else       memcpy(b, f, sizeof(float) * FIELDS);
+        fn(i, (const float*)b, stamp[ringOffset(t) + k]);
+      }
+      return;
+    }
+
+    /* zuerst das Archiv (älteste Buckets) */
+    uint16_t na = archHeld[t];
+    for(uint16_t i = i0; i < min(end, na); i++) {
+      archGet(t, i, b, ts);
+      fn(i, (const float*)b, ts);
+    }
+    if(end <= na) return;
+
+    /* Block mit Bucket i0 suchen, ab dessen Anfang decodieren */
+    uint16_t p0 = max(i0, na) - na, pend = end - na;
+    uint16_t k = 0, base = 0;
+    while(k + 1 < blk[t].used && p0 >= base + bucketsIn(t, k)) base += bucketsIn(t, k++);
+
+    typename Codec::State st = {};
+    BitReader rd;
+    beginBlock(rd, t, k);
+
+    for(uint16_t i = base; i < pend; i++) {
+      if(st.n == bucketsIn(t, k)) {
+        st = {};
+        beginBlock(rd, t, ++k);
+      }
+      Codec::next(rd, st, ts, b);
+      if(i >= p0) fn(na + i, (const float*)b, ts);
+    }
+  }
+
+  /* Bucket i nach b (FIELDS floats), Abschlusszeit nach *ts;
+     i = 0 ist der älteste Bucket, außerhalb -> Nullen */
+  void read(uint8_t t, uint16_t i, float* b, uint32_t* ts = nullptr) const
+  {
+    memset(b, 0, sizeof(float) * FIELDS);
+    if(ts) *ts = 0;
+
+    scan(t, i, 1, [&](uint16_t, const float* v, uint32_t s) {
+      memcpy(b, v, sizeof(float) * FIELDS);
+      if(ts) *ts = s;
+    });
+  }
+
+  /* RAM-Bedarf der Stufe in Byte (Diagnose) */
+  uint32_t usedBytes(uint8_t t) const
+  {
+    if(!packed(t)) return (uint32_t)tierCount[t] * (sizeof(float) * widthOf(t) + 4);
+
+    uint32_t bits = 0;
+    for(uint16_t k = 0; k < blk[t].used; k++)
+      bits += blkBits[blockIndex(t, k)];
+    return (bits + 7) / 8 + (uint32_t)archHeld[t] * ARCH_BYTES;
+  }
+
+  static float value(const float* b, uint8_t ch, ChannelStat st)
+  {
+    return b[field(ch, st)];
+  }
+
+private:
+  typedef GorillaCodec<FIELDS, exactMask()> Codec;
+
+  struct Ring{                      // Blockring einer komprimierten Stufe
+    uint16_t first;                 // ältester Block
+    uint16_t used;                  // belegte Blöcke, der letzte ist offen
+    uint16_t held;                  // Buckets in allen Blöcken
+  };
+
+  struct Acc{
+    double   sum[CHANNELS];
+    float    mn[CHANNELS];
+    float    mx[CHANNELS];
+    float    last[CHANNELS];
+    uint16_t n;
+  };
+
+  /* Sample -> Bucket (alle Statistiken = Sample) */
+  static void expand(const float* sample, float* b)
+  {
+    for(uint8_t ch = 0; ch < CHANNELS; ch++) {
+      float* f = b + fieldOffset(ch);
+      for(uint8_t k = 0; k < fieldsOf(ch); k++) f[k] = sample[ch];
+    }
+  }
+
+  uint8_t* blockData(uint8_t t, uint16_t slot)
+  {
+    return pool + (blockOffset(t) + slot) * SERIES_BLOCK;
+  }
+
+  void pushPacked(uint8_t t, const float* b, uint32_t ts)
+  {
+    Ring& r = blk[t];
+    BitWriter w;
+
+    if(r.used) {
+      uint16_t slot = (r.first + r.used - 1) % blocksOf(t);
+      w.begin(blockData(t, slot), SERIES_BLOCK);
+      w.pos = blkBits[blockOffset(t) + slot];
+
+      if(Codec::append(w, enc[t], ts, b)) {
+        blkN[blockOffset(t) + slot] = enc[t].n;
+        blkBits[blockOffset(t) + slot] = w.pos;
+        r.held++;
+        return;
+      }
+    }
+
+    /* neuer Block; bei vollem Pool geht der älteste ins Archiv */
+    if(r.used == blocksOf(t)) {
+      archiveBlock(t, r.first);
+      r.held -= blkN[blockOffset(t) + r.first];
+      r.first = (r.first + 1) % blocksOf(t);
+      r.used--;
+    }
+
+    uint16_t slot = (r.first + r.used) % blocksOf(t);
+    r.used++;
+
+    enc[t] = {};
+    w.begin(blockData(t, slot), SERIES_BLOCK);
+    Codec::append(w, enc[t], ts, b);
+
+    blkN[blockOffset(t) + slot] = enc[t].n;
+    blkBits[blockOffset(t) + slot] = w.pos;
+    r.held++;
+  }
+
+  /* Mittel auf die Kanal-Auflösung, INT16_MIN = NaN */
+  static int16_t toFixed(float v, float scale)
+  {
+    if(isnan(v)) return INT16_MIN;
+    float q = roundf(v / scale);
+    return (int16_t)constrain(q, -32767.0f, 32767.0f);
+  }
+
+  void archPut(uint8_t t, const float* b, uint32_t ts)
+  {
+    uint8_t* p = arch + (archOffset(t) + archHead[t]) * ARCH_BYTES;
+    memcpy(p, &ts, 4);
+    p += 4;
+    for(uint8_t ch = 0; ch < CHANNELS; ch++) {
+      if(Channels::agg[ch] == AGG_STATS) {
+        int16_t q = toFixed(value(b, ch, STAT_MEAN), Channels::scale[ch]);
+        memcpy(p, &q, 2);
+        p += 2;
+      } else {
+        memcpy(p, b + fieldOffset(ch), 4);
+        p += 4;
+      }
+    }
+    archHead[t] = (archHead[t] + 1) % tierCount[t];
+    if(archHeld[t] < tierCount[t]) archHeld[t]++;
+  }
+
+  /* Archiv-Bucket i (0 = ältester) -> b, ts */
+  void archGet(uint8_t t, uint16_t i, float* b, uint32_t& ts) const
+  {
+    uint16_t k = (archHead[t] + tierCount[t] - archHeld[t] + i) % tierCount[t];
+    const uint8_t* p = arch + (archOffset(t) + k) * ARCH_BYTES;
+    memcpy(&ts, p, 4);
+    p += 4;
+    for(uint8_t ch = 0; ch < CHANNELS; ch++) {
+      float* f = b + fieldOffset(ch);
+      if(Channels::agg[ch] == AGG_STATS) {
+        int16_t q;
+        memcpy(&q, p, 2);
+        p += 2;
+        float v = q == INT16_MIN ? NAN : q * Channels::scale[ch];
+        for(uint8_t j = 0; j < 4; j++) f[j] = v;
+      } else {
+        memcpy(f, p, 4);
+        p += 4;
+      }
+    }
+  }
+
+  /* Block am Pool-Platz slot decodieren und ins Archiv schieben */
+  void archiveBlock(uint8_t t, uint16_t slot)
+  {
+    uint16_t x = blockOffset(t) + slot;
+    typename Codec::State st = {};
+    BitReader rd;
+    rd.begin(pool + (uint32_t)x * SERIES_BLOCK, blkBits[x]);
+
+    float    b[FIELDS];
+    uint32_t ts;
+    for(uint16_t i = 0; i < blkN[x]; i++) {
+      Codec::next(rd, st, ts, b);
+      archPut(t, b, ts);
+    }
+  }
+
+  /* k-ter belegter Block der Stufe (0 = ältester) */
+  uint16_t blockIndex(uint8_t t, uint16_t k) const
+  {
+    return blockOffset(t) + (blk[t].first + k) % blocksOf(t);
+  }
+
+  uint16_t bucketsIn(uint8_t t, uint16_t k) const { return blkN[blockIndex(t, k)]; }
+
+  void beginBlock(BitReader& rd, uint8_t t, uint16_t k) const
+  {
+    uint16_t x = blockIndex(t, k);
+    rd.begin(pool + (uint32_t)x * SERIES_BLOCK, blkBits[x]);
+  }
+
+  void push(uint8_t t, const float* b, uint32_t ts)
+  {
+    if(packed(t)) {
+      pushPacked(t, b, ts);
+      closed[t]++;
+      return;
+    }
+
+    float* f = ring + floatOffset(t) + (uint32_t)head[t] * widthOf(t);
+    if(t == 0) {
+      for(uint8_t ch = 0; ch < CHANNELS; ch++) f[ch] = value(b, ch, STAT_LAST);
+    } else {
+      memcpy(f, b, sizeof(float) * FIELDS);
+    }
+    stamp[ringOffset(t) + head[t]] = ts;
+    head[t] = (head[t] + 1) % tierCount[t];
+    closed[t]++;
+  }
+
+  void close(uint8_t t, const float* b, uint32_t ts)
+  {
+    push(t, b, ts);
+    if(closeFn) closeFn(t, b, ts);
+
+    if(t + 1 >= TIERS) return;
+
+    /* --- in die nächste Stufe falten --- */
+    Acc& a = acc[t + 1];
+
+    for(uint8_t ch = 0; ch < CHANNELS; ch++) {
+      float mean = value(b, ch, STAT_MEAN);
+      float mn   = value(b, ch, STAT_MIN);
+      float mx   = value(b, ch, STAT_MAX);
+
+      if(a.n == 0) {
+        a.mn[ch] = mn;
+        a.mx[ch] = mx;
+      } else {
+        a.mn[ch] = min(a.mn[ch], mn);
+        a.mx[ch] = max(a.mx[ch], mx);
+      }
+      a.sum[ch] += mean;
+      a.last[ch] = value(b, ch, STAT_LAST);
+    }
+
+    if(++a.n < tierSec[t + 1] / tierSec[t]) return;
+
+    float nb[FIELDS];
+
+    for(uint8_t ch = 0; ch < CHANNELS; ch++) {
+      float* f = nb + fieldOffset(ch);
+      if(Channels::agg[ch] == AGG_STATS) {
+        f[STAT_MEAN] = (float)(a.sum[ch] / a.n);
+        f[STAT_MIN]  = a.mn[ch];
+        f[STAT_MAX]  = a.mx[ch];
+        f[STAT_LAST] = a.last[ch];
+      } else {
+        f[0] = a.last[ch];
+      }
+    }
+
+    a = {};
+    close(t + 1, nb, ts);
+  }
+
+  float    ring[FLOATS ? FLOATS : 1];
+  uint32_t stamp[TOTAL ? TOTAL : 1];   // Abschlusszeit je Bucket
+  uint16_t head[TIERS];             // nächster Schreibplatz = ältester Bucket
+  uint32_t closed[TIERS];           // geschlossene Buckets seit Start
+  Acc      acc[TIERS];              // acc[0] unbenutzt
+  CloseFn  closeFn = nullptr;
+
+  /* komprimierte Stufen (Einträge roher Stufen bleiben leer) */
+  uint8_t  pool[BLOCKS ? BLOCKS * SERIES_BLOCK : 1];
+  uint16_t blkN[BLOCKS ? BLOCKS : 1];      // Buckets je Block
+  uint16_t blkBits[BLOCKS ? BLOCKS : 1];   // belegte Bits je Block
+  Ring     blk[TIERS];
+  typename Codec::State enc[TIERS];        // Encoder des offenen Blocks
+
+  /* Archiv der komprimierten Stufen: Count Einträge je Stufe */
+  uint8_t  arch[ARCHIVE ? ARCHIVE * ARCH_BYTES : 1];
+  uint16_t archHead[TIERS];                // nächster Schreibplatz
+  uint16_t archHeld[TIERS];                // belegte Einträge
+};
@@ -0,0 +1,229 @@
+#include "totals.h"
+#include <math.h>
+#include "hal.h"
+#include "settings.h"
+#include "json_writer.h"
+#include "logstore.h"
+
+/* ============================================================
+   STATE
+   Impulse laufen als Delta seit dem letzten Falten in die
+   Rollups ein; Liter = Impulse / pulsesPerLiter zum Zeitpunkt
+   des Faltens.
+   ============================================================ */
+
+enum Period : uint8_t { P_DAY, P_WEEK, P_MONTH, P_COUNT };
+
+struct Rollup{
+  uint32_t key;            // yyyymmdd / yyyyww (ISO) / yyyymm, 0 = leer
+  float    litersOut;
+  float    litersIn;
+  uint16_t runs;
+  uint16_t tdsN;
+  float    tdsMean;
+  float    tdsMax;
+};
+
+struct TotalsState{
+  uint64_t pulsesOut;
+  uint64_t pulsesIn;
+  uint32_t runs;
+  uint32_t rsv;
+  Rollup   cur[P_COUNT];
+  Rollup   prev[P_COUNT];
+};
+
+static TotalsState st;
+
+static uint32_t seenOut = 0, seenIn = 0;       // letzte ISR-Zählerstände
+static uint32_t foldOut = 0, foldIn = 0;       // bis hier eingerechnet
+
+/* ============================================================
+   PERSISTENZ
+   Ganzer Zustand als ein Record; der letzte gewinnt. LogStore
+   rotiert über die Segmente -> Schreiblast verteilt sich.
+   Geschrieben nur bei Laufende und über totalsSave().
+   ============================================================ */
+
+#define TOTALS_LOG_FORMAT 1
+#define TOTALS_REC_STATE  1
+
+static_assert(sizeof(TotalsState) <= LOG_MAX_PAYLOAD, "totals record too large");
+
+static LogStore totalsLog("/tot", 2,
+  LogStore::segmentBytesFor(32, sizeof(TotalsState)), TOTALS_LOG_FORMAT);
+
+static void onTotalsRecord(uint8_t type, uint32_t, const uint8_t* data, uint8_t len, void*)
+{
+  if(type == TOTALS_REC_STATE && len == sizeof(TotalsState))
+    memcpy(&st, data, sizeof(st));
+}
+
+void totalsSave()
+{
+  totalsLog.append(TOTALS_REC_STATE, &st, sizeof(st));
+}
+
+void totalsInit()
+{
+  memset(&st, 0, sizeof(st));
+  totalsLog.replay(onTotalsRecord, nullptr);
+
+  seenOut = foldOut = 0;
+  seenIn  = foldIn  = 0;
+}
+
+/* ============================================================
+   ROLLUPS
+   ============================================================ */
+
+static uint32_t periodKey(Period p, uint32_t ts)
+{
+  time_t t = ts;
+  struct tm tm;
+  localtime_r(&t, &tm);
+
+  char buf[12];
+  switch(p) {
+    case P_DAY:   strftime(buf, sizeof(buf), "%Y%m%d", &tm); break;
+    case P_WEEK:  strftime(buf, sizeof(buf), "%G%V", &tm);   break;
+    default:      strftime(buf, sizeof(buf), "%Y%m", &tm);   break;
+  }
+  return strtoul(buf, nullptr, 10);
+}
+
+/* Rollup der Periode von ts; Periodenwechsel schiebt cur -> prev */
+static Rollup* rollupFor(Period p, uint32_t ts)
+{
+  if(ts < TIME_VALID_MIN) return nullptr;
+
+  uint32_t key = periodKey(p, ts);
+  Rollup& c = st.cur[p];
+
+  if(c.key != key) {
+    if(c.key) st.prev[p] = c;
+    c = {};
+    c.key = key;
+  }
+  return &c;
+}
+
+/* Impulse seit dem letzten Falten in Lebensdauer + Rollups übernehmen */
+static void foldPulses(uint32_t ts)
+{
+  uint32_t dOut = seenOut - foldOut;
+  uint32_t dIn  = seenIn  - foldIn;
+  foldOut = seenOut;
+  foldIn  = seenIn;
+
+  st.pulsesOut += dOut;
+  st.pulsesIn  += dIn;
+
+  float lOut = settings.pulsesPerLiterOut > 0 ? dOut / settings.pulsesPerLiterOut : 0;
+  float lIn  = settings.pulsesPerLiterIn  > 0 ? dIn  / settings.pulsesPerLiterIn  : 0;
+
+  for(uint8_t p = 0; p < P_COUNT; p++) {
+    Rollup* r = rollupFor((Period)p, ts);
+    if(!r) continue;
+    r->litersOut += lOut;
+    r->litersIn  += lIn;
+  }
+}
+
+void totalsUpdatePulses(uint32_t cntOut, uint32_t cntIn)
+{
+  seenOut = cntOut;
+  seenIn  = cntIn;
+}
+
+void totalsOnRunEnd(uint32_t ts)
+{
+  foldPulses(ts);
+  st.runs++;
+
+  for(uint8_t p = 0; p < P_COUNT; p++) {
+    Rollup* r = rollupFor((Period)p, ts);
+    if(r) r->runs++;
+  }
+
+  totalsSave();
+}
+
+void totalsOnBucket(uint32_t ts, float tdsMean, float tdsMax)
+{
+  foldPulses(ts);
+
+  if(isfinite(tdsMean)) {
+    for(uint8_t p = 0; p < P_COUNT; p++) {
+      Rollup* r = rollupFor((Period)p, ts);
+      if(!r || r->tdsN == 0xFFFF) continue;
+
+      r->tdsN++;
+      r->tdsMean += (tdsMean - r->tdsMean) / r->tdsN;
+      if(r->tdsN == 1 || tdsMax > r->tdsMax) r->tdsMax = tdsMax;
+    }
+  }
+}
+
+/* ============================================================
+   JSON (ein Objekt pro Aufruf)
+   {"lifetime":{...},"day":{...},"dayPrev":{...},"week":...}
+   ============================================================ */
+
+static void writeU64(Print& out, uint64_t v)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%llu", (unsigned long long)v);
+  out.print(buf);
+}
+
+static void writeRollup(Print& out, const Rollup& r)
+{
+  out.write('{');
+  jsonWriteKey(out, "key", true);   jsonWriteUInt(out, r.key);
+  jsonWriteKey(out, "litersOut");   jsonWriteFloat(out, r.litersOut);
+  jsonWriteKey(out, "litersIn");    jsonWriteFloat(out, r.litersIn);
+  jsonWriteKey(out, "runs");        jsonWriteUInt(out, r.runs);
+  jsonWriteKey(out, "tdsMean");     jsonWriteFloat(out, r.tdsN ? r.tdsMean : NAN, 5);
+  jsonWriteKey(out, "tdsMax");      jsonWriteFloat(out, r.tdsN ? r.tdsMax : NAN, 5);
+  out.write('}');
+}
+
+bool totalsJsonNext(uint16_t& pos, Print& out)
+{
+  static const char* const names[P_COUNT * 2] = {
+    "day", "dayPrev", "week", "weekPrev", "month", "monthPrev"
+  };
+
+  /* noch nicht gefaltete Impulse mitzählen, ohne Zustand zu ändern */
+  uint64_t pOut = st.pulsesOut + (seenOut - foldOut);
+  uint64_t pIn  = st.pulsesIn  + (seenIn  - foldIn);
+
+  if(pos == 0) {
+    out.write('{');
+    jsonWriteKey(out, "lifetime", true);
+    out.write('{');
+    jsonWriteKey(out, "pulsesOut", true); writeU64(out, pOut);
+    jsonWriteKey(out, "pulsesIn");        writeU64(out, pIn);
+    jsonWriteKey(out, "litersOut");
+    jsonWriteFloat(out, settings.pulsesPerLiterOut > 0 ? (double)pOut / settings.pulsesPerLiterOut : 0);
+    jsonWriteKey(out, "litersIn");
+    jsonWriteFloat(out, settings.pulsesPerLiterIn > 0 ? (double)pIn / settings.pulsesPerLiterIn : 0);
+    jsonWriteKey(out, "runs");            jsonWriteUInt(out, st.runs);
+    out.write('}');
+    pos++;
+    return true;
+  }
+
+  if(pos > P_COUNT * 2) {
+    out.write('}');
+    return false;
+  }
+
+  uint8_t  i = pos - 1;
+  Period   p = (Period)(i / 2);
+  jsonWriteKey(out, names[i]);
+  writeRollup(out, (i & 1) ? st.prev[p] : st.cur[p]);
+  pos++;
+  return true;
+}
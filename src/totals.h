@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   TOTALS
+   Lebensdauer-Zähler (Impulse Ein/Aus, Läufe) und Kalender-
+   Rollups (Tag / Woche / Monat, jeweils aktuell + vorherig).
+   Alles inkrementell fortgeschrieben, Ausgabe in O(1).
+   ============================================================ */
+
+void totalsInit();
+
+/* aktuelle ISR-Zähler aus loop() (nur RAM, billig) */
+void totalsUpdatePulses(uint32_t cntOut, uint32_t cntIn);
+
+/* aus history.cpp: Lauf beendet */
+void totalsOnRunEnd(uint32_t ts);
+
+/* aus history.cpp: 600-s-Bucket abgeschlossen (Mittel/Max TDS) */
+void totalsOnBucket(uint32_t ts, float tdsMean, float tdsMax);
+
+/* Stand sichern (history.cpp: bei jedem 21600-s-Bucket) */
+void totalsSave();
+
+/* gestreamtes JSON für /api/stats; false = letztes Fragment */
+bool totalsJsonNext(uint16_t& pos, Print& out);
@@ -6,23 +6,33 @@
 #include <ArduinoJson.h>
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <new>
+#include <functional>
 #include <Update.h>
 
 
 #include "history.h"
+#include "json_writer.h"
+#include "flow_meter.h"
+#include "hal.h"
+#include "profiler.h"
+#include "recorder.h"
 #include "config_settings.h"
 #include "settings.h"
+#include "totals.h"
+#include "ws_status.h"
 
 extern String lastErrorMsg;
 
 bool webStartRequest=false;
 bool webStopRequest=false;
+volatile uint16_t webRebootMs=0;
 static String webStatusLine = "";
 
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
 
-static uint32_t lastSend=0;
 
 void webSetStatus(const char* s)
 {
@@ -46,6 +56,15 @@ void webNotifyHistoryUpdate()
   ws.textAll("{\"histUpdate\":1}");
 }
 
+/* ============================================================
+   Abgeschlossener History-Bucket -> an alle WS-Clients,
+   damit das Diagramm ohne Neuladen nachzieht
+   ============================================================ */
+
+#define WS_BUCKET_MSG_MAX 512
+
+static void onHistoryBucket(HistorySeries s);
+
 /* ============================================================ */
 static void addNoCache(AsyncWebServerResponse *r)
 {
@@ -55,7 +74,76 @@ static void addNoCache(AsyncWebServerResponse *r)
 }
 
 
+/* ============================================================
+   GESTREAMTE ANTWORTEN
+   Producer schreibt pro Aufruf ein kleines Fragment (<= STREAM_FRAG_MAX,
+   json_writer.h) in einen festen Puffer; der Chunked-Filler kopiert
+   daraus direkt in den TCP-Puffer. Kein Dokument, kein String.
+   Ein zu großes Fragment bricht die Antwort ab (kein halbes Feld).
+   ============================================================ */
+
+typedef std::function<bool(Print& out)> StreamProducer;  // false = letztes Fragment
+
+typedef FixedPrint<STREAM_FRAG_MAX> FragBuf;
+
+struct StreamState
+{
+  StreamProducer next;
+  FragBuf frag;
+  bool done = false;
+};
+
+/* len = 0: Chunked, sonst feste Länge (Content-Length) */
+static AsyncWebServerResponse* beginStreamed(AsyncWebServerRequest *req, const char* contentType,
+                                             StreamProducer next, size_t len = 0)
+{
+  std::shared_ptr<StreamState> st = std::make_shared<StreamState>();
+  st->next = next;
+
+  AwsResponseFiller fill =
+    [st](uint8_t *buf, size_t maxLen, size_t) -> size_t
+    {
+      size_t n = 0;
+
+      while(n < maxLen) {
+        FragBuf &f = st->frag;
+
+        if(f.pos >= f.len) {
+          if(st->done) break;
+          f.reset();
+          st->done = !st->next(f);
+          if(f.overflow) {
+            Serial.printf("[WEB] fragment over %u bytes, response cut\n", (unsigned)STREAM_FRAG_MAX);
+            f.len = 0;
+            st->done = true;
+          }
+          continue;
+        }
+
+        size_t k = min(maxLen - n, f.len - f.pos);
+        memcpy(buf + n, f.buf + f.pos, k);
+        f.pos += k;
+        n += k;
+      }
+      return n;     // 0 = Ende
+    };
+
+  AsyncWebServerResponse *r = len ? req->beginResponse(contentType, len, fill)
+                                  : req->beginChunkedResponse(contentType, fill);
+  addNoCache(r);
+  return r;
+}
+
+static void sendStreamed(AsyncWebServerRequest *req, const char* contentType,
+                         StreamProducer next)
+{
+  req->send(beginStreamed(req, contentType, next));
+}
+
+
 /* ============================================================ */
+static const ProfStage profWsBroadcast = profStage("wsBroadcast");
+
 static void wsBroadcast(float tds,
                         const char* stateName,
                         const char* modeName,
@@ -67,27 +155,23 @@ static void wsBroadcast(float tds,
                         const char* espVersion)   
 
 {
-  JsonDocument doc;
-
-  doc["state"]=stateName;
-  doc["mode"]=modeName;
-  doc["error"]=lastErrorMsg;
-  doc["tds"]=tds;
-  doc["liters"]=litersNow;
-  doc["flow"]=flowLpm;
-  doc["left"]=litersLeft;
-  doc["timeLeft"] = runtimeLeft;
-  doc["espVersion"] = espVersion;
-  doc["flowIn"] = currentFlowInLpm;
-
-  if(webStatusLine.length())
-    doc["status"] = webStatusLine;
-  else
-    doc["status"] = "Hä?"; 
-
+  PROF_SCOPE(profWsBroadcast);
+
+  WsStatus st;
+  st.state      = stateName;
+  st.mode       = modeName;
+  st.error      = lastErrorMsg.c_str();
+  st.tds        = tds;
+  st.liters     = litersNow;
+  st.flow       = flowLpm;
+  st.left       = litersLeft;
+  st.timeLeft   = runtimeLeft;
+  st.espVersion = espVersion;
+  st.flowIn     = currentFlowInLpm;
+  st.status     = webStatusLine.c_str();
 
   String s;
-  serializeJson(doc,s);
+  wsStatusJson(st, s);
 
   ws.textAll(s);
 }
@@ -146,6 +230,109 @@ setInterval(()=>{
 </html>
 )rawliteral";
 
+/* ============================================================ */
+static void onHistoryBucket(HistorySeries s)
+{
+  if(ws.count() == 0) return;
+
+  FixedPrint<WS_BUCKET_MSG_MAX> msg;
+  historyWriteLastBucketJson(s, msg);
+  ws.textAll((const char*)msg.buf, msg.len);
+}
+
+/* ============================================================ */
+static bool parseSeriesParam(AsyncWebServerRequest *req, HistorySeries &type)
+{
+  if(!req->hasParam("series")) {
+    req->send(400, "text/plain", "missing series");
+    return false;
+  }
+
+  if(!historySeriesByName(req->getParam("series")->value().c_str(), type)) {
+    req->send(400, "text/plain", "invalid series");
+    return false;
+  }
+  return true;
+}
+
+/* from/to in Epoch s; Werte <= 0 relativ zu jetzt (from=-86400),
+   nach unten bei 0 begrenzt (vor NTP ist now klein) */
+static bool parseTimeParam(AsyncWebServerRequest *req, const char* name, uint32_t now, uint32_t &v)
+{
+  if(!req->hasParam(name)) return false;
+
+  long x = req->getParam(name)->value().toInt();
+  if(x > 0) {
+    v = (uint32_t)x;
+  } else {
+    uint32_t back = 0UL - (unsigned long)x;
+    v = back < now ? now - back : 0;
+  }
+  return true;
+}
+
+static bool parseSeriesSelection(AsyncWebServerRequest *req, HistorySelection &sel)
+{
+  bool stats = req->hasParam("stats") && req->getParam("stats")->value() != "0";
+
+  uint16_t points = 0;
+  const char* pointsKey = req->hasParam("maxPoints") ? "maxPoints" : "points";
+  if(req->hasParam(pointsKey))
+    points = constrain(req->getParam(pointsKey)->value().toInt(), 0, HIST_MAX_POINTS);
+
+  /* Zeitbereich statt fester Stufe */
+  if(!req->hasParam("series") && (req->hasParam("from") || req->hasParam("to"))) {
+    /* ohne NTP tragen die Buckets ts = 0 -> kein Zeitbereich möglich */
+    uint32_t now = halEpoch();
+    if(now < TIME_VALID_MIN) {
+      req->send(503, "text/plain", "time not synced");
+      return false;
+    }
+
+    uint32_t from = 0, to = now;
+    parseTimeParam(req, "from", now, from);
+    parseTimeParam(req, "to", now, to);
+
+    if(!historySelectRange(from, to, stats, points, sel)) {
+      req->send(404, "text/plain", "no data in range");
+      return false;
+    }
+    return true;
+  }
+
+  HistorySeries type;
+  if(!parseSeriesParam(req, type)) return false;
+
+  /* since nur gültig, wenn der Client denselben Boot gesehen hat */
+  uint32_t since = 0;
+  if(req->hasParam("since")) {
+    uint32_t boot = req->hasParam("boot")
+                  ? strtoul(req->getParam("boot")->value().c_str(), nullptr, 10) : 0;
+    if(boot == historyBootId())
+      since = strtoul(req->getParam("since")->value().c_str(), nullptr, 10);
+  }
+
+  historySelect(type, stats, points, since, sel);
+  return true;
+}
+
+static void parseTableQuery(AsyncWebServerRequest *req, HistoryTableQuery &q)
+{
+  if(req->hasParam("offset"))
+    q.offset = constrain(req->getParam("offset")->value().toInt(), 0, 0xFFFF);
+  if(req->hasParam("limit"))
+    q.limit  = constrain(req->getParam("limit")->value().toInt(), 0, 0xFFFF);
+
+  if(req->hasParam("mode"))
+    strncpy(q.mode, req->getParam("mode")->value().c_str(), sizeof(q.mode) - 1);
+  if(req->hasParam("reason"))
+    strncpy(q.reason, req->getParam("reason")->value().c_str(), sizeof(q.reason) - 1);
+
+  uint32_t now = halEpoch();
+  parseTimeParam(req, "from", now, q.from);
+  parseTimeParam(req, "to", now, q.to);
+}
+
 /* ============================================================ */
 void webInit()
 {
@@ -166,50 +353,15 @@ void webInit()
   server.serveStatic("/Hilfe.html", SPIFFS, "/Hilfe.html");
 
   historySetUpdateCallback(onHistoryUpdate);
+  historySetBucketCallback(onHistoryBucket);
 
   /* SETTINGS GET */
   server.on("/api/settings", HTTP_GET, [](AsyncWebServerRequest *request){
-
-  JsonDocument doc;
-
-  doc["pulsesPerLiterIn"]  = settings.pulsesPerLiterIn;
-  doc["pulsesPerLiterOut"] = settings.pulsesPerLiterOut;
-
-  doc["tdsLimit"]        = settings.tdsLimit;
-  doc["maxFlushTimeSec"] = settings.maxFlushTimeSec;
-  doc["tdsMaxAllowed"]   = settings.tdsMaxAllowed; 
-
-  doc["maxRuntimeAutoSec"]   = settings.maxRuntimeAutoSec;
-  doc["maxRuntimeManualSec"] = settings.maxRuntimeManualSec;
-
-  doc["maxProductionAutoLiters"]   = settings.maxProductionAutoLiters;
-  doc["maxProductionManualLiters"] = settings.maxProductionManualLiters;
-
-  doc["prepareTimeSec"]   = settings.prepareTimeSec;
-  doc["autoFlushEnabled"] = settings.autoFlushEnabled;
-  doc["postFlushEnabled"] = settings.postFlushEnabled;
-  doc["postFlushTimeSec"] = settings.postFlushTimeSec;
-  doc["autoFlushMinTimeSec"] = settings.autoFlushMinTimeSec;
-
-
-  doc["serviceFlushEnabled"]     = settings.serviceFlushEnabled;
-  doc["serviceFlushIntervalSec"] = settings.serviceFlushIntervalSec;
-  doc["serviceFlushTimeSec"]     = settings.serviceFlushTimeSec;
-
-  doc["mqttHost"] = settings.mqttHost;
-  doc["mqttPort"] = settings.mqttPort;
-  doc["mDNSName"] = settings.mDNSName;
-  doc["APPassWord"] = settings.apPassword;
-  doc["wifiSSID"] = settings.wifiSSID;
-  doc["wifiPassword"] = settings.wifiPassword;
-  
-  String json;
-  serializeJson(doc,json);
-
-  auto r=request->beginResponse(200,"application/json",json);
-  addNoCache(r);
-  request->send(r);
-});
+    struct Cursor{ uint16_t pos = 0, sub = 0; };
+    std::shared_ptr<Cursor> c = std::make_shared<Cursor>();
+    sendStreamed(request, "application/json",
+      [c](Print& out){ return settingsJsonNext(c->pos, c->sub, out); });
+  });
 
 
 
@@ -229,11 +381,8 @@ server.on("/update", HTTP_POST,
 
     request->send(200,"text/html",page);
 
-    // ⭐ reboot async verzögert
-    xTaskCreate([](void*){
-        delay(800);
-        ESP.restart();
-    }, "reboot", 2048, NULL, 1, NULL);
+    // ⭐ reboot verzögert (one-shot im Scheduler)
+    webRebootMs = 800;
 
 },
 [](AsyncWebServerRequest *request, String filename, size_t index,
@@ -345,37 +494,42 @@ server.on("/api/wifi/scan", HTTP_GET, [](AsyncWebServerRequest *req){
     });
 
 
+  /* stats=1: + Min/Max/Last je Kanal, points=N: LTTB auf N Punkte */
   server.on("/api/history/series", HTTP_GET,
     [](AsyncWebServerRequest *req)
     {
-      if(!req->hasParam("series")) {
-        req->send(400, "text/plain", "missing series");
-        return;
-      }
+      std::shared_ptr<HistorySelection> sel(new (std::nothrow) HistorySelection());
+      if(!sel) return req->send(503, "text/plain", "out of memory");
+      if(!parseSeriesSelection(req, *sel)) return;
 
-      String s = req->getParam("series")->value();
-      HistorySeries type;
-
-      if(s == "2s")          type = HIST_2S;
-      else if(s == "30s")    type = HIST_30S;
-      else if(s == "600s")   type = HIST_600S;
-      else if(s == "3600s")  type = HIST_3600S;
-      else if(s =="21600s")  type = HIST_21600S;
-      else {
-        req->send(400, "text/plain", "invalid series");
-        return;
-      }
+      std::shared_ptr<HistoryJsonCursor> c = std::make_shared<HistoryJsonCursor>();
+      sendStreamed(req, "application/json",
+        [sel, c](Print& out){ return historySeriesJsonNext(*sel, *c, out); });
+    });
 
-      req->send(200, "application/json",
-                historyGetSeriesJson(type));
+  /* Binärer Spaltenframe (siehe history.cpp), enc=f32|di16 */
+  server.on("/api/history/series.bin", HTTP_GET,
+    [](AsyncWebServerRequest *req)
+    {
+      std::shared_ptr<HistorySelection> sel(new (std::nothrow) HistorySelection());
+      if(!sel) return req->send(503, "text/plain", "out of memory");
+      if(!parseSeriesSelection(req, *sel)) return;
+
+      HistoryBinEncoding enc = HIST_BIN_DI16;
+      if(req->hasParam("enc") && req->getParam("enc")->value() == "f32")
+        enc = HIST_BIN_F32;
+
+      std::shared_ptr<HistoryBinCursor> c = std::make_shared<HistoryBinCursor>();
+      req->send(beginStreamed(req, "application/octet-stream",
+        [sel, enc, c](Print& out){ return historySeriesBinNext(*sel, enc, *c, out); },
+        historySeriesBinSize(*sel, enc)));
     });
 
 
   /* REBOOT */
   server.on("/api/reboot", HTTP_POST, [](AsyncWebServerRequest *req){
     req->send(200,"text/plain","rebooting");
-    delay(200);
-    ESP.restart();
+    webRebootMs = 200;
   });
 
   server.on("/ls", HTTP_GET, [](AsyncWebServerRequest *req){
@@ -390,8 +544,88 @@ server.on("/api/wifi/scan", HTTP_GET, [](AsyncWebServerRequest *req){
     req->send(200,"text/plain",out);
   });
 
+  /* ?offset=&limit=&mode=&reason=&from=&to=, Gesamtzahl in X-Total-Count */
   server.on("/api/history/table", HTTP_GET, [](AsyncWebServerRequest *req){
-    req->send(200, "application/json", historyGetTableJson());
+    std::shared_ptr<HistoryTableQuery> q = std::make_shared<HistoryTableQuery>();
+    parseTableQuery(req, *q);
+
+    std::shared_ptr<HistoryTableCursor> c = std::make_shared<HistoryTableCursor>();
+    AsyncWebServerResponse *r = beginStreamed(req, "application/json",
+      [q, c](Print& out){ return historyTableJsonNext(*q, *c, out); });
+    r->addHeader("X-Total-Count", String(historyTableCount(*q)));
+    req->send(r);
+  });
+
+  /* Lebensdauer + Kalender-Rollups (totals.cpp) */
+  server.on("/api/stats", HTTP_GET, [](AsyncWebServerRequest *req){
+    std::shared_ptr<uint16_t> pos = std::make_shared<uint16_t>(0);
+    sendStreamed(req, "application/json",
+      [pos](Print& out){ return totalsJsonNext(*pos, out); });
+  });
+
+  /* Laufzeit-Profil: Abschnitte (Histogramme) + Scheduler-Tasks */
+  server.on("/api/profile", HTTP_GET, [](AsyncWebServerRequest *req){
+    std::shared_ptr<uint16_t> pos = std::make_shared<uint16_t>(0);
+    sendStreamed(req, "application/json",
+      [pos](Print& out){ return profJsonNext(*pos, out); });
+  });
+
+  server.on("/api/profile/reset", HTTP_POST, [](AsyncWebServerRequest *req){
+    profRequestReset();
+    req->send(200, "text/plain", "OK");
+  });
+
+  /* Durchfluss: Pulsfrequenz, Glitches, Perioden-Jitter je Kanal */
+  server.on("/api/flow", HTTP_GET, [](AsyncWebServerRequest *req){
+    std::shared_ptr<uint16_t> pos = std::make_shared<uint16_t>(0);
+    sendStreamed(req, "application/json",
+      [pos](Print& out){ return flowJsonNext(*pos, out); });
+  });
+
+  /* Roh-Trace eines Laufs (Format siehe history.cpp) */
+  server.on("/api/history/trace", HTTP_GET, [](AsyncWebServerRequest *req){
+    uint32_t run = req->hasParam("run")
+                 ? strtoul(req->getParam("run")->value().c_str(), nullptr, 10) : 0;
+
+    char path[24];
+    if(!historyTracePath(run, path, sizeof(path))) {
+      req->send(404, "text/plain", "no trace");
+      return;
+    }
+
+    AsyncWebServerResponse *r = req->beginResponse(SPIFFS, path, "application/octet-stream");
+    addNoCache(r);
+    req->send(r);
+  });
+
+  /* Aufzeichnung der Roh-Eingänge (Format siehe recorder.h) */
+  server.on("/api/rec", HTTP_GET, [](AsyncWebServerRequest *req){
+    const char* path = req->hasParam("prev") ? REC_PREV_PATH : REC_PATH;
+
+    if(!SPIFFS.exists(path)) {
+      req->send(404, "text/plain", "no recording");
+      return;
+    }
+
+    AsyncWebServerResponse *r = req->beginResponse(SPIFFS, path, "application/octet-stream");
+    addNoCache(r);
+    req->send(r);
+  });
+
+  server.on("/api/rec/stop", HTTP_POST, [](AsyncWebServerRequest *req){
+    recRequestStop();         // beendet der Rec-Task (einziger Schreiber der Datei)
+    req->send(200, "text/plain", "OK");
+  });
+
+  server.on("/api/history/table.csv", HTTP_GET, [](AsyncWebServerRequest *req){
+    std::shared_ptr<HistoryTableQuery> q = std::make_shared<HistoryTableQuery>();
+    parseTableQuery(req, *q);
+
+    std::shared_ptr<HistoryTableCursor> c = std::make_shared<HistoryTableCursor>();
+    AsyncWebServerResponse *r = beginStreamed(req, "text/csv",
+      [q, c](Print& out){ return historyTableCsvNext(*q, *c, out); });
+    r->addHeader("Content-Disposition", "attachment; filename=\"production.csv\"");
+    req->send(r);
   });
 
   
@@ -425,8 +659,5 @@ void webLoop(float tds, const char* stateName, float litersNow, bool isManualMod
     if(runtimeLeft < 0) runtimeLeft = 0;
   }
 
-  if(millis()-lastSend>300){
-    wsBroadcast(tds,stateName,modeName,litersNow,flowLpm,currentFlowInLpm,left,runtimeLeft,espVersion);
-    lastSend=millis();
-  }
+  wsBroadcast(tds,stateName,modeName,litersNow,flowLpm,currentFlowInLpm,left,runtimeLeft,espVersion);
 }
@@ -3,9 +3,13 @@
 
 extern bool webStartRequest;
 extern bool webStopRequest;
+/* Neustart angefordert: Verzögerung in ms (0 = keiner), main.cpp schaltet
+   damit den one-shot "reboot" scharf -> Antwort geht vorher noch raus */
+extern volatile uint16_t webRebootMs;
 
 void webInit();
 void webSetStatus(const char* s);
+/* WS-Broadcast; Takt vom Scheduler (main.cpp, TASK_WEB_MS) */
 void webLoop(float tds, const char* state, float liters, bool manual, uint32_t runtime, 
               const char* mode, float flowLpm, float currentFlowInLpm, const char* espVersion);
 void webNotifyHistoryUpdate();
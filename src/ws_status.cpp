@@ -0,0 +1,30 @@
+#include "ws_status.h"
+#include <ArduinoJson.h>
+
+/* ============================================================
+   JSON
+   ============================================================ */
+
+void wsStatusJson(const WsStatus& st, String& out)
+{
+  JsonDocument doc;
+
+  doc["state"]=st.state;
+  doc["mode"]=st.mode;
+  doc["error"]=st.error;
+  doc["tds"]=st.tds;
+  doc["liters"]=st.liters;
+  doc["flow"]=st.flow;
+  doc["left"]=st.left;
+  doc["timeLeft"] = st.timeLeft;
+  doc["espVersion"] = st.espVersion;
+  doc["flowIn"] = st.flowIn;
+
+  if(st.status && st.status[0])
+    doc["status"] = st.status;
+  else
+    doc["status"] = "Hä?";
+
+  out = "";
+  serializeJson(doc,out);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   WS STATUS
+   Status-Nachricht für den WebSocket-Broadcast (web.cpp, alle
+   TASK_WEB_MS an alle Clients). Eigenes Modul, damit der Aufbau
+   auch auf dem PC läuft (sim/bench.cpp).
+   ============================================================ */
+
+struct WsStatus{
+  const char* state;
+  const char* mode;
+  const char* error;
+  float       tds;
+  float       liters;
+  float       flow;
+  float       left;
+  float       timeLeft;
+  const char* espVersion;
+  float       flowIn;
+  const char* status;        // leer -> "Hä?"
+};
+
+/* JSON nach out (ersetzt den Inhalt) */
+void wsStatusJson(const WsStatus& st, String& out);
@@ -0,0 +1,206 @@
+#include <unity.h>
+#include "controller.h"
+
+/* ============================================================
+   CONTROLLER
+   ctlStep ist rein -> Abläufe direkt über CtlInputs treiben
+   ============================================================ */
+
+static Settings   cfg;
+static Controller c;
+static CtlInputs  in;
+
+void setUp()
+{
+  cfg = Settings();
+  cfg.serviceFlushEnabled = false;
+  in = {};
+  in.now = 1000;
+  ctlInit(c, &cfg, in.now);
+}
+
+void tearDown() {}
+
+/* Zeit vorstellen, einen Tick rechnen; Flanken gelten nur für diesen */
+static CtlOutputs step(uint32_t dtMs)
+{
+  in.now += dtMs;
+  CtlOutputs o = ctlStep(c, in);
+  in.webStart = in.webStop = false;
+  in.autoRose = in.manualRose = false;
+  return o;
+}
+
+/* bis zum nächsten Zustandswechsel, Ticks zu 10 ms */
+static CtlOutputs runUntilChange(uint32_t maxMs)
+{
+  for(uint32_t t = 0; t < maxMs; t += 10) {
+    CtlOutputs o = step(10);
+    if(c.state != o.from) return o;
+  }
+  TEST_FAIL_MESSAGE("no transition");
+  return {};
+}
+
+/* Wahlschalter MANUAL (AUS bricht jeden Start ab), Start über Web */
+static void startToProduction()
+{
+  in.manualMode = true;
+  in.webStart = true;
+  step(10);
+  TEST_ASSERT_EQUAL(PREPARE, c.state);
+
+  runUntilChange(60000);
+  TEST_ASSERT_EQUAL(AUTOFLUSH, c.state);
+
+  CtlOutputs o = runUntilChange(cfg.maxFlushTimeSec * 1000);
+  TEST_ASSERT_EQUAL(PRODUCTION, c.state);
+  TEST_ASSERT_TRUE(o.fx & CTL_FX_HISTORY_START);
+}
+
+static void test_web_start_runs_through_flush()
+{
+  in.tds = 5.0f;
+  in.manualMode = true;
+  in.webStart = true;
+  step(10);
+  TEST_ASSERT_EQUAL(PREPARE, c.state);
+  TEST_ASSERT_EQUAL_HEX8(ACT(ACT_RELAY) | ACT(ACT_WIN), c.act);
+
+  uint32_t t0 = in.now;
+  runUntilChange(60000);
+  TEST_ASSERT_EQUAL(AUTOFLUSH, c.state);
+  TEST_ASSERT_UINT32_WITHIN(10, cfg.prepareTimeSec * 1000, in.now - t0);
+
+  t0 = in.now;
+  CtlOutputs o = runUntilChange(cfg.maxFlushTimeSec * 1000);
+  TEST_ASSERT_EQUAL(PRODUCTION, c.state);
+  TEST_ASSERT_TRUE(o.fx & CTL_FX_HISTORY_START);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(cfg.autoFlushMinTimeSec * 1000, in.now - t0);
+  TEST_ASSERT_EQUAL_HEX8(ACT(ACT_RELAY) | ACT(ACT_WIN) | ACT(ACT_OOUT), c.act);
+}
+
+static void test_autoflush_pulses_product_valve()
+{
+  in.manualMode = true;
+  in.webStart = true;
+  step(10);
+  runUntilChange(60000);
+  TEST_ASSERT_EQUAL(AUTOFLUSH, c.state);
+
+  in.tds = 50.0f;                       // TDS schlecht -> bleibt im Flush
+  CtlOutputs o = step(10);
+  TEST_ASSERT_TRUE(o.act & ACT(ACT_OOUT));
+
+  o = step(AUTOFLUSH_PRODUCT_PULSE_MS);
+  TEST_ASSERT_FALSE(o.act & ACT(ACT_OOUT));
+  TEST_ASSERT_EQUAL(AUTOFLUSH, c.state);
+}
+
+static void test_stop_with_postflush_reports_liters()
+{
+  in.tds = 5.0f;
+  startToProduction();
+
+  in.cntOut += 1760;                    // 2 l bei 880 Pulsen/l
+  step(10);
+  in.webStop = true;
+  CtlOutputs o = step(10);
+  TEST_ASSERT_EQUAL(POSTFLUSH, c.state);
+  TEST_ASSERT_EQUAL_STRING("User stop", c.lastStopReason);
+  TEST_ASSERT_FALSE(o.fx & CTL_FX_HISTORY_END);
+
+  o = runUntilChange(cfg.postFlushTimeSec * 1000 + 100);
+  TEST_ASSERT_EQUAL(IDLE, c.state);
+  TEST_ASSERT_TRUE(o.fx & CTL_FX_HISTORY_END);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 2.0f, c.lastProducedLiters);
+  TEST_ASSERT_EQUAL_HEX8(0, o.act);
+}
+
+static void test_tds_high_ends_run_in_error()
+{
+  in.tds = 5.0f;
+  startToProduction();
+
+  in.tds = cfg.tdsMaxAllowed + 1.0f;
+  step(10);                             // innerhalb TDS_SETTLE_MS ignoriert
+  TEST_ASSERT_EQUAL(PRODUCTION, c.state);
+
+  CtlOutputs o = runUntilChange(TDS_SETTLE_MS + 100);
+  TEST_ASSERT_EQUAL(ERROR, c.state);
+  TEST_ASSERT_TRUE(o.fx & CTL_FX_HISTORY_END);
+  TEST_ASSERT_TRUE(o.fx & CTL_FX_PUSH);
+  TEST_ASSERT_EQUAL_STRING("TDS too high", o.push);
+  TEST_ASSERT_EQUAL_HEX8(0, c.act);
+}
+
+/* Spülwasser zählt: Zulauf in jeder Laufphase, Produkt nur in PRODUCTION */
+static void test_inlet_flow_metered_in_flush_phases()
+{
+  const float hz = 10.0f;
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, ctlFlowInLpm(c, hz));     // IDLE
+
+  in.manualMode = true;
+  in.webStart = true;
+  step(10);
+  TEST_ASSERT_EQUAL(PREPARE, c.state);
+  float lpm = hz * 60.0f / cfg.pulsesPerLiterIn;
+  TEST_ASSERT_EQUAL_FLOAT(lpm, ctlFlowInLpm(c, hz));
+
+  runUntilChange(60000);
+  TEST_ASSERT_EQUAL(AUTOFLUSH, c.state);
+  TEST_ASSERT_EQUAL_FLOAT(lpm, ctlFlowInLpm(c, hz));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, ctlFlowOutLpm(c, hz));
+
+  in.tds = 5.0f;
+  runUntilChange(cfg.maxFlushTimeSec * 1000);
+  TEST_ASSERT_EQUAL(PRODUCTION, c.state);
+  TEST_ASSERT_TRUE(ctlFlowOutLpm(c, hz) > 0.0f);
+
+  in.webStop = true;
+  step(10);
+  TEST_ASSERT_EQUAL(POSTFLUSH, c.state);
+  TEST_ASSERT_EQUAL_FLOAT(lpm, ctlFlowInLpm(c, hz));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, ctlFlowOutLpm(c, hz));
+}
+
+static void test_inflow_with_closed_valve_is_error()
+{
+  step(FLOW_CLOSED_GRACE_MS + 10);
+  in.cntIn += FLOW_CLOSED_MAX_PULSES + 1;
+  CtlOutputs o = step(10);
+  TEST_ASSERT_EQUAL(ERROR, c.state);
+  TEST_ASSERT_EQUAL_STRING("Inflow while inlet valve closed", o.push);
+}
+
+static void test_auto_start_and_tank_full()
+{
+  in.autoMode = true;
+  in.autoRose = true;
+  CtlOutputs o = step(10);
+  TEST_ASSERT_EQUAL(PREPARE, c.state);
+  TEST_ASSERT_TRUE(o.fx & CTL_FX_PUSH);
+
+  in.tds = 5.0f;
+  runUntilChange(60000);
+  runUntilChange(cfg.maxFlushTimeSec * 1000);
+  TEST_ASSERT_EQUAL(PRODUCTION, c.state);
+
+  in.lowSwim = in.highSwim = true;
+  step(10);
+  TEST_ASSERT_EQUAL(POSTFLUSH, c.state);
+  TEST_ASSERT_EQUAL_STRING("Container full", c.lastStopReason);
+}
+
+int main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_web_start_runs_through_flush);
+  RUN_TEST(test_autoflush_pulses_product_valve);
+  RUN_TEST(test_stop_with_postflush_reports_liters);
+  RUN_TEST(test_tds_high_ends_run_in_error);
+  RUN_TEST(test_inlet_flow_metered_in_flush_phases);
+  RUN_TEST(test_inflow_with_closed_valve_is_error);
+  RUN_TEST(test_auto_start_and_tank_full);
+  return UNITY_END();
+}
@@ -0,0 +1,150 @@
+#include <unity.h>
+#include "gorilla_codec.h"
+
+/* ============================================================
+   GORILLA CODEC
+   Rundreise Writer -> Reader; Feld 2 ist exakt (Zählerstand)
+   ============================================================ */
+
+#define N     3
+#define EXACT (1u << 2)
+
+typedef GorillaCodec<N, EXACT> Codec;
+
+static uint8_t buf[256];
+
+void setUp()    { memset(buf, 0, sizeof(buf)); }
+void tearDown() {}
+
+static uint32_t bitsOf(float f)
+{
+  uint32_t b;
+  memcpy(&b, &f, 4);
+  return b;
+}
+
+/* Werte eines Buckets: Sensorwerte + ein Zähler mit voller Mantisse */
+static void sample(uint16_t i, uint32_t& ts, float* v)
+{
+  ts   = 1700000000u + i * 30 + (i % 7 == 3 ? 1 : 0);   // mit Jitter
+  v[0] = 12.5f + 0.37f * (i % 11);
+  v[1] = i % 5 ? 0.0f : -3.25f * i;
+  v[2] = 8388607.0f + i * 1.0009765625f;               // 2^23 - 1 + ...
+}
+
+static uint16_t encode(uint16_t count, uint16_t cap, Codec::State& s, BitWriter& w)
+{
+  w.begin(buf, cap);
+  s = {};
+  uint16_t n = 0;
+  for(; n < count; n++) {
+    uint32_t ts;
+    float v[N];
+    sample(n, ts, v);
+    if(!Codec::append(w, s, ts, v)) break;
+  }
+  return n;
+}
+
+static void test_roundtrip_lossy_and_exact()
+{
+  Codec::State ws;
+  BitWriter w;
+  uint16_t n = encode(40, sizeof(buf), ws, w);
+  TEST_ASSERT_EQUAL_UINT16(40, n);
+  TEST_ASSERT_EQUAL_UINT16(40, ws.n);
+
+  BitReader r;
+  r.begin(buf, w.pos);
+  Codec::State rs = {};
+
+  for(uint16_t i = 0; i < n; i++) {
+    uint32_t ts, tsOut;
+    float v[N], out[N];
+    sample(i, ts, v);
+    Codec::next(r, rs, tsOut, out);
+
+    TEST_ASSERT_EQUAL_UINT32(ts, tsOut);
+    for(uint8_t k = 0; k < 2; k++) {
+      TEST_ASSERT_EQUAL_HEX32(gorillaQuantize(v[k]), bitsOf(out[k]));
+      TEST_ASSERT_FLOAT_WITHIN(fabsf(v[k]) / (1 << GORILLA_MANTISSA), v[k], out[k]);
+    }
+    TEST_ASSERT_EQUAL_HEX32(bitsOf(v[2]), bitsOf(out[2]));
+  }
+  TEST_ASSERT_EQUAL_UINT32(w.pos, r.pos);
+}
+
+static void test_timestamp_deltas_all_ranges()
+{
+  static const int32_t gaps[] = { 30, 30, 60, 300, 2000, 1, 100000, 30, 30 };
+  BitWriter w;
+  w.begin(buf, sizeof(buf));
+  Codec::State ws = {};
+
+  uint32_t ts = 1000;
+  float v[N] = { 1.0f, 2.0f, 3.0f };
+  for(int32_t g : gaps) {
+    ts += g;
+    TEST_ASSERT_TRUE(Codec::append(w, ws, ts, v));
+  }
+
+  BitReader r;
+  r.begin(buf, w.pos);
+  Codec::State rs = {};
+  ts = 1000;
+  for(int32_t g : gaps) {
+    uint32_t tsOut;
+    float out[N];
+    ts += g;
+    Codec::next(r, rs, tsOut, out);
+    TEST_ASSERT_EQUAL_UINT32(ts, tsOut);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, out[2]);
+  }
+}
+
+/* volle Blöcke: der Bucket, der nicht passt, hinterlässt nichts */
+static void test_overflow_rolls_back()
+{
+  const uint16_t cap = 64;
+  Codec::State ws;
+  BitWriter w;
+  uint16_t n = encode(1000, cap, ws, w);
+  TEST_ASSERT_TRUE(n > 1 && n < 1000);
+  TEST_ASSERT_EQUAL_UINT16(n, ws.n);
+  TEST_ASSERT_FALSE(w.overflow);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(cap * 8, w.pos);
+  TEST_ASSERT_EQUAL_UINT8(0, buf[cap]);           // nichts hinter der Kapazität
+
+  BitReader r;
+  r.begin(buf, w.pos);
+  Codec::State rs = {};
+  for(uint16_t i = 0; i < n; i++) {
+    uint32_t ts, tsOut;
+    float v[N], out[N];
+    sample(i, ts, v);
+    Codec::next(r, rs, tsOut, out);
+    TEST_ASSERT_EQUAL_UINT32(ts, tsOut);
+    TEST_ASSERT_EQUAL_HEX32(bitsOf(v[2]), bitsOf(out[2]));
+  }
+}
+
+static void test_quantize_keeps_nan_and_exact_fields()
+{
+  float nan = NAN;
+  TEST_ASSERT_EQUAL_HEX32(bitsOf(nan), gorillaQuantize(nan));
+  TEST_ASSERT_EQUAL_HEX32(bitsOf(1.0f), gorillaQuantize(1.0f));
+
+  float odd = 1.0f + 1.0f / (1 << 20);            // Bit unterhalb der Mantisse
+  TEST_ASSERT_EQUAL_HEX32(bitsOf(1.0f), Codec::quantize(0, odd));
+  TEST_ASSERT_EQUAL_HEX32(bitsOf(odd), Codec::quantize(2, odd));
+}
+
+int main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_roundtrip_lossy_and_exact);
+  RUN_TEST(test_timestamp_deltas_all_ranges);
+  RUN_TEST(test_overflow_rolls_back);
+  RUN_TEST(test_quantize_keeps_nan_and_exact_fields);
+  return UNITY_END();
+}
@@ -0,0 +1,158 @@
+#include <unity.h>
+#include <string>
+#include "history.h"
+#include "json_writer.h"
+#include "settings.h"
+
+/* ============================================================
+   GESTREAMTE ANTWORTEN
+   Fragmente <= STREAM_FRAG_MAX; lange Strings (tdsCal) werden
+   über mehrere Fragmente verteilt statt abgeschnitten, der
+   Binärframe kommt in Teilen aus der Momentaufnahme
+   ============================================================ */
+
+typedef FixedPrint<STREAM_FRAG_MAX> FragBuf;
+
+struct StrPrint : public Print
+{
+  std::string s;
+  size_t write(uint8_t b) override { s += (char)b; return 1; }
+};
+
+static std::string quoted(const char* v)
+{
+  StrPrint p;
+  jsonWriteString(p, v);
+  return p.s;
+}
+
+/* langer Wert mit Zeichen, die escaped werden müssen */
+static String longSpec(uint16_t points)
+{
+  String s;
+  for(uint16_t i = 0; i < points; i++) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%u:%u, ", 100 + i * 7, 5 + i * 3);
+    s += buf;
+  }
+  s += "\"x\\\t";
+  return s;
+}
+
+void setUp()    {}
+void tearDown() { settings = Settings(); }
+
+static void test_fixed_print_flags_overflow()
+{
+  FixedPrint<8> f;
+  f.write((const uint8_t*)"1234567", 7);
+  TEST_ASSERT_FALSE(f.overflow);
+  f.write('8');
+  TEST_ASSERT_FALSE(f.overflow);
+  f.write('9');
+  TEST_ASSERT_TRUE(f.overflow);
+  TEST_ASSERT_EQUAL_UINT32(8, f.len);
+
+  f.reset();
+  TEST_ASSERT_FALSE(f.overflow);
+  f.write((const uint8_t*)"0123456789", 10);
+  TEST_ASSERT_TRUE(f.overflow);
+}
+
+/* Teile aneinander = ganzer String, jeder Teil <= max */
+static void test_string_part_matches_whole()
+{
+  String v = longSpec(40);
+  for(size_t max : { 8, 9, 13, 64, 1000 }) {
+    StrPrint all;
+    uint16_t from = 0;
+    bool done = false;
+    while(!done) {
+      StrPrint part;
+      done = jsonWriteStringPart(part, v.c_str(), from, max);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(max, part.s.size());
+      TEST_ASSERT_TRUE(part.s.size() > 0);
+      all.s += part.s;
+    }
+    TEST_ASSERT_EQUAL_STRING(quoted(v.c_str()).c_str(), all.s.c_str());
+  }
+}
+
+static void test_long_tdscal_splits_across_fragments()
+{
+  settings.tdsCal   = longSpec(100);
+  settings.wifiSSID = longSpec(3);
+  TEST_ASSERT_TRUE(settings.tdsCal.length() > 3 * STREAM_FRAG_MAX);
+
+  std::string doc;
+  uint16_t pos = 0, sub = 0;
+  uint16_t frags = 0;
+  bool more = true;
+  while(more) {
+    FragBuf f;
+    more = settingsJsonNext(pos, sub, f);
+    TEST_ASSERT_FALSE(f.overflow);
+    doc.append((const char*)f.buf, f.len);
+    TEST_ASSERT_LESS_THAN_UINT32(200, ++frags);
+  }
+
+  TEST_ASSERT_EQUAL_CHAR('{', doc.front());
+  TEST_ASSERT_EQUAL_CHAR('}', doc.back());
+  std::string cal = "\"tdsCal\":" + quoted(settings.tdsCal.c_str()) + ",";
+  TEST_ASSERT_TRUE(doc.find(cal) != std::string::npos);
+  std::string ssid = "\"wifiSSID\":" + quoted(settings.wifiSSID.c_str()) + ",";
+  TEST_ASSERT_TRUE(doc.find(ssid) != std::string::npos);
+  TEST_ASSERT_TRUE(doc.find("\"tdsMaxAllowed\":") < doc.find(cal));
+  TEST_ASSERT_TRUE(doc.find("\"maxRuntimeAutoSec\":") > doc.find(cal));
+}
+
+/* Binärframe in Fragmenten: Länge wie angekündigt, DI16 rundreise */
+static void test_series_bin_streams_in_fragments()
+{
+  static HistorySelection sel;
+  sel = {};
+  sel.series  = HIST_30S;
+  sel.columns = HIST_MAX_COLS;
+  sel.count   = HIST_MAX_POINTS - 1;                 // ungerade -> Padding
+  for(uint8_t c = 0; c < sel.columns; c++) sel.col[c] = c;
+  for(uint16_t j = 0; j < sel.count; j++) {
+    sel.t[j] = 1700000000u + j * 30;
+    for(uint8_t c = 0; c < sel.columns; c++) sel.v[c][j] = 100.0f + c + 0.5f * (j % 17);
+  }
+
+  for(HistoryBinEncoding enc : { HIST_BIN_DI16, HIST_BIN_F32 }) {
+    std::string bin;
+    HistoryBinCursor c;
+    bool more = true;
+    while(more) {
+      FragBuf f;
+      more = historySeriesBinNext(sel, enc, c, f);
+      TEST_ASSERT_FALSE(f.overflow);
+      bin.append((const char*)f.buf, f.len);
+    }
+    TEST_ASSERT_EQUAL_UINT32(historySeriesBinSize(sel, enc), bin.size());
+    if(enc != HIST_BIN_DI16) continue;
+
+    /* Spalte 0 nach Kopf, Spaltenliste und Zeiten */
+    size_t o = 20 + ((sel.columns + 3) & ~3u) + sel.count * 4;
+    float scale;
+    memcpy(&scale, bin.data() + o, 4);
+    int32_t q = 0;
+    for(uint16_t j = 0; j < sel.count; j++) {
+      int16_t d;
+      memcpy(&d, bin.data() + o + 4 + j * 2, 2);
+      q += d;
+      TEST_ASSERT_FLOAT_WITHIN(scale, sel.v[0][j], q * scale);
+    }
+  }
+}
+
+int main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_print_flags_overflow);
+  RUN_TEST(test_string_part_matches_whole);
+  RUN_TEST(test_long_tdscal_splits_across_fragments);
+  RUN_TEST(test_series_bin_streams_in_fragments);
+  return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#include <unity.h>
+#include "hal.h"
+#include "logstore.h"
+
+/* ============================================================
+   LOG STORE
+   3 Segmente zu je 4 Records (u32 Nutzdaten) im Verzeichnis
+   test_fs/ über das POSIX-Backend
+   ============================================================ */
+
+#define BASE      "/lt"
+#define SEGS      3
+#define PER_SEG   4
+#define SEG_BYTES LogStore::segmentBytesFor(PER_SEG, sizeof(uint32_t))
+
+struct Seen{
+  uint32_t n;
+  uint32_t seq[16];
+  uint32_t val[16];
+};
+
+static void collect(uint8_t type, uint32_t seq, const uint8_t* data, uint8_t len, void* ctx)
+{
+  Seen& s = *(Seen*)ctx;
+  TEST_ASSERT_EQUAL_UINT8(7, type);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(uint32_t), len);
+  TEST_ASSERT_LESS_THAN_UINT32(16, s.n);
+  s.seq[s.n] = seq;
+  memcpy(&s.val[s.n], data, 4);
+  s.n++;
+}
+
+static Seen replayAll(uint16_t format = 1)
+{
+  Seen s = {};
+  LogStore log(BASE, SEGS, SEG_BYTES, format);
+  uint32_t n = log.replay(collect, &s);
+  TEST_ASSERT_EQUAL_UINT32(n, s.n);
+  return s;
+}
+
+static void appendValues(LogStore& log, uint32_t from, uint32_t to)
+{
+  for(uint32_t v = from; v < to; v++)
+    TEST_ASSERT_TRUE(log.append(7, &v, sizeof(v)));
+}
+
+void setUp()
+{
+  LogStore log(BASE, SEGS, SEG_BYTES, 1);
+  log.clear();
+}
+
+void tearDown() {}
+
+static void test_size_helpers()
+{
+  TEST_ASSERT_EQUAL_UINT32(LOG_SEG_HDR + PER_SEG * (12 + 4), SEG_BYTES);
+  TEST_ASSERT_EQUAL_UINT32(PER_SEG, LogStore::recordsPerSegment(SEG_BYTES, 4));
+  TEST_ASSERT_EQUAL_UINT32(PER_SEG - 1, LogStore::recordsPerSegment(SEG_BYTES - 1, 4));
+}
+
+static void test_replay_returns_records_in_order()
+{
+  LogStore log(BASE, SEGS, SEG_BYTES, 1);
+  TEST_ASSERT_EQUAL_UINT32(0, log.replay(nullptr, nullptr));
+  appendValues(log, 100, 110);
+
+  Seen s = replayAll();
+  TEST_ASSERT_EQUAL_UINT32(10, s.n);
+  for(uint32_t i = 0; i < s.n; i++) {
+    TEST_ASSERT_EQUAL_UINT32(i, s.seq[i]);
+    TEST_ASSERT_EQUAL_UINT32(100 + i, s.val[i]);
+  }
+}
+
+/* volles letztes Segment -> ältestes Segment wird neu begonnen */
+static void test_rotation_drops_oldest_segment()
+{
+  LogStore log(BASE, SEGS, SEG_BYTES, 1);
+  log.replay(nullptr, nullptr);
+  appendValues(log, 0, SEGS * PER_SEG + 1);
+
+  Seen s = replayAll();
+  TEST_ASSERT_EQUAL_UINT32((SEGS - 1) * PER_SEG + 1, s.n);
+  TEST_ASSERT_EQUAL_UINT32(PER_SEG, s.val[0]);
+  for(uint32_t i = 1; i < s.n; i++) {
+    TEST_ASSERT_EQUAL_UINT32(s.seq[i - 1] + 1, s.seq[i]);
+    TEST_ASSERT_EQUAL_UINT32(s.val[i - 1] + 1, s.val[i]);
+  }
+}
+
+/* kaputter Record: Segment endet davor, danach frisches Segment */
+static void test_corrupt_tail_is_cut_and_log_continues()
+{
+  {
+    LogStore log(BASE, SEGS, SEG_BYTES, 1);
+    log.replay(nullptr, nullptr);
+    appendValues(log, 0, 3);
+  }
+
+  File f = halFs().open(BASE ".0", "r+");
+  TEST_ASSERT_TRUE((bool)f);
+  f.seek(f.size() - 1);
+  uint8_t b = 0x5A;
+  f.write(&b, 1);
+  f.close();
+
+  LogStore log(BASE, SEGS, SEG_BYTES, 1);
+  Seen s = {};
+  TEST_ASSERT_EQUAL_UINT32(2, log.replay(collect, &s));
+  appendValues(log, 50, 51);
+  TEST_ASSERT_TRUE(halFs().exists(BASE ".1"));
+
+  s = replayAll();
+  TEST_ASSERT_EQUAL_UINT32(3, s.n);
+  TEST_ASSERT_EQUAL_UINT32(2, s.seq[2]);
+  TEST_ASSERT_EQUAL_UINT32(50, s.val[2]);
+}
+
+static void test_other_format_is_ignored()
+{
+  LogStore log(BASE, SEGS, SEG_BYTES, 1);
+  log.replay(nullptr, nullptr);
+  appendValues(log, 0, 5);
+
+  TEST_ASSERT_EQUAL_UINT32(0, replayAll(2).n);
+  TEST_ASSERT_EQUAL_UINT32(5, replayAll(1).n);
+}
+
+int main(int, char**)
+{
+  hostFsRoot("test_fs");
+  halFsBegin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_size_helpers);
+  RUN_TEST(test_replay_returns_records_in_order);
+  RUN_TEST(test_rotation_drops_oldest_segment);
+  RUN_TEST(test_corrupt_tail_is_cut_and_log_continues);
+  RUN_TEST(test_other_format_is_ignored);
+  return UNITY_END();
+}
@@ -0,0 +1,180 @@
+#include <unity.h>
+#include "flow_meter.h"
+#include "inputs.h"
+#include "host.h"
+
+/* ============================================================
+   RINGE: Flowmeter-Zeitstempel und Eingangs-Events
+   Die Module haben globalen Zustand -> jeder Test arbeitet auf
+   einer eigenen Zeitspanne der virtuellen Uhr
+   ============================================================ */
+
+#define PIN_A  3
+#define PIN_B  4
+
+static const InputDef defs[] = { { PIN_A, 50 }, { PIN_B, 0 } };
+
+static uint32_t nowMs = 1000;
+
+static void at(uint32_t ms)
+{
+  nowMs = ms;
+  hostSetUs((uint64_t)ms * 1000);
+}
+
+void setUp()
+{
+  at(nowMs + 10000);
+  hostPinWrite(PIN_A, HIGH);
+  hostPinWrite(PIN_B, HIGH);
+  inputsInit(defs, 2);
+  inputsPoll(nowMs);                    // Reste aus dem vorigen Test
+}
+
+void tearDown() {}
+
+/* ---------- Flowmeter ---------- */
+
+/* Pulse im Abstand periodUs ab t0; Rückgabe = Zeit des letzten */
+static uint32_t pulses(FlowChannel ch, uint32_t t0, uint32_t periodUs, uint16_t n)
+{
+  uint32_t t = t0;
+  for(uint16_t i = 0; i < n; i++, t += periodUs)
+    TEST_ASSERT_TRUE(flowPulse(ch, t));
+  return t - periodUs;
+}
+
+static void test_flow_hz_over_ring_wrap()
+{
+  FlowStats s0;
+  flowGetStats(FLOW_IN, s0);
+
+  /* mehr Pulse als der Ring fasst */
+  uint32_t t0   = nowMs * 1000;
+  uint32_t last = pulses(FLOW_IN, t0, 10000, 3 * FLOW_RING);
+  flowUpdate(last + 1000);
+
+  FlowStats s;
+  flowGetStats(FLOW_IN, s);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, flowHz(FLOW_IN));
+  TEST_ASSERT_EQUAL_UINT32(s0.pulses + 3 * FLOW_RING, s.pulses);
+  TEST_ASSERT_EQUAL_UINT32(10000, s.periodUs);
+  TEST_ASSERT_EQUAL_UINT32(0, s.jitterUs);
+  TEST_ASSERT_TRUE(s.periods > 1 && s.periods < FLOW_RING);
+}
+
+static void test_flow_glitch_is_dropped()
+{
+  FlowStats s0;
+  flowGetStats(FLOW_OUT, s0);
+
+  uint32_t t = nowMs * 1000;
+  TEST_ASSERT_TRUE(flowPulse(FLOW_OUT, t));
+  TEST_ASSERT_FALSE(flowPulse(FLOW_OUT, t + FLOW_MIN_PERIOD_US - 1));
+  uint32_t last = pulses(FLOW_OUT, t + 20000, 20000, 10);
+  flowUpdate(last + 1000);
+
+  FlowStats s;
+  flowGetStats(FLOW_OUT, s);
+  TEST_ASSERT_EQUAL_UINT32(s0.pulses + 11, s.pulses);
+  TEST_ASSERT_EQUAL_UINT32(s0.glitches + 1, s.glitches);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, s.hz);
+}
+
+/* Pulse nach nowUs zählen erst beim nächsten Update */
+static void test_flow_ignores_pulses_after_now()
+{
+  uint32_t t    = nowMs * 1000;
+  uint32_t last = pulses(FLOW_IN, t, 10000, 20);
+  flowUpdate(last + 1000);
+  FlowStats s0;
+  flowGetStats(FLOW_IN, s0);
+
+  flowPulse(FLOW_IN, last + 10000);
+  flowUpdate(last + 5000);
+  FlowStats s;
+  flowGetStats(FLOW_IN, s);
+  TEST_ASSERT_EQUAL_UINT32(s0.pulses, s.pulses);
+
+  flowUpdate(last + 11000);
+  flowGetStats(FLOW_IN, s);
+  TEST_ASSERT_EQUAL_UINT32(s0.pulses + 1, s.pulses);
+}
+
+static void test_flow_times_out()
+{
+  uint32_t last = pulses(FLOW_IN, nowMs * 1000, 10000, 20);
+
+  flowUpdate(last + 20000);               // zwei Perioden still -> abfallend
+  float hz = flowHz(FLOW_IN);
+  TEST_ASSERT_TRUE(hz > 0.0f && hz < 100.0f);
+
+  flowUpdate(last + FLOW_TIMEOUT_US + 1);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, flowHz(FLOW_IN));
+}
+
+/* ---------- Eingänge ---------- */
+
+static void test_input_debounce()
+{
+  uint32_t t0 = nowMs;
+  hostPinWrite(PIN_A, LOW);
+  hostPinWrite(PIN_B, LOW);
+
+  inputsPoll(t0 + 10);
+  TEST_ASSERT_FALSE(inputActive(0));
+  TEST_ASSERT_TRUE(inputActive(1));     // ohne Entprellzeit sofort
+  TEST_ASSERT_TRUE(inputRose(1));
+
+  /* Prellen: Entprellzeit beginnt mit der letzten Flanke neu */
+  at(t0 + 30);
+  hostPinWrite(PIN_A, HIGH);
+  at(t0 + 40);
+  hostPinWrite(PIN_A, LOW);
+
+  inputsPoll(t0 + 60);
+  TEST_ASSERT_FALSE(inputActive(0));
+  inputsPoll(t0 + 89);
+  TEST_ASSERT_FALSE(inputActive(0));
+  inputsPoll(t0 + 90);
+  TEST_ASSERT_TRUE(inputActive(0));
+  TEST_ASSERT_TRUE(inputRose(0));
+  TEST_ASSERT_FALSE(inputRose(1));
+
+  inputsPoll(t0 + 100);
+  TEST_ASSERT_TRUE(inputActive(0));
+  TEST_ASSERT_FALSE(inputRose(0));
+}
+
+/* volle Queue: verworfene Flanken, der Pin wird nachgelesen */
+static void test_input_queue_overflow_resyncs()
+{
+  uint32_t t0 = nowMs;
+  for(uint16_t i = 0; i < 2 * INPUTS_QUEUE; i++)
+    hostPinWrite(PIN_A, i % 2 ? HIGH : LOW);        // endet HIGH = inaktiv
+
+  inputsPoll(t0 + 100);
+  inputsPoll(t0 + 200);
+  TEST_ASSERT_FALSE(inputActive(0));
+  TEST_ASSERT_FALSE(inputRose(0));
+
+  /* Queue wieder frei */
+  at(t0 + 300);
+  hostPinWrite(PIN_A, LOW);
+  inputsPoll(t0 + 350);
+  TEST_ASSERT_TRUE(inputActive(0));
+}
+
+int main(int, char**)
+{
+  hostSetQuiet(true);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_flow_hz_over_ring_wrap);
+  RUN_TEST(test_flow_glitch_is_dropped);
+  RUN_TEST(test_flow_ignores_pulses_after_now);
+  RUN_TEST(test_flow_times_out);
+  RUN_TEST(test_input_debounce);
+  RUN_TEST(test_input_queue_overflow_resyncs);
+  return UNITY_END();
+}
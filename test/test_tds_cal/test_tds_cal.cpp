@@ -0,0 +1,83 @@
+#include <unity.h>
+#include "tds_cal.h"
+
+/* ============================================================
+   TDS KALIBRIERUNG
+   ============================================================ */
+
+void setUp()    { tdsCalApply(""); }
+void tearDown() {}
+
+static void test_builtin_curve_rises_from_zero()
+{
+  TEST_ASSERT_EQUAL_UINT8(0, tdsCalApply(""));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, tdsLookup(0));
+
+  float prev = 0.0f;
+  for(uint16_t raw = 64; raw < TDS_LUT_SIZE; raw += 64) {
+    float ppm = tdsLookup(raw);
+    TEST_ASSERT_TRUE(ppm > prev);
+    prev = ppm;
+  }
+}
+
+static void test_code_rounds_and_clamps()
+{
+  TEST_ASSERT_EQUAL_UINT16(0, tdsCode(-5.0f));
+  TEST_ASSERT_EQUAL_UINT16(100, tdsCode(99.5f));
+  TEST_ASSERT_EQUAL_UINT16(99, tdsCode(99.49f));
+  TEST_ASSERT_EQUAL_UINT16(TDS_LUT_SIZE - 1, tdsCode(1e6f));
+
+  for(float raw = 0.0f; raw < TDS_LUT_SIZE; raw += 37.3f)
+    TEST_ASSERT_EQUAL_FLOAT(tdsLookup(raw), tdsLookup(tdsCode(raw)));
+}
+
+static void test_piecewise_linear_with_extrapolation()
+{
+  /* Reihenfolge egal, wird sortiert */
+  TEST_ASSERT_EQUAL_UINT8(3, tdsCalApply("2000:300; 1000:100, 3000:400"));
+
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 100.0f, tdsLookup(1000));
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 200.0f, tdsLookup(1500));
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 350.0f, tdsLookup(2500));
+  TEST_ASSERT_FLOAT_WITHIN(0.05f,  50.0f, tdsLookup(750));    // Randsegment verlängert
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 450.0f, tdsLookup(3500));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, tdsLookup(100));               // nicht negativ
+}
+
+static void test_single_point_scales_builtin()
+{
+  float base = tdsLookup(1500);
+  TEST_ASSERT_EQUAL_UINT8(1, tdsCalApply("1500:100"));
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 100.0f, tdsLookup(1500));
+
+  float gain = 100.0f / base;
+  tdsCalApply("");
+  float ref = tdsLookup(3000);
+  tdsCalApply("1500:100");
+  TEST_ASSERT_FLOAT_WITHIN(ref * gain * 0.002f + 0.1f, ref * gain, tdsLookup(3000));
+}
+
+static void test_invalid_spec_falls_back()
+{
+  float builtin = tdsLookup(2000);
+  tdsCalApply("1000:100, 2000:300");
+
+  TEST_ASSERT_EQUAL_UINT8(0, tdsCalApply("1000:100, 1000:200"));     // doppelt
+  TEST_ASSERT_EQUAL_FLOAT(builtin, tdsLookup(2000));
+  TEST_ASSERT_EQUAL_UINT8(0, tdsCalApply("1000=100"));
+  TEST_ASSERT_EQUAL_UINT8(0, tdsCalApply("5000:100, 1000:10"));      // außerhalb
+  TEST_ASSERT_EQUAL_UINT8(0, tdsCalApply("1:1 2:2 3:3 4:4 5:5 6:6 7:7 8:8 9:9"));
+  TEST_ASSERT_EQUAL_UINT8(TDS_CAL_MAX_POINTS, tdsCalApply("1:1 2:2 3:3 4:4 5:5 6:6 7:7 8:8"));
+}
+
+int main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_builtin_curve_rises_from_zero);
+  RUN_TEST(test_code_rounds_and_clamps);
+  RUN_TEST(test_piecewise_linear_with_extrapolation);
+  RUN_TEST(test_single_point_scales_builtin);
+  RUN_TEST(test_invalid_spec_falls_back);
+  return UNITY_END();
+}
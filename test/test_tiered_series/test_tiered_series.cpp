@@ -0,0 +1,126 @@
+#include <unity.h>
+#include "history_series.h"
+
+/* ============================================================
+   TIERED SERIES: Mindestlänge je Stufe
+   Untere Grenze = die festen Ringe vor der Komprimierung; sie muss
+   auch bei unkomprimierbaren Daten halten. Buckets werden direkt
+   je Stufe eingespielt (restore, ohne Kaskade).
+   ============================================================ */
+
+static const uint16_t floorCount[HIST_SERIES_COUNT] = { 150, 150, 150, 168, 120 };
+
+static HistSeries s;
+static uint32_t   rnd;
+
+void setUp()
+{
+  s.clear();
+  rnd = 12345;
+}
+
+void tearDown() {}
+
+static float noise(float span)
+{
+  rnd = rnd * 1664525u + 1013904223u;
+  return (rnd >> 8) * (span / 16777216.0f);
+}
+
+/* Bucket i: noisy = jedes Feld zufällig, sonst Stillstand (Sensoren
+   konstant, Zähler steigt selten) */
+static void bucket(uint16_t i, bool noisy, float* b)
+{
+  for(uint8_t ch = 0; ch < CH_COUNT; ch++) {
+    float base = ch == CH_TDS ? 20.0f : 1.5f;
+    for(uint8_t k = 0; k < HistSeries::fieldsOf(ch); k++) {
+      float v = noisy ? noise(ch == CH_TDS ? 2000.0f : 5.0f) : base;
+      b[HistSeries::fieldOffset(ch) + k] = v;
+    }
+  }
+  b[HistSeries::field(CH_PROD, STAT_MEAN)] = 1000.0f + (noisy ? i : i / 8) * 0.37f;
+}
+
+static void feed(uint8_t t, uint16_t n, bool noisy)
+{
+  float b[HistSeries::FIELDS];
+  for(uint16_t i = 0; i < n; i++) {
+    bucket(i, noisy, b);
+    s.restore(t, b, 1700000000u + i * HistSeries::tierSec[t]);
+  }
+}
+
+static void test_floor_matches_fixed_rings()
+{
+  for(uint8_t t = 0; t < HistSeries::TIERS; t++)
+    TEST_ASSERT_EQUAL_UINT16(floorCount[t], HistSeries::tierCount[t]);
+}
+
+/* unkomprimierbar: Pool läuft mehrfach über, Länge >= Grenze */
+static void test_noisy_data_keeps_floor()
+{
+  for(uint8_t t = 0; t < HistSeries::TIERS; t++) {
+    uint16_t n = 4 * floorCount[t] + 300;
+    feed(t, n, true);
+    TEST_ASSERT_LESS_THAN_UINT32(n, s.filled(t));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT16(floorCount[t], s.filled(t));
+  }
+}
+
+/* bevor die Grenze erreicht ist, geht nichts verloren */
+static void test_nothing_dropped_below_floor()
+{
+  for(uint8_t t = 1; t < HistSeries::TIERS; t++) {
+    feed(t, floorCount[t], true);
+    TEST_ASSERT_EQUAL_UINT16(floorCount[t], s.filled(t));
+  }
+}
+
+/* glatte Daten: der Pool verlängert die Stufe über die Grenze */
+static void test_smooth_data_goes_beyond_floor()
+{
+  for(uint8_t t = 1; t < HistSeries::TIERS; t++) {
+    feed(t, 4 * floorCount[t] + 300, false);
+    TEST_ASSERT_GREATER_THAN_UINT16(floorCount[t] * 3 / 2, s.filled(t));
+  }
+}
+
+/* Archiv: Reihenfolge, Zeitstempel und Zähler exakt, Mittel in der
+   Kanal-Auflösung, min/max/last = Mittel */
+static void test_archive_keeps_order_and_values()
+{
+  const uint8_t  t = HIST_21600S;
+  const uint16_t n = 4 * floorCount[t];
+  feed(t, n, true);
+
+  uint16_t filled = s.filled(t);
+  uint16_t first  = n - filled;
+  rnd = 12345;
+  float exp[HistSeries::FIELDS];
+  for(uint16_t i = 0; i < first; i++) bucket(i, true, exp);
+
+  s.scan(t, 0, filled, [&](uint16_t i, const float* b, uint32_t ts) {
+    bucket(first + i, true, exp);
+    TEST_ASSERT_EQUAL_UINT32(1700000000u + (first + i) * HistSeries::tierSec[t], ts);
+    TEST_ASSERT_EQUAL_FLOAT(exp[HistSeries::field(CH_PROD, STAT_LAST)],
+                            HistSeries::value(b, CH_PROD, STAT_LAST));
+    for(uint8_t ch = 0; ch < CH_COUNT; ch++) {
+      if(HistChannels::agg[ch] != AGG_STATS) continue;
+      float mean = HistSeries::value(exp, ch, STAT_MEAN);
+      TEST_ASSERT_FLOAT_WITHIN(HistChannels::scale[ch] * 0.5f + mean * 1e-3f, mean,
+                               HistSeries::value(b, ch, STAT_MEAN));
+    }
+  });
+  TEST_ASSERT_EQUAL_UINT32(n, s.lastSeq(t));
+}
+
+int main(int, char**)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_floor_matches_fixed_rings);
+  RUN_TEST(test_noisy_data_keeps_floor);
+  RUN_TEST(test_nothing_dropped_below_floor);
+  RUN_TEST(test_smooth_data_goes_beyond_floor);
+  RUN_TEST(test_archive_keeps_order_and_values);
+  return UNITY_END();
+}